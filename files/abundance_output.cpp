@@ -0,0 +1,475 @@
+//======================================================================================
+// Athena++ astrophysical MHD code
+// Copyright (C) 2014 James M. Stone  <jmstone@princeton.edu>
+// See LICENSE file for full public license information.
+//======================================================================================
+//! \file abundance_output.cpp
+//  \brief compressed HDF5 output of the passive-scalar mass fractions, see
+//  abundance_output.hpp for the format
+//======================================================================================
+
+// C headers
+#include <stdint.h>   // uint16_t
+
+// C++ headers
+#include <algorithm>  // std::min()
+#include <cmath>      // std::log(), std::floor()
+#include <iomanip>    // setw, setfill
+#include <iostream>   // cout, endl
+#include <sstream>    // stringstream
+#include <stdexcept>  // std::runtime_error()
+#include <string>     // string
+#include <vector>     // vector
+
+// Athena++ headers
+#include "../athena.hpp"
+#include "../athena_arrays.hpp"
+#include "../coordinates/coordinates.hpp"
+#include "../globals.hpp"
+#include "../hydro/hydro.hpp"
+#include "../mesh/mesh.hpp"
+#include "../parameter_input.hpp"
+#include "../scalars/scalars.hpp"
+#include "abundance_output.hpp"
+#include "burn_trigger.hpp"
+
+#if defined(HDF5OUTPUT) && defined(INCLUDE_CHEMISTRY)
+#include <hdf5.h>
+
+namespace {
+void WriteAttribute(hid_t loc, const char *name, hid_t type, const void *value);
+void WriteDataset(hid_t file, const char *name, hid_t type, int rank,
+                  const hsize_t *dims, const void *data, int deflate_level);
+bool OtherHDF5Outputs(ParameterInput *pin);
+#if NON_BAROTROPIC_EOS
+const char *prim_names[] = {"rho", "vel1", "vel2", "vel3", "press"};
+#else
+const char *prim_names[] = {"rho", "vel1", "vel2", "vel3"};
+#endif
+} // namespace
+
+//--------------------------------------------------------------------------------------
+// AbundanceOutput constructor
+
+AbundanceOutput::AbundanceOutput(Mesh *pm, ParameterInput *pin) :
+    pin_(pin), ptrigger_(nullptr), last_cycle_(-1), npending_(0), stop_(false) {
+  basename_ = pin->GetString("job", "problem_id");
+  dt = pin->GetReal("abundance_output", "dt");
+  next_time = pin->GetOrAddReal("abundance_output", "next_time", pm->time);
+  file_number = pin->GetOrAddInteger("abundance_output", "file_number", 0);
+  precision_ = pin->GetOrAddReal("abundance_output", "precision", 1.0e-3);
+  threshold_ = pin->GetOrAddReal("abundance_output", "threshold", 1.0e-10);
+  deflate_level_ = pin->GetOrAddInteger("abundance_output", "deflate_level", 4);
+  hydro_ = pin->GetOrAddBoolean("abundance_output", "hydro", false);
+  async_ = pin->GetOrAddBoolean("abundance_output", "async", false);
+  max_pending_ = pin->GetOrAddInteger("abundance_output", "max_pending", 2);
+  dlog_ = 2.0*std::log(1.0 + precision_);
+  std::string trigger = pin->GetOrAddString("abundance_output", "trigger", "time");
+  if (trigger == "burn") {
+    ptrigger_ = new BurnTrigger(pin, "abundance_output");
+  } else if (trigger != "time") {
+    std::stringstream msg;
+    msg << "### FATAL ERROR in AbundanceOutput constructor" << std::endl
+        << "<abundance_output> trigger = " << trigger << " is not time or burn"
+        << std::endl;
+    throw std::runtime_error(msg.str().c_str());
+  }
+
+  //codes must fit in 16 bits between the threshold and X = 1
+  Real nlevels = 1.0 - std::log(threshold_)/dlog_;
+  if (precision_ <= 0.0 || threshold_ <= 0.0 || threshold_ >= 1.0 || nlevels > 65535.) {
+    std::stringstream msg;
+    msg << "### FATAL ERROR in AbundanceOutput constructor" << std::endl
+        << "<abundance_output> precision = " << precision_ << " and threshold = "
+        << threshold_ << " need " << nlevels << " levels, more than 16 bits" << std::endl;
+    throw std::runtime_error(msg.str().c_str());
+  }
+  if (max_pending_ < 1) max_pending_ = 1;
+
+  //the I/O thread calls HDF5 while the main thread may write the other hdf5 outputs,
+  //which is only safe with a thread-safe HDF5 build
+  if (async_) {
+    hbool_t threadsafe = 0;
+    H5is_library_threadsafe(&threadsafe);
+    if (!threadsafe && OtherHDF5Outputs(pin)) {
+      async_ = false;
+      if (Globals::my_rank == 0) {
+        std::cout << "### WARNING in AbundanceOutput constructor" << std::endl
+                  << "HDF5 library is not thread-safe and other hdf5 outputs are "
+                  << "enabled; <abundance_output> falls back to async = false"
+                  << std::endl;
+      }
+    }
+  }
+  if (async_) {
+    io_thread_ = std::thread(&AbundanceOutput::IOThreadLoop, this);
+  }
+}
+
+// destructor: write everything still queued, then stop the I/O thread
+
+AbundanceOutput::~AbundanceOutput() {
+  if (async_) {
+    {
+      std::lock_guard<std::mutex> lock(mtx_);
+      stop_ = true;
+    }
+    cv_.notify_all();
+    io_thread_.join();
+  }
+  delete ptrigger_;
+}
+
+//--------------------------------------------------------------------------------------
+//! \fn void AbundanceOutput::MakeOutput(Mesh *pm, bool final)
+//  \brief write a dump if the output time has been reached or the burn trigger fires,
+//  or the final state if the last step did not
+
+void AbundanceOutput::MakeOutput(Mesh *pm, bool final) {
+  //in the loop the scalars are already those at the end of the step, before the mesh
+  //time and cycle are advanced to it
+  const Real time = final ? pm->time : pm->time + pm->dt;
+  const int ncycle = final ? pm->ncycle : pm->ncycle + 1;
+  if (final) {
+    if (ncycle == last_cycle_) return;
+  } else if (time < next_time) {
+    if (ptrigger_ == nullptr || !ptrigger_->Due(pm, time)) return;
+  }
+  if (pm->nblocal > 0) {
+    AbundanceSnapshot *psnap = TakeSnapshot(pm, time, ncycle);
+    if (async_) {
+      std::unique_lock<std::mutex> lock(mtx_);
+      //back-pressure: wait for a free staging slot
+      cv_.wait(lock, [this] {return npending_ < max_pending_ || !io_error_.empty();});
+      if (!io_error_.empty()) {
+        delete psnap;
+        throw std::runtime_error(io_error_.c_str());
+      }
+      queue_.push_back(psnap);
+      npending_++;
+      lock.unlock();
+      cv_.notify_all();
+    } else {
+      WriteSnapshot(*psnap);
+      delete psnap;
+    }
+  }
+  file_number++;
+  last_cycle_ = ncycle;
+  if (ptrigger_ != nullptr) {
+    //the longest interval counts from the last dump, whatever made it
+    ptrigger_->Mark(pm, time);
+    next_time = time + dt;
+  } else {
+    next_time += dt;
+    //keep next_time ahead of the current time if dt is smaller than the time step
+    if (next_time <= time) {
+      next_time += dt*std::floor((time - next_time)/dt + 1.0);
+    }
+  }
+  //stored in the input so that restarts continue the sequence
+  pin_->SetInteger("abundance_output", "file_number", file_number);
+  pin_->SetReal("abundance_output", "next_time", next_time);
+  return;
+}
+
+//--------------------------------------------------------------------------------------
+//! \fn void AbundanceOutput::Flush()
+//  \brief block until the I/O thread has written every queued snapshot
+
+void AbundanceOutput::Flush() {
+  if (!async_) return;
+  std::unique_lock<std::mutex> lock(mtx_);
+  cv_.wait(lock, [this] {return npending_ == 0 || !io_error_.empty();});
+  if (!io_error_.empty()) throw std::runtime_error(io_error_.c_str());
+  return;
+}
+
+//--------------------------------------------------------------------------------------
+//! \fn void AbundanceOutput::IOThreadLoop()
+//  \brief body of the I/O thread: write queued snapshots in order until stopped
+
+void AbundanceOutput::IOThreadLoop() {
+  while (true) {
+    AbundanceSnapshot *psnap;
+    {
+      std::unique_lock<std::mutex> lock(mtx_);
+      cv_.wait(lock, [this] {return !queue_.empty() || stop_;});
+      if (queue_.empty()) return;  // stop_ set and nothing left to write
+      psnap = queue_.front();
+      queue_.pop_front();
+    }
+    std::string err;
+    try {
+      WriteSnapshot(*psnap);
+    } catch (std::exception &ex) {
+      err = ex.what();
+    }
+    delete psnap;
+    {
+      std::lock_guard<std::mutex> lock(mtx_);
+      npending_--;
+      if (!err.empty() && io_error_.empty()) io_error_ = err;
+    }
+    cv_.notify_all();
+  }
+}
+
+//--------------------------------------------------------------------------------------
+//! \fn uint16_t AbundanceOutput::Quantize(const Real x) const
+//  \brief 16-bit logarithmic code of the mass fraction x
+
+uint16_t AbundanceOutput::Quantize(const Real x) const {
+  if (!(x >= threshold_)) return 0;  // also catches NaN
+  Real c = 1.0 + std::floor(std::log(x/threshold_)/dlog_ + 0.5);
+  return static_cast<uint16_t>(std::min(c, static_cast<Real>(65535.)));
+}
+
+//--------------------------------------------------------------------------------------
+//! \fn AbundanceSnapshot *AbundanceOutput::TakeSnapshot(Mesh *pm, const Real time,
+//                                                       const int ncycle)
+//  \brief quantize the mass fractions of all local MeshBlocks into a staging buffer;
+//  this is the only part of a dump that runs on the main thread in async mode
+
+AbundanceSnapshot *AbundanceOutput::TakeSnapshot(Mesh *pm, const Real time,
+                                                 const int ncycle) {
+  AbundanceSnapshot *psnap = new AbundanceSnapshot;
+  AbundanceSnapshot &snap = *psnap;
+  const int nb = pm->nblocal;
+  MeshBlock *pmb0 = pm->my_blocks(0);
+  const int nx1 = pmb0->block_size.nx1;
+  const int nx2 = pmb0->block_size.nx2;
+  const int nx3 = pmb0->block_size.nx3;
+  const int ncells = nx1*nx2*nx3;
+  snap.time = time;
+  snap.ncycle = ncycle;
+  snap.file_number = file_number;
+  snap.nb = nb;
+  snap.nx1 = nx1;
+  snap.nx2 = nx2;
+  snap.nx3 = nx3;
+  snap.codes.resize(static_cast<std::size_t>(nb)*NSCALARS*ncells);
+  snap.mask.assign(nb*NSCALARS, 0);
+  snap.gids.resize(nb);
+  snap.x1f.resize(nb*(nx1+1));
+  snap.x2f.resize(nb*(nx2+1));
+  snap.x3f.resize(nb*(nx3+1));
+  if (hydro_) snap.prim.resize(static_cast<std::size_t>(NHYDRO)*nb*ncells);
+
+  for (int b=0; b<nb; ++b) {
+    MeshBlock *pmb = pm->my_blocks(b);
+    snap.gids[b] = pmb->gid;
+    for (int i=0; i<=nx1; ++i) snap.x1f[b*(nx1+1)+i] = pmb->pcoord->x1f(pmb->is+i);
+    for (int j=0; j<=nx2; ++j) snap.x2f[b*(nx2+1)+j] = pmb->pcoord->x2f(pmb->js+j);
+    for (int k=0; k<=nx3; ++k) snap.x3f[b*(nx3+1)+k] = pmb->pcoord->x3f(pmb->ks+k);
+    for (int ispec=0; ispec < NSCALARS; ++ispec) {
+      const Real a = ChemNetwork::MassNumber(ispec);
+      uint16_t *pc = &snap.codes[(static_cast<std::size_t>(b)*NSCALARS + ispec)*ncells];
+      uint16_t cmax = 0;
+      int n = 0;
+      for (int k=pmb->ks; k<=pmb->ke; ++k) {
+        for (int j=pmb->js; j<=pmb->je; ++j) {
+#pragma omp simd reduction(max:cmax)
+          for (int i=pmb->is; i<=pmb->ie; ++i) {
+            Real x = a*pmb->pscalars->s(ispec, k, j, i)/pmb->phydro->w(IDN, k, j, i);
+            uint16_t c = Quantize(x);
+            pc[n + i - pmb->is] = c;
+            cmax = std::max(cmax, c);
+          }
+          n += nx1;
+        }
+      }
+      snap.mask[b*NSCALARS + ispec] = (cmax > 0) ? 1 : 0;
+    }
+    if (hydro_) {
+      for (int nv=0; nv<NHYDRO; ++nv) {
+        float *pp = &snap.prim[(static_cast<std::size_t>(nv)*nb + b)*ncells];
+        int n = 0;
+        for (int k=pmb->ks; k<=pmb->ke; ++k) {
+          for (int j=pmb->js; j<=pmb->je; ++j) {
+            for (int i=pmb->is; i<=pmb->ie; ++i) {
+              pp[n++] = static_cast<float>(pmb->phydro->w(nv, k, j, i));
+            }
+          }
+        }
+      }
+    }
+  }
+  return psnap;
+}
+
+//--------------------------------------------------------------------------------------
+//! \fn void AbundanceOutput::WriteSnapshot(const AbundanceSnapshot &snap)
+//  \brief write one snapshot to its file; one dataset per species holding only the
+//  blocks where it is present
+
+void AbundanceOutput::WriteSnapshot(const AbundanceSnapshot &snap) {
+  const int nb = snap.nb;
+  const int nx1 = snap.nx1, nx2 = snap.nx2, nx3 = snap.nx3;
+  const int ncells = nx1*nx2*nx3;
+  std::stringstream fname;
+  fname << basename_ << ".abun.r" << std::setw(5) << std::setfill('0') << Globals::my_rank
+        << "." << std::setw(5) << std::setfill('0') << snap.file_number << ".h5";
+  hid_t file = H5Fcreate(fname.str().c_str(), H5F_ACC_TRUNC, H5P_DEFAULT, H5P_DEFAULT);
+  if (file < 0) {
+    std::stringstream msg;
+    msg << "### FATAL ERROR in AbundanceOutput::WriteSnapshot" << std::endl
+        << "Unable to create " << fname.str() << std::endl;
+    throw std::runtime_error(msg.str().c_str());
+  }
+  double time = snap.time;
+  int ncycle = snap.ncycle, nscalars = NSCALARS;
+  int block_size[3] = {nx1, nx2, nx3};
+  double params[3] = {precision_, threshold_, dlog_};
+  hsize_t three = 3;
+  hid_t root = H5Gopen(file, "/", H5P_DEFAULT);
+  WriteAttribute(root, "Time", H5T_NATIVE_DOUBLE, &time);
+  WriteAttribute(root, "NumCycle", H5T_NATIVE_INT, &ncycle);
+  WriteAttribute(root, "NumMeshBlocks", H5T_NATIVE_INT, &nb);
+  WriteAttribute(root, "NumSpecies", H5T_NATIVE_INT, &nscalars);
+  hid_t space3 = H5Screate_simple(1, &three, NULL);
+  hid_t attr = H5Acreate(root, "MeshBlockSize", H5T_NATIVE_INT, space3, H5P_DEFAULT,
+                         H5P_DEFAULT);
+  H5Awrite(attr, H5T_NATIVE_INT, block_size);
+  H5Aclose(attr);
+  //precision, threshold and dlog, needed to decode
+  attr = H5Acreate(root, "Quantization", H5T_NATIVE_DOUBLE, space3, H5P_DEFAULT,
+                   H5P_DEFAULT);
+  H5Awrite(attr, H5T_NATIVE_DOUBLE, params);
+  H5Aclose(attr);
+  H5Sclose(space3);
+  //species names, in the order of the mask columns
+  std::size_t maxlen = 1;
+  for (int ispec=0; ispec < NSCALARS; ++ispec) {
+    maxlen = std::max(maxlen, ChemNetwork::species_names[ispec].length());
+  }
+  std::vector<char> names(NSCALARS*maxlen, '\0');
+  for (int ispec=0; ispec < NSCALARS; ++ispec) {
+    ChemNetwork::species_names[ispec].copy(&names[ispec*maxlen], maxlen);
+  }
+  hsize_t nspec = NSCALARS;
+  hid_t string_type = H5Tcopy(H5T_C_S1);
+  H5Tset_size(string_type, maxlen);
+  hid_t space_names = H5Screate_simple(1, &nspec, NULL);
+  attr = H5Acreate(root, "SpeciesNames", string_type, space_names, H5P_DEFAULT,
+                   H5P_DEFAULT);
+  H5Awrite(attr, string_type, &names[0]);
+  H5Aclose(attr);
+  H5Sclose(space_names);
+  H5Tclose(string_type);
+  H5Gclose(root);
+
+  hsize_t dims[4];
+  dims[0] = nb;
+  WriteDataset(file, "gid", H5T_NATIVE_INT, 1, dims, &snap.gids[0], 0);
+  dims[1] = NSCALARS;
+  WriteDataset(file, "mask", H5T_NATIVE_UCHAR, 2, dims, &snap.mask[0], 0);
+  dims[1] = nx1 + 1;
+  WriteDataset(file, "x1f", H5T_NATIVE_FLOAT, 2, dims, &snap.x1f[0], 0);
+  dims[1] = nx2 + 1;
+  WriteDataset(file, "x2f", H5T_NATIVE_FLOAT, 2, dims, &snap.x2f[0], 0);
+  dims[1] = nx3 + 1;
+  WriteDataset(file, "x3f", H5T_NATIVE_FLOAT, 2, dims, &snap.x3f[0], 0);
+
+  dims[1] = nx3;
+  dims[2] = nx2;
+  dims[3] = nx1;
+  std::vector<uint16_t> packed;
+  packed.reserve(static_cast<std::size_t>(nb)*ncells);
+  for (int ispec=0; ispec < NSCALARS; ++ispec) {
+    packed.clear();
+    int nstore = 0;
+    for (int b=0; b<nb; ++b) {
+      if (!snap.mask[b*NSCALARS + ispec]) continue;
+      const uint16_t *pc =
+          &snap.codes[(static_cast<std::size_t>(b)*NSCALARS + ispec)*ncells];
+      packed.insert(packed.end(), pc, pc + ncells);
+      nstore++;
+    }
+    if (nstore == 0) continue;
+    dims[0] = nstore;
+    std::string dname = "X_" + ChemNetwork::species_names[ispec];
+    WriteDataset(file, dname.c_str(), H5T_NATIVE_UINT16, 4, dims, &packed[0],
+                 deflate_level_);
+  }
+  if (!snap.prim.empty()) {
+    dims[0] = nb;
+    for (int nv=0; nv<NHYDRO; ++nv) {
+      WriteDataset(file, prim_names[nv], H5T_NATIVE_FLOAT, 4, dims,
+                   &snap.prim[static_cast<std::size_t>(nv)*nb*ncells], deflate_level_);
+    }
+  }
+  H5Fclose(file);
+  return;
+}
+
+namespace {
+//! \fn void WriteAttribute(hid_t loc, const char *name, hid_t type, const void *value)
+//  \brief write a scalar attribute
+void WriteAttribute(hid_t loc, const char *name, hid_t type, const void *value) {
+  hid_t space = H5Screate(H5S_SCALAR);
+  hid_t attr = H5Acreate(loc, name, type, space, H5P_DEFAULT, H5P_DEFAULT);
+  H5Awrite(attr, type, value);
+  H5Aclose(attr);
+  H5Sclose(space);
+}
+
+//! \fn void WriteDataset(...)
+//  \brief write a dataset; with deflate_level > 0 it is chunked by MeshBlock and
+//  compressed with the shuffle and deflate filters
+void WriteDataset(hid_t file, const char *name, hid_t type, int rank,
+                  const hsize_t *dims, const void *data, int deflate_level) {
+  hid_t space = H5Screate_simple(rank, dims, NULL);
+  hid_t dcpl = H5Pcreate(H5P_DATASET_CREATE);
+  if (deflate_level > 0) {
+    hsize_t chunk[4];
+    chunk[0] = 1;
+    for (int n=1; n<rank; ++n) chunk[n] = dims[n];
+    H5Pset_chunk(dcpl, rank, chunk);
+    H5Pset_shuffle(dcpl);
+    H5Pset_deflate(dcpl, deflate_level);
+  }
+  hid_t dset = H5Dcreate(file, name, type, space, H5P_DEFAULT, dcpl, H5P_DEFAULT);
+  H5Dwrite(dset, type, H5S_ALL, H5S_ALL, H5P_DEFAULT, data);
+  H5Dclose(dset);
+  H5Pclose(dcpl);
+  H5Sclose(space);
+}
+
+//! \fn bool OtherHDF5Outputs(ParameterInput *pin)
+//  \brief whether any <outputN> block writes hdf5
+bool OtherHDF5Outputs(ParameterInput *pin) {
+  for (int n=1; n<100; ++n) {
+    std::stringstream block;
+    block << "output" << n;
+    if (pin->DoesParameterExist(block.str(), "file_type")
+        && pin->GetString(block.str(), "file_type") == "hdf5") {
+      return true;
+    }
+  }
+  return false;
+}
+} // namespace
+
+#else // no HDF5 or no chemistry
+
+AbundanceOutput::AbundanceOutput(Mesh *pm, ParameterInput *pin) {
+  std::stringstream msg;
+  msg << "### FATAL ERROR in AbundanceOutput constructor" << std::endl
+      << "<abundance_output> requires HDF5 output (-hdf5) and a chemistry network"
+      << std::endl;
+  throw std::runtime_error(msg.str().c_str());
+}
+
+AbundanceOutput::~AbundanceOutput() {}
+void AbundanceOutput::MakeOutput(Mesh *pm, bool final) {}
+void AbundanceOutput::Flush() {}
+uint16_t AbundanceOutput::Quantize(const Real x) const {return 0;}
+AbundanceSnapshot *AbundanceOutput::TakeSnapshot(Mesh *pm, const Real time,
+                                                 const int ncycle) {
+  return nullptr;
+}
+void AbundanceOutput::WriteSnapshot(const AbundanceSnapshot &snap) {}
+void AbundanceOutput::IOThreadLoop() {}
+
+#endif // HDF5OUTPUT && INCLUDE_CHEMISTRY
@@ -0,0 +1,112 @@
+#ifndef OUTPUTS_ABUNDANCE_OUTPUT_HPP_
+#define OUTPUTS_ABUNDANCE_OUTPUT_HPP_
+//======================================================================================
+// Athena++ astrophysical MHD code
+// Copyright (C) 2014 James M. Stone  <jmstone@princeton.edu>
+// See LICENSE file for full public license information.
+//======================================================================================
+//! \file abundance_output.hpp
+//  \brief compressed HDF5 output of the passive-scalar mass fractions
+//
+//  Mass fractions X = A*s/rho are stored log-quantized as 16-bit codes,
+//    code = 0                                  if X < threshold
+//    code = 1 + round(log(X/threshold)/dlog)  otherwise,
+//  with dlog = 2*log(1 + precision), so that the relative error of a decoded value
+//  threshold*exp((code-1)*dlog) is at most precision. A species that is below the
+//  threshold everywhere in a MeshBlock is not written for that block; the per-block
+//  mask records which species were written. Each rank writes its own file,
+//    <problem_id>.abun.r<rank>.<file_number>.h5
+//  with one chunked, shuffled and deflated dataset per species. With hydro = true the
+//  primitive hydro variables are added as single precision datasets, so the dump can
+//  replace a full hdf5 prim output. Use read_abundances.py to restore dense arrays.
+//
+//  With async = true a dump only copies the data into a staging snapshot; a background
+//  I/O thread on each rank does the HDF5 writes. At most max_pending snapshots are
+//  held in memory: when the queue is full, the next dump waits for the oldest write to
+//  finish, so memory stays bounded even if the file system is slower than the output
+//  cadence. The I/O thread makes no MPI calls.
+//
+//  With trigger = burn dumps are also made when the burn has changed by a set amount
+//  since the last one, and dt is the longest interval between two (see
+//  burn_trigger.hpp).
+//======================================================================================
+
+// C headers
+#include <stdint.h>  // uint16_t
+
+// C++ headers
+#include <condition_variable>  // condition_variable
+#include <deque>     // deque
+#include <mutex>     // mutex
+#include <string>    // string
+#include <thread>    // thread
+#include <vector>    // vector
+
+// Athena++ headers
+#include "../athena.hpp"
+
+class BurnTrigger;
+class Mesh;
+class MeshBlock;
+class ParameterInput;
+
+//! \struct AbundanceSnapshot
+//  \brief staging copy of everything one dump writes
+struct AbundanceSnapshot {
+  Real time;
+  int ncycle, file_number;
+  int nb, nx1, nx2, nx3;
+  std::vector<int> gids;
+  std::vector<unsigned char> mask;   // (nb, NSCALARS)
+  std::vector<uint16_t> codes;       // (nb, NSCALARS, nx3, nx2, nx1)
+  std::vector<float> x1f, x2f, x3f;  // (nb, nx+1)
+  std::vector<float> prim;           // (NHYDRO, nb, nx3, nx2, nx1), if hydro = true
+};
+
+//! \class AbundanceOutput
+//  \brief writer for the compressed abundance dumps, configured by <abundance_output>
+class AbundanceOutput {
+ public:
+  AbundanceOutput(Mesh *pm, ParameterInput *pin);
+  ~AbundanceOutput();
+
+  //write a dump if the output time has been reached or the burn trigger fires; call
+  //from UserWorkInLoop. With final, from UserWorkAfterLoop, write the final state
+  //unless the last step already did.
+  void MakeOutput(Mesh *pm, bool final=false);
+  //wait until every queued snapshot has been written
+  void Flush();
+
+  Real next_time;     // time of the next dump
+  Real dt;            // time between dumps
+  int file_number;    // number of the next dump
+
+ private:
+  ParameterInput *pin_;
+  std::string basename_;
+  Real precision_;    // maximum relative error of the stored mass fractions
+  Real threshold_;    // mass fractions below this are stored as zero
+  Real dlog_;         // width of one quantization level in log(X)
+  int deflate_level_; // gzip level of the HDF5 deflate filter, 0 to disable
+  bool hydro_;        // also write the primitive hydro variables
+  BurnTrigger *ptrigger_;  // with trigger = burn, nullptr otherwise
+  int last_cycle_;    // cycle of the last dump, -1 if none yet
+
+  //background writer
+  bool async_;
+  int max_pending_;   // maximum number of snapshots queued or being written
+  std::thread io_thread_;
+  std::mutex mtx_;
+  std::condition_variable cv_;
+  std::deque<AbundanceSnapshot*> queue_;
+  int npending_;      // snapshots queued or being written
+  bool stop_;
+  std::string io_error_;  // error raised on the I/O thread, rethrown by MakeOutput
+
+  uint16_t Quantize(const Real x) const;
+  AbundanceSnapshot *TakeSnapshot(Mesh *pm, const Real time, const int ncycle);
+  void WriteSnapshot(const AbundanceSnapshot &snap);
+  void IOThreadLoop();
+};
+
+#endif // OUTPUTS_ABUNDANCE_OUTPUT_HPP_
@@ -31,6 +31,9 @@
 #include "../../defs.hpp"
 #include "../../eos/eos.hpp"
 #include "../utils/thermo.hpp"
+#include "../utils/burn_integrator.hpp"
+#include "../utils/dual_number.hpp"
+#include "../utils/perf_counters.hpp"
 
 //c++ header
 #include <sstream>    // stringstream
@@ -41,6 +44,8 @@
 #include <algorithm>    // std::find()
 #include <iterator>     // std::distance()
 #include <cmath>       //M_PI
+#include <stdexcept>   // std::runtime_error()
+#include <vector>      // vector container
 
 //species names
 const std::string ChemNetwork::species_names[NSCALARS] = 
@@ -74,6 +79,9 @@ const int ChemNetwork::iFe_ =
 const int ChemNetwork::iNi_ =
   ChemistryUtility::FindStrIndex(species_names, NSCALARS, "56Ni");
 
+constexpr Real ChemNetwork::Aiso[ChemNetwork::NISO];
+constexpr Real ChemNetwork::Ziso[ChemNetwork::NISO];
+
 static const int NISO = 13;
 static const int NEQN = 14;
 static const int NREAC = 18;
@@ -105,9 +113,10 @@ static Real cb[NREAC];
 
 ChemNetwork::ChemNetwork(MeshBlock *pmb, ParameterInput *pin) {
 	//number of species and a list of name of species
-  pmy_spec_ = pmb->pscalars;
-	pmy_mb_ = pmb;
-  // gm1_ = pmy_mb_->peos->GetGamma() - 1;
+  //pmb is nullptr for a network outside the mesh, which only burns along given
+  //histories (see tracer_burn.hpp)
+  pmy_spec_ = (pmb != nullptr) ? pmb->pscalars : nullptr;
+  pmy_mb_ = pmb;
 
 	//set the parameters from input file
   /* Number of the alpha-chain isotope, which is considered "fuel". This isotope
@@ -116,22 +125,75 @@ ChemNetwork::ChemNetwork(MeshBlock *pmb, ParameterInput *pin) {
      turbulent flame speed. */
   NISOfuel = pin->GetOrAddInteger("chemistry", "NISOfuel", 1);
   /* Increment of energy epsder*e is used in rhands to calculate df(i)/de
-     numerically. */
-  alphanet_epsder = pin->GetOrAddReal("chemistry","alphanet_epsder",1.e-5);
+     numerically. Close to NSE the rates are so steep in T that larger
+     increments make the Jacobian too inexact for the coupled burn. */
+  alphanet_epsder = pin->GetOrAddReal("chemistry","alphanet_epsder",1.e-8);
+  /* The coupled burn takes df(i)/de exactly from dual-number rates instead, in the
+     same pass as the rates; alphanet_dualder = false falls back to epsder */
+  alphanet_dualder = pin->GetOrAddBoolean("chemistry","alphanet_dualder",true);
   //units
 	unit_density = pin->GetOrAddReal("chemistry", "unit_density",1.);
 	unit_length_in_cm_ = pin->GetOrAddReal("chemistry", "unit_length_in_cm", 1.);
 	unit_vel_in_cms_ = pin->GetOrAddReal("chemistry", "unit_vel_in_cms",1.);
   unit_time_in_s_ = unit_length_in_cm_/unit_vel_in_cms_;
-  unit_E_in_cgs_ = 1.67e-24 * (gm1_ + 1) * unit_density
-                           * unit_vel_in_cms_ * unit_vel_in_cms_;
+  //unit_density is a mass density, so no mean molecular weight enters here
+  unit_E_in_cgs_ = unit_density * unit_vel_in_cms_ * unit_vel_in_cms_;
+
+  //equation of state used to get the temperature inside the burn
+  eos_.Init(pin, unit_E_in_cgs_, Aiso[NISO-1]);
+  if (eos_.IsTable() && pmb != nullptr) {
+    temp_cache_.NewAthenaArray(pmb->ncells3, pmb->ncells2, pmb->ncells1);
+  }
+  temp_guess_ = 0.0;
+  kcell_ = jcell_ = icell_ = 0;
+
+  //operator split (abundances at fixed energy) or coupled burn
+  std::string burn = pin->GetOrAddString("chemistry", "burn", "split");
+  pburn = nullptr;
+  if (burn == "coupled") {
+    if (!NON_BAROTROPIC_EOS) {
+      std::stringstream msg;
+      msg << "### FATAL ERROR in ChemNetwork constructor" << std::endl
+          << "<chemistry> burn = coupled needs an energy equation" << std::endl;
+      throw std::runtime_error(msg.str().c_str());
+    }
+    if (pmb != nullptr) pburn = new BurnIntegrator(this, pmb, pin);
+  } else if (burn != "split") {
+    std::stringstream msg;
+    msg << "### FATAL ERROR in ChemNetwork constructor" << std::endl
+        << "<chemistry> burn = " << burn << " unknown, use split or coupled" << std::endl;
+    throw std::runtime_error(msg.str().c_str());
+  }
+
+  //nuclear data and rate fits are the same for every cell; read them once here
+  //rather than in InitializeNextStep
+  std::string data_file = pin->GetOrAddString("chemistry", "network_data_file",
+      "/Users/ghalevi/athena/src/chemistry/network/alpnet.dat");
+  ReadNuclearData(data_file);
 }
 
-ChemNetwork::~ChemNetwork() {}
+ChemNetwork::~ChemNetwork() {
+  if (pburn != nullptr) delete pburn;
+}
 
 void ChemNetwork::InitializeNextStep(const int k, const int j, const int i) {
-  const Real five_thirds = 5.0 / 3.0;
-  const Real conv_factor = 9.867425e9;
+  if (pburn != nullptr && !BurnIntegrator::driven) {
+    //RHS and Edot are zero in coupled mode, so nothing would ever burn
+    std::stringstream msg;
+    msg << "### FATAL ERROR in ChemNetwork::InitializeNextStep" << std::endl
+        << "<chemistry> burn = coupled, but the problem generator does not drive the "
+        << "coupled burn with a BurnScheduler" << std::endl;
+    throw std::runtime_error(msg.str().c_str());
+  }
+  rho_ = CellDensity(k, j, i);
+  kcell_ = k;
+  jcell_ = j;
+  icell_ = i;
+  temp_guess_ = eos_.IsTable() ? temp_cache_(k, j, i) : 0.0;
+  return;
+}
+
+Real ChemNetwork::CellDensity(const int k, const int j, const int i) const {
   Real rho, rho_floor;
   //density
   rho = pmy_mb_->phydro->w(IDN, k, j, i);
@@ -139,10 +201,13 @@ void ChemNetwork::InitializeNextStep(const int k, const int j, const int i) {
   rho_floor = pmy_mb_->peos->GetDensityFloor();
   rho = (rho > rho_floor) ?  rho : rho_floor;
   //density in proper units
-  rho_ =  rho * unit_density;
+  return rho * unit_density;
+}
+
+void ChemNetwork::ReadNuclearData(const std::string fname) {
+  const Real five_thirds = 5.0 / 3.0;
+  const Real conv_factor = 9.867425e9;
 
-  int MAXLEN = 256;
-  char buf[MAXLEN];
   int ai, ax;
   int l, m;
   Real z[NISO];
@@ -150,10 +215,12 @@ void ChemNetwork::InitializeNextStep(const int k, const int j, const int i) {
   std::string namex;
 
   /* Entering nuclear data table */
-  std::ifstream nuc_data("/Users/ghalevi/athena/src/chemistry/network/alpnet.dat");
+  std::ifstream nuc_data(fname.c_str());
   if (!nuc_data) {
-    std::cout << "### FATAL ERROR in ChemNetwork::InitializeNextStep" << "\n"
-        << "Unable to open alpnet.dat" << "\n";
+    std::stringstream msg;
+    msg << "### FATAL ERROR in ChemNetwork::ReadNuclearData" << std::endl
+        << "Unable to open " << fname << std::endl;
+    throw std::runtime_error(msg.str().c_str());
   }
   std::string line;
   int nline = 0;
@@ -180,9 +247,9 @@ void ChemNetwork::InitializeNextStep(const int k, const int j, const int i) {
   //     bpf[i] << ", " << cpf[i] << "\n \n";
   // }
 
-  /* Entering reaction rate data table */
+  /* Entering reaction rate data table: set 0 is triple-alpha, a(x,y)b from set 1 */
   nline = 0;
-  m = 0;
+  m = 1;
   while (getline(nuc_data, line)) {
     // std::cout << nline << ": " << line << "\n";
     if (nline == 0) {
@@ -312,34 +379,26 @@ void ChemNetwork::InitializeNextStep(const int k, const int j, const int i) {
   return;
 }
 
-void ChemNetwork::CalculateRates(Real rho, Real tp, Real frv[NREAC], Real rev[NREAC]){
-  /* Parameters for screening corrections */
-  const Real a1 = -0.897744;
-  const Real a2 =  4.0 * 0.95043;
-  const Real a3 = -4.0 * 0.18956;
-  const Real a4 = -0.81487;
-  const Real a5 = -2.58020;
-  const Real a6 = -0.57735;
-  const Real a8 =  2.0160;
-  const Real a7 =  0.29341 / a8;
-
-  const Real one_third   = 1.0 /  3.0;
+template <typename T>
+void ChemNetwork::CalculateRates(const T rho, const T tp, T frv[NREAC], T rev[NREAC]){
+  /* About 900 flops and 116 exp, log, pow or sqrt per cell; dual numbers triple the
+     flops, lanes compute LaneCount<T> cells */
+  PERF_SCOPE(PERF_RATES, LaneCount<T>::value *
+             ((sizeof(T) == LaneCount<T>::value * sizeof(Real)) ? 900.0 : 2700.0),
+             LaneCount<T>::value * 116.0);
   const Real two_thirds  = 2.0 /  3.0;
   const Real one_twelfth = 1.0 / 12.0;
 
   int k;
-  Real t9, t9i, t9l, t923, t9r, g1, gam, gam4;
-  Real pf[NISO];   /* Partition functions */
-  Real pf0_inv;    /* Inverse of partition function (formerly) at index 0 */
-  Real falp[NALP];
-  Real fscr[NISO]; /* Screening factors */
+  T t9, t9i, t9l, t923;
+  T falp[NALP];
+  T fscr[NISO]; /* Screening factors */
 
   /* Calculation of forward rates */
   t9   = fmax(0.01, 1.e-9 * tp);
   t9i  = 1.0 / t9;
   t9l  = log(t9);
   t923 = pow(t9, two_thirds);
-  t9r  = 11.605 * t9i;
 
   for (k = 0; k < NALP; ++k) {
     falp[k] =   calp[k][0] + 
@@ -375,19 +434,9 @@ void ChemNetwork::CalculateRates(Real rho, Real tp, Real frv[NREAC], Real rev[NR
 
   t9  = 1.e-9 * tp;
   t9i = 1.0 / t9;
-  t9r = 11.605 * t9i;
 
   /* Screening corrections to the forward rates */
-  g1 = t9i * pow(0.5 * rho, one_third);
-  for (k = 0; k < NISO; ++k) {
-    gam = fmin(150.0, g1 * gscr[k]);
-    if (gam < 1.0) {
-      fscr[k] = a6 * gam * sqrt(gam) + a7 * pow(gam, a8);
-    } else {
-      gam4 = sqrt(sqrt(gam));
-      fscr[k] = a1 * gam + a2 * gam4 + a3 / gam4 + a4 * log(gam) + a5;
-    }
-  }
+  ScreeningFactors(rho, t9i, fscr);
 
   frv[ 0] *= exp(3.0 * fscr[0]            - fscr[1]);
   frv[ 1] *= exp(2.0 * fscr[1]            - fscr[4]);
@@ -408,6 +457,82 @@ void ChemNetwork::CalculateRates(Real rho, Real tp, Real frv[NREAC], Real rev[NR
   frv[16] *= exp(      fscr[0] + fscr[10] - fscr[11]);
   frv[17] *= exp(      fscr[0] + fscr[11] - fscr[12]);
 
+  /* Calculation of the reverse rate coefficients */
+  ReverseRates(rho, t9, fscr, rev);
+}
+
+template <typename T>
+void ChemNetwork::ScreeningFactors(const T rho, const T t9i, T fscr[NISO]){
+  /* Parameters for screening corrections */
+  const Real a1 = -0.897744;
+  const Real a2 =  4.0 * 0.95043;
+  const Real a3 = -4.0 * 0.18956;
+  const Real a4 = -0.81487;
+  const Real a5 = -2.58020;
+  const Real a6 = -0.57735;
+  const Real a8 =  2.0160;
+  const Real a7 =  0.29341 / a8;
+
+  const Real one_third = 1.0 / 3.0;
+
+  int k;
+  T g1, gam, gam4;
+
+  g1 = t9i * pow(0.5 * rho, one_third);
+  for (k = 0; k < NISO; ++k) {
+    gam = fmin(150.0, g1 * gscr[k]);
+    if (gam < 1.0) {
+      fscr[k] = a6 * gam * sqrt(gam) + a7 * pow(gam, a8);
+    } else {
+      gam4 = sqrt(sqrt(gam));
+      fscr[k] = a1 * gam + a2 * gam4 + a3 / gam4 + a4 * log(gam) + a5;
+    }
+  }
+}
+
+/* Lanes cannot branch on gam: both the weak and the strong screening formulae are
+   evaluated for every lane, and each lane takes its own */
+template <>
+void ChemNetwork::ScreeningFactors<LaneReal>(const LaneReal rho, const LaneReal t9i,
+    LaneReal fscr[NISO]){
+  const Real a1 = -0.897744;
+  const Real a2 =  4.0 * 0.95043;
+  const Real a3 = -4.0 * 0.18956;
+  const Real a4 = -0.81487;
+  const Real a5 = -2.58020;
+  const Real a6 = -0.57735;
+  const Real a8 =  2.0160;
+  const Real a7 =  0.29341 / a8;
+
+  const Real one_third = 1.0 / 3.0;
+
+  int k, l;
+  LaneReal g1, gam, gam4, weak, strong;
+
+  g1 = t9i * pow(0.5 * rho, one_third);
+  for (k = 0; k < NISO; ++k) {
+    gam = fmin(150.0, g1 * gscr[k]);
+    weak = a6 * gam * sqrt(gam) + a7 * pow(gam, a8);
+    gam4 = sqrt(sqrt(gam));
+    strong = a1 * gam + a2 * gam4 + a3 / gam4 + a4 * log(gam) + a5;
+#pragma omp simd
+    for (l = 0; l < BURN_LANES; ++l) {
+      fscr[k].v[l] = (gam.v[l] < 1.0) ? weak.v[l] : strong.v[l];
+    }
+  }
+}
+
+template <typename T>
+void ChemNetwork::ReverseRates(const T rho, const T t9, const T fscr[NISO],
+    T rev[NREAC]){
+  int k;
+  T t9i, t9r;
+  T pf[NISO];   /* Partition functions */
+  T pf0_inv;    /* Inverse of partition function (formerly) at index 0 */
+
+  t9i = 1.0 / t9;
+  t9r = 11.605 * t9i;
+
   /* Calculation of partition functions */
   for (k = 0; k < NISO; ++k) {
     pf[k] = g0[k] * (1.0 + exp(apf[k] * t9i + bpf[k] + t9 * cpf[k]));
@@ -487,14 +612,14 @@ void ChemNetwork::CalculateRates(Real rho, Real tp, Real frv[NREAC], Real rev[NR
   /* Ni ==> Fe + He */
   rev[17] = exp(ca[17] + cb[17] * t9r + fscr[11] + fscr[0] - fscr[12])
           * pf[0] * pf0_inv * pf[11] / pf[12];
-
 }
 
-void ChemNetwork::RatesOfChange(const Real frv[NREAC], const Real rev[NREAC],
-  const Real y[NSCALARS], Real f[NSCALARS])
+template <typename T, typename TY>
+void ChemNetwork::RatesOfChange(const T frv[NREAC], const T rev[NREAC],
+  const TY y[NSCALARS], T f[NSCALARS])
 {
   int i;
-  Real r;    /* Reaction rate */
+  T r;    /* Reaction rate */
 
   /* 3He ==> C */
   r = frv[0] * (y[0] * y[0] * y[0] - rev[0] * y[1]);
@@ -603,19 +728,31 @@ void ChemNetwork::RatesOfChange(const Real frv[NREAC], const Real rev[NREAC],
   f[12]  =  r;
 }
 
-void ChemNetwork::PartialDerivatives(const Real frv[NREAC], const Real rev[NREAC],
-  const Real y[NSCALARS], Real f[NEQN], Real df[NEQN][NEQN])
+/* The Real kernels are also called from outside this file, by the kernel
+   microbenchmarks of the alpha13_bench problem generator */
+template void ChemNetwork::CalculateRates<Real>(const Real rho, const Real tp,
+    Real frv[NREAC], Real rev[NREAC]);
+template void ChemNetwork::ScreeningFactors<Real>(const Real rho, const Real t9i,
+    Real fscr[NISO]);
+template void ChemNetwork::ReverseRates<Real>(const Real rho, const Real t9,
+    const Real fscr[NISO], Real rev[NREAC]);
+template void ChemNetwork::RatesOfChange<Real>(const Real frv[NREAC],
+    const Real rev[NREAC], const Real y[NSCALARS], Real f[NSCALARS]);
+
+template <typename T>
+void ChemNetwork::PartialDerivatives(const T frv[NREAC], const T rev[NREAC],
+  const T y[NSCALARS], T f[NEQN], T df[NEQN][NEQN])
 {
  const Real conv_factor = 9.64867e17;
 
   /* Reaction rate */
-  Real r;
+  T r;
 
   /* Partial derivatives of reaction rate wrt species */
-  Real r_0, r_1, r_2, r_3, r_4, r_5, r_6, r_7, r_8, r_9, r_10, r_11, r_12;
+  T r_0, r_1, r_2, r_3, r_4, r_5, r_6, r_7, r_8, r_9, r_10, r_11, r_12;
 
   /* Reaction rate */
-  Real edot;
+  T edot;
 
   int j, k;
 
@@ -953,21 +1090,268 @@ void ChemNetwork::PartialDerivatives(const Real frv[NREAC], const Real rev[NREAC
 
 }
 
+template void ChemNetwork::PartialDerivatives<Real>(const Real frv[NREAC],
+    const Real rev[NREAC], const Real y[NSCALARS], Real f[NEQN],
+    Real df[NEQN][NEQN]);
+
+
+Real ChemNetwork::BindingEnergy(const Real y[NSCALARS]) {
+  const Real conv_factor = 9.64867e17;
+  Real eb = 0.0;
+  for (int k = 0; k < NISO; ++k) {
+    eb += q[k] * y[k];
+  }
+  return conv_factor * eb;
+}
+
+Real ChemNetwork::EnergyGenerationRate(const Real rho, const Real temp,
+                                       const Real y[NSCALARS]) {
+  const Real conv_factor = 9.64867e17;
+  Real frv[NREAC]; /* Forward reaction rates */
+  Real rev[NREAC]; /* Reverse reaction rates */
+  Real f[NEQN];
+  Real y_corr[NSCALARS];
+  for (int i=0; i<NSCALARS; i++) {
+    y_corr[i] = (y[i] > 0.0) ? y[i] : 0.0;
+  }
+  CalculateRates(rho, temp, frv, rev);
+  RatesOfChange(frv, rev, y_corr, f);
+  Real edot = 0.0;
+  for (int k = 0; k < NISO; ++k) {
+    edot += q[k] * f[k];
+  }
+  return conv_factor * edot;
+}
+
+int ChemNetwork::RHSFull(const Real y[NEQN], Real f[NEQN], Real jac[NEQN][NEQN],
+                         Real * rdata, const bool exact) {
+  /* Besides the rates, about 150 flops for f and 1700 more for the Jacobian */
+  PERF_SCOPE((jac == nullptr) ? PERF_RHS : PERF_JACOBIAN,
+             (jac == nullptr) ? 150.0 : 1850.0, 0.0);
+  const Real conv_factor = 9.64867e17;
+  const Real rho = rdata[0];
+  const Real e0 = rdata[1];
+  /* e0 = 0: the temperature rdata[2] is prescribed and the energy is a spectator */
+  const bool fixed_temp = !(e0 > 0.0);
+  const Real e0_inv = fixed_temp ? 0.0 : 1.0 / e0;
+  Real frv[NREAC]; /* Forward reaction rates */
+  Real rev[NREAC]; /* Reverse reaction rates */
+  Real fn[NEQN];   /* RHS corresponding to perturbed energy */
+  Real y_corr[NISO];
+  int j, k;
+
+  for (k = 0; k < NISO; ++k) {
+    y_corr[k] = (y[k] > 0.0) ? y[k] : 0.0;
+  }
+  /* Temperature of the current energy, e = y[13]*e0 */
+  Real temp = fixed_temp ? rdata[2] :
+      Temperature(rho, rho * y[NEQN-1] * e0 / unit_E_in_cgs_, y_corr, rdata[2]);
+  rdata[2] = temp;
+  if (temp < alphanet13_Tcold) {
+    for (j = 0; j < NEQN; ++j) {
+      f[j] = 0.0;
+      if (jac != nullptr) {
+        for (k = 0; k < NEQN; ++k) {
+          jac[j][k] = 0.0;
+        }
+      }
+    }
+    return 0;
+  }
+
+  /* With the Jacobian, the rates and their derivatives along y[13] in one pass:
+     the temperature changes with the energy as dT/dy(13) = e0/c_v */
+  Dual frv_d[NREAC], rev_d[NREAC];
+  const bool dual = (jac != nullptr && (alphanet_dualder || exact) && !fixed_temp);
+  if (dual) {
+    CalculateRates(Dual(rho), Dual(temp, e0 / SpecificHeat(rho, temp, y_corr)),
+                   frv_d, rev_d);
+    for (k = 0; k < NREAC; ++k) {
+      frv[k] = frv_d[k].v;
+      rev[k] = rev_d[k].v;
+    }
+  } else {
+    CalculateRates(rho, temp, frv, rev);
+  }
+  if (jac == nullptr) {
+    RatesOfChange(frv, rev, y_corr, f);
+    Real edot = 0.0;
+    for (k = 0; k < NISO; ++k) {
+      edot += q[k] * f[k];
+    }
+    f[NEQN-1] = conv_factor * edot * e0_inv;
+    return 1;
+  }
+
+  /* Calculate f and jac, except for the partial derivatives wrt energy:
+     jac[NEQN-1][:] */
+  PartialDerivatives(frv, rev, y_corr, f, jac);
+
+  /* Scale energy derivatives */
+  f[NEQN-1] *= e0_inv;
+  for (k = 0; k < NEQN - 1; ++k) {
+    jac[k][NEQN-1] *= e0_inv;
+  }
+
+  Real edot = 0.0;
+  if (fixed_temp) {
+    /* The rates do not depend on the energy, which does not change */
+    for (k = 0; k < NEQN; ++k) {
+      jac[NEQN-1][k] = 0.0;
+      jac[k][NEQN-1] = 0.0;
+    }
+  } else if (dual) {
+    /* Last row of jac[NEQN-1][:] from the derivatives of the rates */
+    Dual f_d[NEQN];
+    RatesOfChange(frv_d, rev_d, y_corr, f_d);
+    for (k = 0; k < NISO; ++k) {
+      jac[NEQN-1][k] = f_d[k].d;
+      edot += q[k] * f_d[k].d;
+    }
+    jac[NEQN-1][NEQN-1] = conv_factor * edot * e0_inv;
+  } else {
+    /* Calculate last row of jac[NEQN-1][:] numerically, at the perturbed energy */
+    Real de = alphanet_epsder * y[NEQN-1];
+    Real temp1 = Temperature(rho, rho * (y[NEQN-1] + de) * e0 / unit_E_in_cgs_,
+                             y_corr, temp);
+    CalculateRates(rho, temp1, frv, rev);
+    RatesOfChange(frv, rev, y_corr, fn);
+    for (k = 0; k < NISO; ++k) {
+      edot += q[k] * fn[k];
+    }
+    fn[NEQN-1] = conv_factor * edot * e0_inv;
+
+    /* Calculate numerical derivatives with respect to energy */
+    Real e_diff_inv = 1.0 / de;
+    for (k = 0; k < NEQN; ++k) {
+      jac[NEQN-1][k] = (fn[k] - f[k]) * e_diff_inv;
+    }
+  }
+
+  if (eos_.IsTable() && !fixed_temp) {
+    /* With the tabulated EOS the temperature also depends on the composition
+       through the ion energy, 1.5 kT/m_u per ion: at fixed e, more ions cool the
+       gas as much as taking 1.5 kT/m_u from e would */
+    const Real de_ion = 1.5 * 1.380658e-16 * temp / (1.660539e-24 * e0);
+    for (j = 0; j < NISO; ++j) {
+      if (!(y[j] > 0.0)) continue;
+      for (k = 0; k < NEQN; ++k) {
+        jac[j][k] -= de_ion * jac[NEQN-1][k];
+      }
+    }
+  }
+
+  return 1;
+}
+
+void ChemNetwork::RHSLanes(const LaneReal y[NEQN], LaneReal f[NEQN],
+                           LaneReal jac[NEQN][NEQN], LaneReal * rdata) {
+  /* As RHSFull, for every lane */
+  PERF_SCOPE((jac == nullptr) ? PERF_RHS : PERF_JACOBIAN,
+             ((jac == nullptr) ? 150.0 : 1850.0) * BURN_LANES, 0.0);
+  const Real conv_factor = 9.64867e17;
+  const LaneReal rho = rdata[0];
+  const LaneReal e0_inv = 1.0 / rdata[1];
+  LaneReal frv[NREAC]; /* Forward reaction rates */
+  LaneReal rev[NREAC]; /* Reverse reaction rates */
+  LaneReal fn[NEQN];   /* RHS corresponding to perturbed energy */
+  LaneReal y_corr[NISO];
+  LaneReal temp, edot;
+  Real y_lane[NISO];
+  int j, k, l;
+
+  for (k = 0; k < NISO; ++k) {
+#pragma omp simd
+    for (l = 0; l < BURN_LANES; ++l) {
+      y_corr[k].v[l] = (y[k].v[l] > 0.0) ? y[k].v[l] : 0.0;
+    }
+  }
+  /* Temperature of the current energy, lane by lane: the tabulated EOS is an
+     iteration of its own */
+  for (l = 0; l < BURN_LANES; ++l) {
+    for (k = 0; k < NISO; ++k) y_lane[k] = y_corr[k].v[l];
+    temp.v[l] = Temperature(rho.v[l], rho.v[l] * y[NEQN-1].v[l] * rdata[1].v[l]
+                            / unit_E_in_cgs_, y_lane, rdata[2].v[l]);
+  }
+  rdata[2] = temp;
+
+  CalculateRates(rho, temp, frv, rev);
+  if (jac == nullptr) {
+    RatesOfChange(frv, rev, y_corr, f);
+    edot = 0.0;
+    for (k = 0; k < NISO; ++k) {
+      edot += q[k] * f[k];
+    }
+    f[NEQN-1] = conv_factor * edot * e0_inv;
+  } else {
+    PartialDerivatives(frv, rev, y_corr, f, jac);
+    f[NEQN-1] *= e0_inv;
+    for (k = 0; k < NEQN - 1; ++k) {
+      jac[k][NEQN-1] *= e0_inv;
+    }
+
+    /* Last row of jac[NEQN-1][:] numerically, at the perturbed energy */
+    LaneReal de = alphanet_epsder * y[NEQN-1];
+    LaneReal temp1;
+    for (l = 0; l < BURN_LANES; ++l) {
+      for (k = 0; k < NISO; ++k) y_lane[k] = y_corr[k].v[l];
+      temp1.v[l] = Temperature(rho.v[l], rho.v[l] * (y[NEQN-1].v[l] + de.v[l])
+                               * rdata[1].v[l] / unit_E_in_cgs_, y_lane, temp.v[l]);
+    }
+    CalculateRates(rho, temp1, frv, rev);
+    RatesOfChange(frv, rev, y_corr, fn);
+    edot = 0.0;
+    for (k = 0; k < NISO; ++k) {
+      edot += q[k] * fn[k];
+    }
+    fn[NEQN-1] = conv_factor * edot * e0_inv;
+    LaneReal e_diff_inv = 1.0 / de;
+    for (k = 0; k < NEQN; ++k) {
+      jac[NEQN-1][k] = (fn[k] - f[k]) * e_diff_inv;
+    }
+
+    if (eos_.IsTable()) {
+      /* Ion energy correction of RHSFull, for the lanes that have the species */
+      const LaneReal de_ion = (1.5 * 1.380658e-16 / 1.660539e-24) * temp * e0_inv;
+      for (j = 0; j < NISO; ++j) {
+        for (k = 0; k < NEQN; ++k) {
+#pragma omp simd
+          for (l = 0; l < BURN_LANES; ++l) {
+            if (y[j].v[l] > 0.0) jac[j][k].v[l] -= de_ion.v[l] * jac[NEQN-1][k].v[l];
+          }
+        }
+      }
+    }
+  }
+
+  /* Too cold to burn: nothing changes in the lane */
+  for (l = 0; l < BURN_LANES; ++l) {
+    if (!(temp.v[l] < alphanet13_Tcold)) continue;
+    for (j = 0; j < NEQN; ++j) {
+      f[j].v[l] = 0.0;
+      if (jac != nullptr) {
+        for (k = 0; k < NEQN; ++k) {
+          jac[j][k].v[l] = 0.0;
+        }
+      }
+    }
+  }
+}
 
 void ChemNetwork::RHS(const Real t, const Real y[NSCALARS], const Real ED,
                       Real ydot[NSCALARS])
 {
+  //the coupled burn updates the abundances itself
+  if (pburn != nullptr) {
+    for (int i=0; i<NSCALARS; i++) {
+      ydot[i] = 0.0;
+    }
+    return;
+  }
+  PERF_SCOPE(PERF_RHS, 150.0, 0.0);
   Real frv[NREAC]; /* Forward reaction rates */
   Real rev[NREAC]; /* Reverse reaction rates */
   Real f[NEQN]; //rates of change; last element is de/dt
-  // assumes adiabatic
-  const Real gm1 = pmy_mb_->peos->GetGamma() - 1;
-  Real mn_ = 1.674920e-24;
-  Real k_ = 1.380658e-16;
-  Real temp = ED*gm1*mn_/(rho_*k_);
-  if (t == 0) {
-    printf("T_9 = %f \n", temp*1e-9);
-  }
   Real y_corr[NSCALARS];
   Real y_floor = 0.0;
   for (int i=0; i<NSCALARS; i++) {
@@ -977,6 +1361,22 @@ void ChemNetwork::RHS(const Real t, const Real y[NSCALARS], const Real ED,
       y_corr[i] = y[i];
     }
   }
+  Real temp = Temperature(rho_, ED, y_corr, temp_guess_);
+  if (temp != temp) {
+    //the tabulated EOS did not converge; a NaN right-hand side would only make CVODE
+    //fail later without saying why, and must not warm-start the next inversion
+    std::stringstream msg;
+    msg << "### FATAL ERROR in ChemNetwork::RHS" << std::endl
+        << "temperature inversion did not converge in cell (" << kcell_ << ","
+        << jcell_ << "," << icell_ << "), rho = " << rho_ << " g/cm3, ED = " << ED
+        << std::endl;
+    throw std::runtime_error(msg.str().c_str());
+  }
+  if (eos_.IsTable()) {
+    //successive calls for one cell differ little; start the next inversion here
+    temp_guess_ = temp;
+    temp_cache_(kcell_, jcell_, icell_) = temp;
+  }
   #ifdef DEBUG
     printf("BEFORE \n");
     for (int i = 0; i <NSCALARS; i++) {
@@ -1005,8 +1405,8 @@ void ChemNetwork::RHS(const Real t, const Real y[NSCALARS], const Real ED,
 }
 
 Real ChemNetwork::Edot(const Real t, const Real y[NSCALARS], const Real ED){
-  //isothermal
-  if (!NON_BAROTROPIC_EOS) {
+  //isothermal, or energy already deposited by the coupled burn
+  if (!NON_BAROTROPIC_EOS || pburn != nullptr) {
     return 0;
   }
   Real ydot[NSCALARS];
@@ -1016,17 +1416,8 @@ Real ChemNetwork::Edot(const Real t, const Real y[NSCALARS], const Real ED){
   for (int i = 0; i < NSCALARS; ++i) {
     edot += q[i] * ydot[i];
   }
-  Real dEDdt;
-  dEDdt = conv_factor * edot;
-  Real e0_inv = 1.0 / ED;
-
-  /* Scale energy derivative */
-  dEDdt *= e0_inv;
-
-  // but this is erg/g/s and we want erg/cm^3/s, right? so multiply by the density...?
-  dEDdt *= rho_;
-  printf("dEDdt = %4.2f erg\n",i,dEDdt);
-  return dEDdt;
+  //erg/g per code time to energy density per code time
+  return rho_ * conv_factor * edot / unit_E_in_cgs_;
 }
 
 //calculate Jacobian with numerical differentiation 
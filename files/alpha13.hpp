@@ -16,6 +16,10 @@
 #include "network.hpp"
 #include "../../athena.hpp"
 #include "../../athena_arrays.hpp"
+#include "../utils/simd_lanes.hpp"
+#include "../utils/tabulated_eos.hpp"
+
+class BurnIntegrator;
 
 //! \class ChemNetwork
 //  \brief Chemical Network that defines the reaction rates between species.
@@ -28,7 +32,10 @@ class ChemNetwork : public NetworkWrapper {
   //It would be convenient to know the species names in
   //initialization of chemical species in problem
   friend class MeshBlock; 
+  //the coupled burn calls RHSFull and needs the unit conversions
+  friend class BurnIntegrator;
 public:
+  //pmb = nullptr: a network outside the mesh, for burns along given histories
   ChemNetwork(MeshBlock *pmb, ParameterInput *pin);
   ~ChemNetwork();
 
@@ -49,6 +56,38 @@ public:
   //(ED is the energy density)
   Real Edot(const Real t, const Real y[NSCALARS], const Real ED);
 
+  //nuclear binding energy of the composition y, in erg/g. The energy released
+  //by burning between two states is the difference of their binding energies.
+  Real BindingEnergy(const Real y[NSCALARS]);
+  //temperature (K) from density (g/cm3), energy density (code units) and
+  //composition; with the tabulated EOS, tguess > 0 starts the inversion, and
+  //the result is NaN if the inversion does not converge
+  Real Temperature(const Real rho, const Real ED, const Real y[NSCALARS],
+                   const Real tguess=0.0) {return eos_.Temperature(rho, ED, y, tguess);}
+  //energy density (code units) from density (g/cm3), temperature and composition,
+  //the inverse of Temperature(); used to set up initial conditions
+  Real InternalEnergyDensity(const Real rho, const Real temp, const Real y[NSCALARS]) {
+    return eos_.InternalEnergyDensity(rho, temp, y);
+  }
+  //nuclear energy generation rate, in erg/g/s, from the q-weighted rates of change
+  //of the composition y at density rho (g/cm3) and temperature temp (K)
+  Real EnergyGenerationRate(const Real rho, const Real temp, const Real y[NSCALARS]);
+  //density of cell (k,j,i) in g/cm3 with the hydro density floor, the rho that
+  //Temperature and EnergyGenerationRate take
+  Real CellDensity(const int k, const int j, const int i) const;
+  //length unit in cm, which turns code volumes into cm3
+  Real LengthUnit() const {return unit_length_in_cm_;}
+  //index of the isotope considered fuel, read from input
+  int FuelIndex() const {return NISOfuel;}
+  //mass number of species ispec, to convert abundances to mass fractions
+  static Real MassNumber(const int ispec) {return Aiso[ispec];}
+
+  //coupled abundance-energy burn (<chemistry> burn = coupled), nullptr when the
+  //burn is operator split from the energy. In coupled mode RHS and Edot return zero
+  //and the problem generator burns every step through a BurnScheduler instead
+  //(onezone_burn, nuc_uniform); InitializeNextStep stops the run if none does.
+  BurnIntegrator *pburn;
+
 private:
   PassiveScalars *pmy_spec_;
 	MeshBlock *pmy_mb_;
@@ -83,16 +122,31 @@ private:
   static constexpr Real alphanet13_Tcold = 2.e8; //Temp cutoff, below which plasma is assumed to be inert
 
 	// //units 
-  Real gm1_; //adiabatic gamm, read from input
 	Real unit_density; //read from input
   int NISOfuel; //read from input
   Real alphanet_epsder;
+  bool alphanet_dualder; //exact energy derivatives from dual numbers, read from input
 	Real unit_length_in_cm_; //read from input
 	Real unit_vel_in_cms_; //read from input
 	Real unit_time_in_s_; //from length and velocity units
   //unit of energy density, in erg cm-3, from density and velocity units
   Real unit_E_in_cgs_; 
 	Real rho_; //density, updated at InitializeNextStep from hydro variable
+  //ideal gas, or the electron-degenerate EOS table with <chemistry> eos = table
+  NetworkEOS eos_;
+  //temperature of the current cell from the previous RHS call, and of every cell
+  //from its last burn, to warm-start the temperature inversion
+  Real temp_guess_;
+  AthenaArray<Real> temp_cache_;
+  int kcell_, jcell_, icell_; //current cell, set at InitializeNextStep
+
+  //specific heat de/dT (erg/g/K) at constant density, for the energy derivatives
+  Real SpecificHeat(const Real rho, const Real temp, const Real y[NSCALARS]) {
+    return eos_.SpecificHeat(rho, temp, y);
+  }
+
+  //read isotope data and reaction rate fits from alpnet.dat
+  void ReadNuclearData(const std::string fname);
 
   /*-----------------------------------------------------------------------------
    * Calculate reaction rates
@@ -105,8 +159,26 @@ private:
    *     frv[18] - forward reaction rates
    *     rev[18] - backward reaction rate coefficients
    *               (backward rate = frv * rev)
+   *
+   * Generic in the scalar type T: with T = Dual and tp (or rho) seeded with a
+   * unit derivative, the rates come with their exact derivatives in T (or rho).
    *-----------------------------------------------------------------------------*/
-  void CalculateRates(Real rho, Real tp, Real frv[NREAC], Real rev[NREAC]);
+  template <typename T>
+  void CalculateRates(const T rho, const T tp, T frv[NREAC], T rev[NREAC]);
+
+  /*-----------------------------------------------------------------------------
+   * Parts of CalculateRates, separate so that they can be timed on their own
+   *
+   * ScreeningFactors: screening factors fscr[13] of the isotopes at density
+   *     rho (g/cm3) and inverse temperature t9i (1/T9)
+   * ReverseRates: backward reaction rate coefficients rev[18] at density rho
+   *     (g/cm3) and temperature t9 (T9), from the partition functions and the
+   *     screening factors fscr[13]
+   *-----------------------------------------------------------------------------*/
+  template <typename T>
+  void ScreeningFactors(const T rho, const T t9i, T fscr[NISO]);
+  template <typename T>
+  void ReverseRates(const T rho, const T t9, const T fscr[NISO], T rev[NREAC]);
 
   /*-----------------------------------------------------------------------------
    * Calculate right hand sides of nuclear kinetic equations, and the energy
@@ -127,9 +199,13 @@ private:
    *     f[14]   - rates of change
    *                 f[0:12] - dy(i)/dt [1/sec]
    *                 f[13])  - de/dt    [ergs/gm/sec]
+   *
+   * Generic in the scalar type of the rates, like CalculateRates, and of the
+   * mole fractions, Real or the same as the rates.
    *-----------------------------------------------------------------------------*/
-  void RatesOfChange(const Real frv[NREAC], const Real rev[NREAC],
-      const Real y[NEQN], Real f[NEQN]);
+  template <typename T, typename TY>
+  void RatesOfChange(const T frv[NREAC], const T rev[NREAC],
+      const TY y[NEQN], T f[NEQN]);
 
   /*-----------------------------------------------------------------------------
    * Calculate right hand sides, energy generation rate and their derivatives
@@ -151,9 +227,12 @@ private:
    *                  f[0:12] - dy(i)/dt [1/sec]
    *                  f[13])  - de/dt    [ergs/gm/sec]
    *     df[14][14] - partial derivatives of f with respect to mole fractions
+   *
+   * Generic in the scalar type: Real, or LaneReal for the lockstep burn.
    *-----------------------------------------------------------------------------*/
-  void PartialDerivatives(const Real frv[NREAC], const Real rev[NREAC],
-           const Real y[NEQN], Real f[NEQN], Real df[NEQN][NEQN]);
+  template <typename T>
+  void PartialDerivatives(const T frv[NREAC], const T rev[NREAC],
+           const T y[NEQN], T f[NEQN], T df[NEQN][NEQN]);
 
   /*-----------------------------------------------------------------------------
    * Calculates production rates f(i) = dy(i)/dt along with the energy generation
@@ -162,8 +241,14 @@ private:
    * Input:
    *     y[14]       - initial solution: isotope mole fractions y[0:12],
    *                   internal energy density scaled by e0, y[13] (= 1.0 on input)
-   *     rdata[2]    - density, g/cm3 (=const)
+   *     rdata[3]    - density, g/cm3 (=const)
    *                   e0, energy scale, erg/g (=const)
+   *                   temperature guess, K (0 if none); updated with the
+   *                   temperature of this call, so that the cell state is
+   *                   kept by the caller and cells can be burned concurrently
+   *                   With e0 = 0 the temperature rdata[2] is prescribed
+   *                   instead, and f[13] and the energy row and column of jac
+   *                   are zero: a burn along a given (rho, T) history
    *
    * Output:
    *     f[14]       - f[i] = dy[i]/dt, [1/sec]
@@ -174,10 +259,24 @@ private:
    *     1           - integrate this cell
    *
    *  Global parameters:
-   *     alphanet_epsder - increment of energy epsder*y(13) is used to calculate
-   *                       df(i)/dy(13) numerically
+   *     alphanet_dualder - df(i)/dy(13) from dual-number rates (default), else
+   *     alphanet_epsder  - increment of energy epsder*y(13) is used to calculate
+   *                        df(i)/dy(13) numerically
+   *  With exact = true df(i)/dy(13) is from dual-number rates whatever
+   *  alphanet_dualder, for the recovery of a failed burn.
+   *-----------------------------------------------------------------------------*/
+  int RHSFull(const Real y[NEQN], Real f[NEQN], Real jac[NEQN][NEQN], Real * rdata,
+              const bool exact=false);
+
+  /*-----------------------------------------------------------------------------
+   * RHSFull for BURN_LANES cells at once, one per lane, for the lockstep burn
+   * (<chemistry> burn_lockstep): the rates, f and jac are computed for all lanes
+   * together. Every lane must have e0 > 0. A lane that is too cold to burn gets
+   * f = 0 and jac = 0. The energy row of jac is always the numerical derivative,
+   * with increment alphanet_epsder.
    *-----------------------------------------------------------------------------*/
-  int RHSFull(const Real y[NEQN], Real f[NEQN], Real jac[NEQN][NEQN], Real * rdata);
+  void RHSLanes(const LaneReal y[NEQN], LaneReal f[NEQN], LaneReal jac[NEQN][NEQN],
+                LaneReal * rdata);
 
   //calculate Jacobian with numerical differentiation 
   void Jacobian_numerical(const Real t, const Real y[NSCALARS],
@@ -0,0 +1,339 @@
+//======================================================================================
+// Athena++ astrophysical MHD code
+// Copyright (C) 2014 James M. Stone  <jmstone@princeton.edu>
+//
+// This program is free software: you can redistribute and/or modify it under the terms
+// of the GNU General Public License (GPL) as published by the Free Software Foundation,
+// either version 3 of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+// PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+//
+// You should have received a copy of GNU GPL in the file LICENSE included in the code
+// distribution.  If not see <http://www.gnu.org/licenses/>.
+//======================================================================================
+//! \file alpha13_bench.cpp
+//  \brief microbenchmarks of the alpha13 network kernels
+//
+//  Times CalculateRates, RatesOfChange, PartialDerivatives, ScreeningFactors and
+//  ReverseRates on their own, at every point of a grid of nT9 temperatures and nrho
+//  densities, both spaced logarithmically. Each kernel is timed in two ways:
+//
+//    warm   nrep calls in a row with the same inputs, so that the tables of the
+//           network stay in cache; nsample such batches
+//    cold   one call after streaming through flush_kb of memory, which evicts the
+//           tables and the inputs; nsample such calls, less the cost of the clock
+//
+//  The mean time per call, the calls per second and the variance of the samples go to
+//  <problem_id>.json, with a fixed layout and key order so that the files of two
+//  commits can be diffed. Each kernel has a budget budget_<kernel> in ns per warm call:
+//  the run fails if the median over the grid is above it (0 disables the budget).
+//  The benchmark runs in the problem generator of the first MeshBlock, so use one rank,
+//  nlim = 0, and configure without -perf_counters.
+//======================================================================================
+
+// C++ headers
+#include <algorithm>  // std::sort()
+#include <chrono>     // steady_clock
+#include <cmath>      // std::pow()
+#include <fstream>    // ofstream
+#include <iomanip>    // setprecision
+#include <iostream>   // endl
+#include <sstream>    // stringstream
+#include <stdexcept>  // std::runtime_error()
+#include <string>     // c_str()
+#include <vector>     // vector container
+
+// Athena++ headers
+#include "../athena.hpp"
+#include "../athena_arrays.hpp"
+#include "../coordinates/coordinates.hpp"
+#include "../eos/eos.hpp"
+#include "../globals.hpp"
+#include "../hydro/hydro.hpp"
+#include "../mesh/mesh.hpp"
+#include "../parameter_input.hpp"
+#include "../scalars/scalars.hpp"
+
+#ifndef INCLUDE_CHEMISTRY
+#error "alpha13_bench.cpp requires a chemistry network, configure with --chemistry"
+#endif
+#ifndef ALPHA13_HPP
+#error "alpha13_bench.cpp times the alpha13 kernels, configure with --chemistry=alpha13"
+#endif
+
+namespace {
+enum {KRATES=0, KROC, KPARTIAL, KSCREEN, KREVERSE, NKERNEL};
+const char *kernel_names[NKERNEL] =
+    {"CalculateRates", "RatesOfChange", "PartialDerivatives", "ScreeningFactors",
+     "ReverseRates"};
+
+//statistics of the samples of one kernel at one grid point, in ns per call
+struct Timing {
+  Real mean, var;
+};
+
+typedef std::chrono::steady_clock Clock;
+volatile Real sink;               // keeps the timed calls from being optimized away
+std::vector<unsigned char> flush_buf;
+
+Real GridPoint(const Real vmin, const Real vmax, const int n, const int npts);
+Real Nanoseconds(const Clock::time_point t0, const Clock::time_point t1);
+Timing Statistics(const std::vector<Real> &t);
+void FlushCaches();
+void WriteTiming(std::ostream &os, const char *mode, const Timing &t);
+
+//! \fn Timing TimeWarm(F kernel, const int nrep, const int nsample)
+//  \brief ns per call of nrep calls in a row, over nsample batches
+template <typename F>
+Timing TimeWarm(F kernel, const int nrep, const int nsample) {
+  std::vector<Real> t(nsample);
+  kernel();
+  for (int s=0; s<nsample; ++s) {
+    Clock::time_point t0 = Clock::now();
+    for (int r=0; r<nrep; ++r) kernel();
+    t[s] = Nanoseconds(t0, Clock::now())/nrep;
+  }
+  return Statistics(t);
+}
+
+//! \fn Timing TimeCold(F kernel, const int nsample, const Real overhead)
+//  \brief ns of single calls after the caches are flushed, less the clock overhead
+template <typename F>
+Timing TimeCold(F kernel, const int nsample, const Real overhead) {
+  std::vector<Real> t(nsample);
+  for (int s=0; s<nsample; ++s) {
+    FlushCaches();
+    Clock::time_point t0 = Clock::now();
+    kernel();
+    t[s] = std::max(Nanoseconds(t0, Clock::now()) - overhead, static_cast<Real>(0.0));
+  }
+  return Statistics(t);
+}
+} // namespace
+
+//======================================================================================
+//! \fn void MeshBlock::ProblemGenerator(ParameterInput *pin)
+//  \brief uniform background; the first MeshBlock runs the benchmarks. The kernels are
+//  private to ChemNetwork, which lets MeshBlock call them.
+//======================================================================================
+
+void MeshBlock::ProblemGenerator(ParameterInput *pin) {
+  ChemNetwork &net = pscalars->chemnet;
+  //composition of the benchmark, mole fractions; by default equal mass fractions
+  Real y[ChemNetwork::NEQN];
+  for (int ispec=0; ispec < NSCALARS; ++ispec) {
+    y[ispec] = pin->GetOrAddReal("problem", "s_init_"+net.species_names[ispec],
+                                 1.0/(NSCALARS*ChemNetwork::MassNumber(ispec)));
+  }
+  y[ChemNetwork::NEQN-1] = 1.0;
+
+  const Real T9min = pin->GetOrAddReal("problem", "T9_min", 0.2);
+  const Real T9max = pin->GetOrAddReal("problem", "T9_max", 10.0);
+  const int nT9 = pin->GetOrAddInteger("problem", "nT9", 8);
+  const Real rho_min = pin->GetOrAddReal("problem", "rho_min", 1.e5);
+  const Real rho_max = pin->GetOrAddReal("problem", "rho_max", 1.e9);
+  const int nrho = pin->GetOrAddInteger("problem", "nrho", 3);
+
+  for (int k=ks; k<=ke; ++k) {
+    for (int j=js; j<=je; ++j) {
+      for (int i=is; i<=ie; ++i) {
+        phydro->u(IDN, k, j, i) = rho_min;
+        phydro->u(IM1, k, j, i) = 0.0;
+        phydro->u(IM2, k, j, i) = 0.0;
+        phydro->u(IM3, k, j, i) = 0.0;
+        if (NON_BAROTROPIC_EOS) {
+          phydro->u(IEN, k, j, i) = net.InternalEnergyDensity(rho_min, 1.e9*T9min, y);
+        }
+        for (int ispec=0; ispec < NSCALARS; ++ispec) {
+          pscalars->s(ispec, k, j, i) = y[ispec]*rho_min;
+        }
+      }
+    }
+  }
+  if (gid != 0) return;
+
+  const int nrep = pin->GetOrAddInteger("problem", "nrep", 1000);
+  const int nsample = pin->GetOrAddInteger("problem", "nsample", 20);
+  const int flush_kb = pin->GetOrAddInteger("problem", "flush_kb", 65536);
+  const std::string label = pin->GetOrAddString("problem", "label", "default");
+  const bool enforce = pin->GetOrAddBoolean("problem", "enforce_budget", true);
+  Real budget[NKERNEL];
+  for (int n=0; n<NKERNEL; ++n) {
+    budget[n] = pin->GetOrAddReal("problem", std::string("budget_") + kernel_names[n],
+                                  0.0);
+  }
+  if (nT9 < 1 || nrho < 1 || nrep < 1 || nsample < 2 || flush_kb < 1) {
+    std::stringstream msg;
+    msg << "### FATAL ERROR in MeshBlock::ProblemGenerator" << std::endl
+        << "need nT9, nrho, nrep, flush_kb >= 1 and nsample >= 2" << std::endl;
+    throw std::runtime_error(msg.str().c_str());
+  }
+  flush_buf.assign(static_cast<std::size_t>(flush_kb)*1024, 0);
+
+  //cost of reading the clock, taken off the single cold calls
+  std::vector<Real> tclock(1000);
+  for (std::size_t s=0; s<tclock.size(); ++s) {
+    Clock::time_point t0 = Clock::now();
+    tclock[s] = Nanoseconds(t0, Clock::now());
+  }
+  std::sort(tclock.begin(), tclock.end());
+  const Real overhead = tclock[tclock.size()/2];
+
+  //inputs and outputs of the kernels, set for every grid point
+  Real rho, t9, t9i;
+  Real frv[ChemNetwork::NREAC], rev[ChemNetwork::NREAC], fscr[ChemNetwork::NISO];
+  Real f[ChemNetwork::NEQN], df[ChemNetwork::NEQN][ChemNetwork::NEQN];
+  Real frv_out[ChemNetwork::NREAC], rev_out[ChemNetwork::NREAC];
+  auto rates = [&]() {
+    net.CalculateRates(rho, 1.e9*t9, frv_out, rev_out);
+    sink = frv_out[0];
+  };
+  auto roc = [&]() {
+    net.RatesOfChange(frv, rev, y, f);
+    sink = f[0];
+  };
+  auto partial = [&]() {
+    net.PartialDerivatives(frv, rev, y, f, df);
+    sink = df[0][0];
+  };
+  auto screen = [&]() {
+    net.ScreeningFactors(rho, t9i, fscr);
+    sink = fscr[0];
+  };
+  auto reverse = [&]() {
+    net.ReverseRates(rho, t9, fscr, rev_out);
+    sink = rev_out[0];
+  };
+
+  const int npts = nT9*nrho;
+  std::vector<Timing> warm(NKERNEL*npts), cold(NKERNEL*npts);
+  for (int m=0; m<nT9; ++m) {
+    for (int n=0; n<nrho; ++n) {
+      const int p = m*nrho + n;
+      t9 = GridPoint(T9min, T9max, m, nT9);
+      t9i = 1.0/t9;
+      rho = GridPoint(rho_min, rho_max, n, nrho);
+      net.CalculateRates(rho, 1.e9*t9, frv, rev);
+      net.ScreeningFactors(rho, t9i, fscr);
+      warm[KRATES*npts + p] = TimeWarm(rates, nrep, nsample);
+      warm[KROC*npts + p] = TimeWarm(roc, nrep, nsample);
+      warm[KPARTIAL*npts + p] = TimeWarm(partial, nrep, nsample);
+      warm[KSCREEN*npts + p] = TimeWarm(screen, nrep, nsample);
+      warm[KREVERSE*npts + p] = TimeWarm(reverse, nrep, nsample);
+      cold[KRATES*npts + p] = TimeCold(rates, nsample, overhead);
+      cold[KROC*npts + p] = TimeCold(roc, nsample, overhead);
+      cold[KPARTIAL*npts + p] = TimeCold(partial, nsample, overhead);
+      cold[KSCREEN*npts + p] = TimeCold(screen, nsample, overhead);
+      cold[KREVERSE*npts + p] = TimeCold(reverse, nsample, overhead);
+    }
+  }
+  flush_buf.clear();
+  flush_buf.shrink_to_fit();
+
+  //median over the grid of the warm time per call, checked against the budget
+  Real median[NKERNEL];
+  bool pass = true;
+  for (int k=0; k<NKERNEL; ++k) {
+    std::vector<Real> t(npts);
+    for (int p=0; p<npts; ++p) t[p] = warm[k*npts + p].mean;
+    std::sort(t.begin(), t.end());
+    median[k] = (npts % 2 == 1) ? t[npts/2] : 0.5*(t[npts/2 - 1] + t[npts/2]);
+    if (budget[k] > 0.0 && median[k] > budget[k]) pass = false;
+  }
+
+  std::string fname = pin->GetString("job", "problem_id") + ".json";
+  std::ofstream os(fname.c_str());
+  os << std::setprecision(6);
+  os << "{" << std::endl
+     << "  \"schema\": \"alpha13_bench/1\"," << std::endl
+     << "  \"label\": \"" << label << "\"," << std::endl
+     << "  \"config\": {\"nT9\": " << nT9 << ", \"T9_min\": " << T9min
+     << ", \"T9_max\": " << T9max << ", \"nrho\": " << nrho << ", \"rho_min\": "
+     << rho_min << ", \"rho_max\": " << rho_max << ", \"nrep\": " << nrep
+     << ", \"nsample\": " << nsample << ", \"flush_kb\": " << flush_kb
+     << ", \"clock_overhead_ns\": " << overhead << "}," << std::endl
+     << "  \"kernels\": [" << std::endl;
+  for (int k=0; k<NKERNEL; ++k) {
+    bool ok = !(budget[k] > 0.0 && median[k] > budget[k]);
+    os << "    {\"name\": \"" << kernel_names[k] << "\", \"budget_ns\": " << budget[k]
+       << ", \"warm_median_ns\": " << median[k] << ", \"within_budget\": "
+       << (ok ? "true" : "false") << "," << std::endl
+       << "     \"points\": [" << std::endl;
+    for (int p=0; p<npts; ++p) {
+      os << "       {\"T9\": " << GridPoint(T9min, T9max, p/nrho, nT9) << ", \"rho\": "
+         << GridPoint(rho_min, rho_max, p % nrho, nrho) << ", ";
+      WriteTiming(os, "warm", warm[k*npts + p]);
+      os << ", ";
+      WriteTiming(os, "cold", cold[k*npts + p]);
+      os << "}" << ((p < npts-1) ? "," : "") << std::endl;
+    }
+    os << "     ]}" << ((k < NKERNEL-1) ? "," : "") << std::endl;
+  }
+  os << "  ]" << std::endl << "}" << std::endl;
+  os.close();
+
+  std::cout << "alpha13 kernels [" << label << "], median ns per warm call:"
+            << std::endl << std::fixed << std::setprecision(1);
+  for (int k=0; k<NKERNEL; ++k) {
+    std::cout << "  " << std::setw(20) << std::left << kernel_names[k] << std::right
+              << std::setw(10) << median[k];
+    if (budget[k] > 0.0) {
+      std::cout << "  budget " << std::setw(8) << budget[k]
+                << ((median[k] > budget[k]) ? "  OVER" : "  ok");
+    }
+    std::cout << std::endl;
+  }
+  std::cout << "results in " << fname << std::endl;
+  std::cout.unsetf(std::ios_base::floatfield);
+  if (enforce && !pass) {
+    std::stringstream msg;
+    msg << "### FATAL ERROR in MeshBlock::ProblemGenerator" << std::endl
+        << "alpha13 kernels over their performance budget, see " << fname << std::endl;
+    throw std::runtime_error(msg.str().c_str());
+  }
+  return;
+}
+
+namespace {
+//! \fn Real GridPoint(const Real vmin, const Real vmax, const int n, const int npts)
+//  \brief point n of npts log-spaced in [vmin, vmax]
+Real GridPoint(const Real vmin, const Real vmax, const int n, const int npts) {
+  if (npts == 1) return vmin;
+  return vmin*std::pow(vmax/vmin, static_cast<Real>(n)/(npts - 1));
+}
+
+Real Nanoseconds(const Clock::time_point t0, const Clock::time_point t1) {
+  return std::chrono::duration<Real, std::nano>(t1 - t0).count();
+}
+
+//! \fn Timing Statistics(const std::vector<Real> &t)
+//  \brief mean and unbiased variance of the samples t
+Timing Statistics(const std::vector<Real> &t) {
+  Timing st;
+  const int n = static_cast<int>(t.size());
+  st.mean = 0.0;
+  for (int s=0; s<n; ++s) st.mean += t[s];
+  st.mean /= n;
+  st.var = 0.0;
+  for (int s=0; s<n; ++s) st.var += (t[s] - st.mean)*(t[s] - st.mean);
+  st.var /= (n - 1);
+  return st;
+}
+
+//! \fn void FlushCaches()
+//  \brief write one byte of every cache line of flush_buf, evicting everything else
+void FlushCaches() {
+  const std::size_t nbuf = flush_buf.size();
+  for (std::size_t n=0; n<nbuf; n+=64) flush_buf[n]++;
+  sink = flush_buf[nbuf/2];
+  return;
+}
+
+void WriteTiming(std::ostream &os, const char *mode, const Timing &t) {
+  os << "\"" << mode << "\": {\"ns_per_call\": " << t.mean << ", \"calls_per_s\": "
+     << ((t.mean > 0.0) ? 1.e9/t.mean : 0.0) << ", \"var_ns2\": " << t.var << "}";
+  return;
+}
+} // namespace
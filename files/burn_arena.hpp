@@ -0,0 +1,88 @@
+#ifndef CHEMISTRY_UTILS_BURN_ARENA_HPP_
+#define CHEMISTRY_UTILS_BURN_ARENA_HPP_
+//======================================================================================
+// Athena++ astrophysical MHD code
+// Copyright (C) 2014 James M. Stone  <jmstone@princeton.edu>
+// See LICENSE file for full public license information.
+//======================================================================================
+//! \file burn_arena.hpp
+//  \brief per-thread scratch memory of the coupled burn
+//
+//  The solver matrices of a cell are NBURN x NBURN, which for a network read from a
+//  file is too large for the stack of a worker thread, and the lockstep burn needs
+//  BURN_LANES times that. Instead of allocating them for every cell, each thread owns
+//  an arena: one buffer, reserved once before the first pass for the largest burn
+//  (BurnIntegrator::ArenaBytes), from which a burn takes its arrays by bumping an
+//  offset and gives them back all at once when its Scope ends. In the steady state a
+//  pass over a MeshBlock does no heap allocation, and threads never contend for the
+//  allocator.
+//======================================================================================
+
+// C++ headers
+#include <cstddef>    // size_t
+#include <sstream>    // stringstream
+#include <stdexcept>  // std::runtime_error()
+#include <vector>     // vector
+
+// Athena++ headers
+#include "../../athena.hpp"
+
+//! \class BurnArena
+//  \brief bump allocator over a buffer reserved up front; not thread safe, one per thread
+class BurnArena {
+ public:
+  BurnArena() : base_(nullptr), size_(0), used_(0) {}
+  BurnArena(const BurnArena &) = delete;
+  BurnArena &operator=(const BurnArena &) = delete;
+
+  //grow the buffer to at least bytes; only between burns, as it moves the buffer
+  void Reserve(const std::size_t bytes) {
+    if (bytes <= size_) return;
+    size_ = Bytes<char>(bytes);
+    buf_.resize((size_ + LINE)/sizeof(Real));
+    //first cache-line boundary of the buffer
+    std::size_t addr = reinterpret_cast<std::size_t>(buf_.data());
+    base_ = reinterpret_cast<char *>(buf_.data()) + (LINE - addr%LINE)%LINE;
+  }
+  //uninitialized array of n T, on cache lines of its own
+  template <typename T>
+  T *Take(const std::size_t n) {
+    static_assert(alignof(T) <= LINE, "BurnArena: over-aligned type");
+    const std::size_t bytes = Bytes<T>(n);
+    if (used_ + bytes > size_) {
+      std::stringstream msg;
+      msg << "### FATAL ERROR in BurnArena::Take" << std::endl
+          << "burn scratch of " << used_ + bytes << " bytes exceeds the " << size_
+          << " bytes reserved" << std::endl;
+      throw std::runtime_error(msg.str().c_str());
+    }
+    T *p = reinterpret_cast<T *>(base_ + used_);
+    used_ += bytes;
+    return p;
+  }
+
+  //everything taken while a Scope lives is given back when it ends
+  class Scope {
+   public:
+    explicit Scope(BurnArena *pa) : pa_(pa), mark_(pa->used_) {}
+    ~Scope() {pa_->used_ = mark_;}
+   private:
+    BurnArena *pa_;
+    std::size_t mark_;
+  };
+
+  //bytes taken by an array of n T, with the padding to a cache line
+  template <typename T>
+  static std::size_t Bytes(const std::size_t n) {
+    return (n*sizeof(T) + LINE - 1)/LINE*LINE;
+  }
+
+ private:
+  static const std::size_t LINE = 64;
+  std::vector<Real> buf_;
+  char *base_;        // start of the usable buffer, cache-line aligned
+  std::size_t size_;  // usable bytes
+  std::size_t used_;  // bytes taken
+};
+
+#endif // CHEMISTRY_UTILS_BURN_ARENA_HPP_
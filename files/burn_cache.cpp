@@ -0,0 +1,121 @@
+//======================================================================================
+// Athena++ astrophysical MHD code
+// Copyright (C) 2014 James M. Stone  <jmstone@princeton.edu>
+// See LICENSE file for full public license information.
+//======================================================================================
+//! \file burn_cache.cpp
+//  \brief implementation of the per-step cache of coupled burn results
+//======================================================================================
+
+// C++ headers
+#include <cmath>    // std::log(), std::log1p(), std::llround()
+#include <cstring>  // std::memcpy()
+#include <limits>   // std::numeric_limits
+#include <utility>  // std::make_pair()
+
+// Athena++ headers
+#include "../../athena.hpp"
+#include "burn_cache.hpp"
+
+BurnCache::BurnCache() :
+    nlookup(0), nhit(0), tol_(0.0), yfloor_(0.0), dlog_(0.0), cycle_(-1) {}
+
+void BurnCache::Init(const Real tol, const Real yfloor) {
+  std::lock_guard<std::mutex> lock(lock_);
+  tol_ = (tol > 0.0) ? tol : 0.0;
+  yfloor_ = yfloor;
+  dlog_ = (tol_ > 0.0) ? 1.0/std::log1p(tol_) : 0.0;
+  map_.clear();
+  return;
+}
+
+//--------------------------------------------------------------------------------------
+//! \fn void BurnCache::NewCycle(const int ncycle)
+//  \brief drop the entries of earlier cycles
+
+void BurnCache::NewCycle(const int ncycle) {
+  std::lock_guard<std::mutex> lock(lock_);
+  if (ncycle != cycle_) {
+    map_.clear();
+    cycle_ = ncycle;
+  }
+  return;
+}
+
+//--------------------------------------------------------------------------------------
+//! \fn BurnCache::Key BurnCache::MakeKey(const Real dt, const Real rho, const Real e0,
+//                                         const Real h, const Real temp,
+//                                         const bool stiff, const Real y[NBURN]) const
+//  \brief bucket of a cell. The trial step and temperature guess only change the
+//  result within the solver tolerances, and are part of the key for bitwise keys only.
+
+BurnCache::Key BurnCache::MakeKey(const Real dt, const Real rho, const Real e0,
+                                  const Real h, const Real temp, const bool stiff,
+                                  const Real y[NBURN]) const {
+  Key key;
+  key[0] = Quantize(dt, 0.0);
+  key[1] = Quantize(rho, 0.0);
+  key[2] = Quantize(e0, 0.0);
+  key[3] = (tol_ > 0.0) ? 0 : Quantize(h, 0.0);
+  key[4] = (tol_ > 0.0) ? 0 : Quantize(temp, 0.0);
+  key[5] = stiff ? 1 : 0;
+  for (int n=0; n<NSCALARS; ++n) key[6+n] = Quantize(y[n], yfloor_);
+  return key;
+}
+
+//--------------------------------------------------------------------------------------
+//! \fn bool BurnCache::Find(const Key &key, Result *res)
+//  \brief look up the result of the bucket key
+
+bool BurnCache::Find(const Key &key, Result *res) {
+  std::lock_guard<std::mutex> lock(lock_);
+  nlookup++;
+  auto it = map_.find(key);
+  if (it == map_.end()) return false;
+  nhit++;
+  *res = it->second;
+  return true;
+}
+
+//--------------------------------------------------------------------------------------
+//! \fn void BurnCache::Insert(const Key &key, const Result &res)
+//  \brief store the result of the bucket key. Two threads may integrate the same
+//  bucket concurrently; the first result stays.
+
+void BurnCache::Insert(const Key &key, const Result &res) {
+  std::lock_guard<std::mutex> lock(lock_);
+  map_.insert(std::make_pair(key, res));
+  return;
+}
+
+//--------------------------------------------------------------------------------------
+//! \fn std::int64_t BurnCache::Quantize(const Real x, const Real floor) const
+//  \brief bit pattern of x (tol = 0), or index of its logarithmic bin. Values not
+//  above floor share one bin.
+
+std::int64_t BurnCache::Quantize(const Real x, const Real floor) const {
+  if (tol_ == 0.0) {
+    double xd = static_cast<double>(x);
+    std::int64_t bits;
+    std::memcpy(&bits, &xd, sizeof(bits));
+    return bits;
+  }
+  if (!(x > floor) || !(x > 0.0)) return std::numeric_limits<std::int64_t>::min();
+  return static_cast<std::int64_t>(std::llround(std::log(x)*dlog_));
+}
+
+//--------------------------------------------------------------------------------------
+//! \fn std::size_t BurnCache::KeyHash::operator()(const Key &key) const
+//  \brief FNV-1a over the key words
+
+std::size_t BurnCache::KeyHash::operator()(const Key &key) const {
+  std::uint64_t hash = 14695981039346656037ULL;
+  for (int n=0; n<NKEY; ++n) {
+    std::uint64_t w = static_cast<std::uint64_t>(key[n]);
+    for (int b=0; b<8; ++b) {
+      hash ^= (w >> (8*b)) & 0xff;
+      hash *= 1099511628211ULL;
+    }
+  }
+  return static_cast<std::size_t>(hash);
+}
@@ -0,0 +1,79 @@
+#ifndef CHEMISTRY_UTILS_BURN_CACHE_HPP_
+#define CHEMISTRY_UTILS_BURN_CACHE_HPP_
+//======================================================================================
+// Athena++ astrophysical MHD code
+// Copyright (C) 2014 James M. Stone  <jmstone@princeton.edu>
+// See LICENSE file for full public license information.
+//======================================================================================
+//! \file burn_cache.hpp
+//  \brief per-step cache of coupled burn results, shared by the MeshBlocks of a rank
+//
+//  Uniform regions (unshocked fuel, uniform ash, the cells of nuc_uniform) hold many
+//  cells in the same state, each of which would be integrated on its own. The cache
+//  keys a cell by its quantized density, specific energy, abundances and step; the
+//  first cell of a bucket is integrated and every later cell of the bucket copies its
+//  result. The scaled energy y[13] = 1 at the start of a burn, so e0 stands for it.
+//
+//  With <chemistry> burn_cache_tol = 0 (default) the keys are the bit patterns of the
+//  values, together with the trial step, temperature guess and stiffness flag the
+//  integration starts from, so that a hit gives bit for bit the result the cell would
+//  have computed. With tol > 0 the values are binned logarithmically with a relative
+//  width tol, and abundances below burn_abstol share one bin. The entries are dropped
+//  at every new cycle.
+//======================================================================================
+
+// C++ headers
+#include <array>          // array
+#include <cstdint>        // int64_t
+#include <mutex>          // mutex
+#include <unordered_map>  // unordered_map
+
+// Athena++ headers
+#include "../../athena.hpp"
+
+//! \class BurnCache
+//  \brief results of the coupled burn of one cycle, keyed by the quantized cell state
+class BurnCache {
+ public:
+  static const int NBURN = NSCALARS + 1;
+  //dt, rho, e0, trial step, temperature guess, stiffness flag and abundances
+  static const int NKEY = NSCALARS + 6;
+  typedef std::array<std::int64_t, NKEY> Key;
+
+  //burned state of a representative cell
+  struct Result {
+    Real y[NBURN];
+    Real h, temp;
+    bool stiff;
+  };
+
+  BurnCache();
+
+  //relative bin width (0: bitwise keys) and abundance floor
+  void Init(const Real tol, const Real yfloor);
+  //start of a burn in cycle ncycle; entries of earlier cycles are dropped
+  void NewCycle(const int ncycle);
+  Key MakeKey(const Real dt, const Real rho, const Real e0, const Real h,
+              const Real temp, const bool stiff, const Real y[NBURN]) const;
+  //copy the result for key into res and return true, if there is one. Thread safe.
+  bool Find(const Key &key, Result *res);
+  //store the result of the representative of key. Thread safe.
+  void Insert(const Key &key, const Result &res);
+
+  long nlookup;  // lookups since the start of the run
+  long nhit;     // lookups that found a result
+
+ private:
+  struct KeyHash {
+    std::size_t operator()(const Key &key) const;
+  };
+  Real tol_, yfloor_;
+  Real dlog_;  // 1/log(1 + tol)
+  int cycle_;
+  std::mutex lock_;
+  std::unordered_map<Key, Result, KeyHash> map_;
+
+  std::int64_t Quantize(const Real x, const Real floor) const;
+};
+
+#endif // CHEMISTRY_UTILS_BURN_CACHE_HPP_
@@ -0,0 +1,1290 @@
+//======================================================================================
+// Athena++ astrophysical MHD code
+// Copyright (C) 2014 James M. Stone  <jmstone@princeton.edu>
+// See LICENSE file for full public license information.
+//======================================================================================
+//! \file burn_integrator.cpp
+//  \brief implementation of the coupled abundance-energy burn
+//======================================================================================
+
+// C headers
+#include <float.h>    // FLT_MAX
+
+// C++ headers
+#include <algorithm>  // std::min(), std::max()
+#include <atomic>     // atomic
+#include <cmath>      // std::abs(), std::pow()
+#include <iostream>   // cout, endl
+#include <sstream>    // stringstream
+#include <stdexcept>  // std::runtime_error()
+#include <string>     // string
+
+// Athena++ headers
+#include "../../athena.hpp"
+#include "../../athena_arrays.hpp"
+#include "../../eos/eos.hpp"
+#include "../../hydro/hydro.hpp"
+#include "../../mesh/mesh.hpp"
+#include "../../parameter_input.hpp"
+#include "../../scalars/scalars.hpp"
+#include "burn_cache.hpp"
+#include "burn_integrator.hpp"
+#include "burn_surrogate.hpp"
+#include "burn_tuning.hpp"
+#include "perf_counters.hpp"
+#include "simd_lanes.hpp"
+
+namespace {
+const int N = BurnIntegrator::NBURN;
+
+// Rodas3 coefficients (Sandu et al. 1997): 4 stages, 3rd order with an embedded
+// 2nd order estimate, L-stable and stiffly accurate
+const Real GAM = 0.5;
+const Real A31 = 2.0;  // a21 = a32 = a42 = 0, so stage 2 reuses f(y)
+const Real A41 = 2.0;
+const Real A43 = 1.0;
+const Real C21 = 4.0;
+const Real C31 = 1.0;
+const Real C32 = -1.0;
+const Real C41 = 1.0;
+const Real C42 = -1.0;
+const Real C43 = -8.0/3.0;
+// y_new = y + 2 k1 + k3 + k4, error estimate k4
+
+// Dormand-Prince RK5(4) coefficients for the explicit steps, with the error
+// coefficients E = b - b* of the embedded 4th order solution
+const Real DP21 = 1.0/5.0;
+const Real DP31 = 3.0/40.0;
+const Real DP32 = 9.0/40.0;
+const Real DP41 = 44.0/45.0;
+const Real DP42 = -56.0/15.0;
+const Real DP43 = 32.0/9.0;
+const Real DP51 = 19372.0/6561.0;
+const Real DP52 = -25360.0/2187.0;
+const Real DP53 = 64448.0/6561.0;
+const Real DP54 = -212.0/729.0;
+const Real DP61 = 9017.0/3168.0;
+const Real DP62 = -355.0/33.0;
+const Real DP63 = 46732.0/5247.0;
+const Real DP64 = 49.0/176.0;
+const Real DP65 = -5103.0/18656.0;
+const Real DP71 = 35.0/384.0;
+const Real DP73 = 500.0/1113.0;
+const Real DP74 = 125.0/192.0;
+const Real DP75 = -2187.0/6784.0;
+const Real DP76 = 11.0/84.0;
+const Real DPE1 = 71.0/57600.0;
+const Real DPE3 = -71.0/16695.0;
+const Real DPE4 = 71.0/1920.0;
+const Real DPE5 = -17253.0/339200.0;
+const Real DPE6 = 22.0/525.0;
+const Real DPE7 = -1.0/40.0;
+// stiffness detection: h*|lambda| beyond HLAMB_STIFF, about the stability boundary of
+// RK5(4) on the negative real axis, in NSTIFF accepted steps without NSTIFF non-stiff
+// steps in between; NPOWER power iterations for the spectral radius
+const Real HLAMB_STIFF = 3.25;
+const int NSTIFF = 5;
+const int NPOWER = 8;
+
+// step size control
+const Real FACSAFE = 0.9;
+const Real FACMIN = 0.2;
+const Real FACMAX = 6.0;
+
+// lockstep burn: largest last Newton correction of a substep, in units of the
+// tolerances, and the local error constants of backward Euler and BDF2
+const Real NEWTON_TOL = 0.2;
+const Real ERR_BE = 0.5;
+// the first substep, backward Euler, is this fraction of dt/nsub; the second, BDF2,
+// the rest of it
+const Real LOCK_START = 0.25;
+
+// recovery ladder: the last rung, backward Euler, takes at most BE_NEWTON simplified
+// Newton iterations per step, done once the correction is below BE_NEWTON_TOL in units
+// of the tolerances
+const int BE_NEWTON = 8;
+const Real BE_NEWTON_TOL = 0.1;
+const char *const RECOVER_RUNG[BurnIntegrator::NRUNG] = {
+  "a small first step", "the exact Jacobian", "substeps", "backward Euler"};
+// recoveries of the rank logged so far
+std::atomic<long> nrecover_log(0);
+
+// mixed-precision linear solves: at most REFINE_MAX refinement steps, done once the
+// correction is below REFINE_TOL in units of the tolerances, so that mass and energy
+// drift no more than with the Real LU
+const int REFINE_MAX = 2;
+const Real REFINE_TOL = 1.0e-6;
+
+// burn cache, regime table and surrogate table of the rank, shared by the MeshBlocks
+// like the EOS table of the network
+BurnCache burn_cache;
+BurnTuning burn_tuning;
+BurnSurrogate burn_surrogate;
+
+template <typename T>
+int LUDecompose(T a[N][N], int indx[N]);
+template <typename T>
+void LUSolve(const T a[N][N], const int indx[N], T b[N]);
+int Factor(Real a[N][N], float af[N][N], int indx[N], bool *lu_double);
+bool Solve(Real a[N][N], const float af[N][N], int indx[N], const Real wt[N],
+           bool *lu_double, Real b[N]);
+bool RefinedSolve(const Real a[N][N], const float af[N][N], const int indx[N],
+                  const Real wt[N], Real b[N]);
+void LaneLUDecompose(LaneReal a[][N], int indx[][BURN_LANES], bool singular[]);
+void LaneLUSolve(const LaneReal a[][N], const int indx[][BURN_LANES], LaneReal b[]);
+} // namespace
+
+BurnCache *BurnIntegrator::pcache = nullptr;
+BurnTuning *BurnIntegrator::ptune = nullptr;
+BurnSurrogate *BurnIntegrator::psurr = nullptr;
+std::atomic<long> BurnIntegrator::nrecover[BurnIntegrator::NRUNG + 1];
+bool BurnIntegrator::driven = false;
+
+BurnIntegrator::BurnIntegrator(ChemNetwork *pnet, MeshBlock *pmb, ParameterInput *pin) :
+    pmy_net_(pnet), pmy_mb_(pmb) {
+  //burn_explicit: start every cell that was not stiff at the end of its last burn with
+  //the explicit method, which needs neither Jacobian nor LU, and switch it to Rodas3
+  //once a stiffness test on its accepted steps fires
+  set_.rtol = pin->GetOrAddReal("chemistry", "burn_reltol", 1.0e-6);
+  set_.atol = pin->GetOrAddReal("chemistry", "burn_abstol", 1.0e-12);
+  set_.maxsteps = pin->GetOrAddInteger("chemistry", "burn_maxsteps", 100000);
+  set_.expl = pin->GetOrAddBoolean("chemistry", "burn_explicit", true);
+  set_.hinit = 1.0;
+  //the scalars are stored species by species, s(n,k,j,i); the burn gathers burn_tile
+  //cells along x1 into a cell-major buffer and scatters them back after it
+  ntile_ = pin->GetOrAddInteger("chemistry", "burn_tile", 64);
+  if (ntile_ < 1) ntile_ = 1;
+  //burn_lockstep: the cells of a tile whose last burn took at most
+  //burn_lockstep_maxsteps adaptive steps, or passed in lockstep, are burned BURN_LANES
+  //at a time with one cell per SIMD lane, in burn_lockstep_nsub fixed substeps of
+  //burn_lockstep_newton Newton iterations each (see LockstepBurn). It only pays off with
+  //vectorized exp() and log(), which the rates are made of.
+  lockstep_ = pin->GetOrAddBoolean("chemistry", "burn_lockstep", false);
+  lock_nsub_ = std::max(1, pin->GetOrAddInteger("chemistry", "burn_lockstep_nsub", 2));
+  lock_newton_ = std::max(1,
+      pin->GetOrAddInteger("chemistry", "burn_lockstep_newton", 3));
+  lock_maxsteps_ = pin->GetOrAddInteger("chemistry", "burn_lockstep_maxsteps", 2);
+  //burn_lu = mixed: float LU of the Rosenbrock matrices with Real refinement, see
+  //RosenbrockSteps; the lockstep burn and the recovery stay in Real
+  std::string lu = pin->GetOrAddString("chemistry", "burn_lu", "double");
+  if (lu != "double" && lu != "mixed") {
+    std::stringstream msg;
+    msg << "### FATAL ERROR in BurnIntegrator constructor" << std::endl
+        << "<chemistry> burn_lu = " << lu << " is not double or mixed" << std::endl;
+    throw std::runtime_error(msg.str().c_str());
+  }
+  mixed_lu_ = (lu == "mixed");
+  //burn_recover: a cell whose burn fails is burned again down the recovery ladder of
+  //RecoverCell, with a first trial step of burn_recover_hinit of dt, burn_recover_nsub
+  //substeps on the third rung and burn_recover_steps times burn_maxsteps steps on the
+  //implicit rungs; the first burn_recover_log recoveries of the rank are logged
+  recover_ = pin->GetOrAddBoolean("chemistry", "burn_recover", true);
+  recover_hinit_ = pin->GetOrAddReal("chemistry", "burn_recover_hinit", 1.0e-6);
+  recover_nsub_ = std::max(1, pin->GetOrAddInteger("chemistry", "burn_recover_nsub", 16));
+  recover_steps_ = std::max(1,
+      pin->GetOrAddInteger("chemistry", "burn_recover_steps", 10));
+  recover_log_ = pin->GetOrAddInteger("chemistry", "burn_recover_log", 20);
+  //the first MeshBlock sets up the cache of the rank, which integrates the cells in the
+  //same state within a cycle once (see burn_cache.hpp)
+  if (pin->GetOrAddBoolean("chemistry", "burn_cache", false) && pcache == nullptr) {
+    burn_cache.Init(pin->GetOrAddReal("chemistry", "burn_cache_tol", 0.0), set_.atol);
+    pcache = &burn_cache;
+  }
+  //and reads the regime table written by the tuner of onezone_burn: the settings of the
+  //cells in a regime of the table are its own (see CellSettings and burn_tuning.hpp)
+  std::string tune_file = pin->GetOrAddString("chemistry", "burn_tune_file", "");
+  if (!tune_file.empty() && ptune == nullptr) {
+    burn_tuning.Read(tune_file, true);
+    ptune = &burn_tuning;
+  }
+  ptune_ = ptune;
+  //and the table of small burns, which cells whose burn over the step is small and
+  //smooth interpolate instead of integrating (see burn_surrogate.hpp)
+  std::string surr_file = pin->GetOrAddString("chemistry", "burn_surrogate_file", "");
+  if (!surr_file.empty() && psurr == nullptr) {
+    burn_surrogate.Read(surr_file,
+                        pin->GetOrAddReal("chemistry", "burn_surrogate_xother", 1.0e-3));
+    psurr = &burn_surrogate;
+  }
+  arena_.Reserve(ArenaBytes());
+  if (pmb == nullptr) return;
+  nsteps.NewAthenaArray(pmb->ncells3, pmb->ncells2, pmb->ncells1);
+  stiff.NewAthenaArray(pmb->ncells3, pmb->ncells2, pmb->ncells1);
+  h_.NewAthenaArray(pmb->ncells3, pmb->ncells2, pmb->ncells1);
+  if (lockstep_) lanes_.NewAthenaArray(pmb->ncells3, pmb->ncells2, pmb->ncells1);
+}
+
+BurnIntegrator::~BurnIntegrator() {
+  nsteps.DeleteAthenaArray();
+  stiff.DeleteAthenaArray();
+  h_.DeleteAthenaArray();
+  lanes_.DeleteAthenaArray();
+}
+
+//--------------------------------------------------------------------------------------
+//! \fn std::size_t BurnIntegrator::ArenaBytes() const
+//  \brief scratch of one thread: a tile, and the matrices of one Rosenbrock or
+//  lockstep burn, which are never taken at the same time
+
+std::size_t BurnIntegrator::ArenaBytes() const {
+  std::size_t cell = 2*BurnArena::Bytes<Real>(N*N);
+  if (mixed_lu_) cell += BurnArena::Bytes<float>(N*N);
+  if (lockstep_) cell = std::max(cell, 2*BurnArena::Bytes<LaneReal>(N*N));
+  return BurnArena::Bytes<Real>(ntile_*N) + cell;
+}
+
+//--------------------------------------------------------------------------------------
+//! \fn void BurnIntegrator::BurnMeshBlock(const Real dt)
+//  \brief burn every active cell over dt and deposit the released energy
+
+void BurnIntegrator::BurnMeshBlock(const Real dt) {
+  MeshBlock *pmb = pmy_mb_;
+  for (int k=pmb->ks; k<=pmb->ke; ++k) {
+    for (int j=pmb->js; j<=pmb->je; ++j) {
+      for (int il=pmb->is; il<=pmb->ie; il+=ntile_) {
+        BurnTile(dt, k, j, il, std::min(il + ntile_ - 1, pmb->ie), &arena_);
+      }
+    }
+  }
+  return;
+}
+
+//--------------------------------------------------------------------------------------
+//! \fn void BurnIntegrator::BurnTile(const Real dt, const int k, const int j,
+//                                     const int il, const int iu, BurnArena *arena)
+//  \brief burn cells il..iu of row (k,j) over dt and deposit the released energy.
+//  Tiles of different cells may be burned concurrently, each with its own arena.
+
+void BurnIntegrator::BurnTile(const Real dt, const int k, const int j, const int il,
+                              const int iu, BurnArena *arena) {
+  MeshBlock *pmb = pmy_mb_;
+  ChemNetwork *pnet = pmy_net_;
+  AthenaArray<Real> &s = pmb->pscalars->s;
+  AthenaArray<Real> &r = pmb->pscalars->r;
+  AthenaArray<Real> &w = pmb->phydro->w;
+  const Real gm1 = pmb->peos->GetGamma() - 1.0;
+  const Real dt_s = dt*pnet->unit_time_in_s_;
+  if (pcache != nullptr) pcache->NewCycle(pmb->pmy_mesh->ncycle);
+  BurnArena::Scope scope(arena);
+  Real *ytile = arena->Take<Real>((iu-il+1)*NBURN);
+  //gather: one contiguous sweep along i per species stream
+  {
+    PERF_SCOPE(PERF_GATHER, NSCALARS*(iu-il+1), 0);
+    for (int n=0; n<NSCALARS; ++n) {
+      for (int i=il; i<=iu; ++i) {
+        ytile[(i-il)*NBURN + n] = s(n, k, j, i)/w(IDN, k, j, i);
+      }
+    }
+  }
+  //easy cells wait here until there are BURN_LANES of them to burn in lockstep
+  int nlane = 0;
+  int lane_i[BURN_LANES];
+  Real lane_rho[BURN_LANES], lane_e0[BURN_LANES];
+  Real *lane_y[BURN_LANES];
+  for (int i=il; i<=iu; ++i) {
+    Real *y = &ytile[(i-il)*NBURN];
+    const Real rho = pnet->CellDensity(k, j, i);
+    const Real ED = w(IPR, k, j, i)/gm1;
+    const Real e0 = ED*pnet->unit_E_in_cgs_/rho;
+    y[NSCALARS] = 1.0;
+    if (!(e0 > 0.0)) {
+      nsteps(k, j, i) = 0;
+      if (lockstep_) lanes_(k, j, i) = 0;
+      continue;
+    }
+    if (psurr != nullptr) {
+      //a small burn: the change of the abundances from the table, and the energy
+      //from the change of binding energy; it bypasses the lockstep burn and the cache
+      Real tguess = pnet->eos_.IsTable() ? pnet->temp_cache_(k, j, i) : 0.0;
+      Real temp = CellTemperature(rho, e0, y, tguess);
+      const Real b0 = pnet->BindingEnergy(y);
+      if (psurr->Burn(rho, temp, dt_s, y)) {
+        y[NSCALARS] += (pnet->BindingEnergy(y) - b0)/e0;
+        if (lockstep_) lanes_(k, j, i) = 0;
+        FinishCell(k, j, i, rho, e0, y, h_(k, j, i), temp, stiff(k, j, i) != 0, 0);
+        continue;
+      }
+    }
+    if (lockstep_ && (lanes_(k, j, i) > 0 || (lanes_(k, j, i) == 0 &&
+        nsteps(k, j, i) > 0 && nsteps(k, j, i) <= lock_maxsteps_))) {
+      lane_i[nlane] = i;
+      lane_rho[nlane] = rho;
+      lane_e0[nlane] = e0;
+      lane_y[nlane] = y;
+      if (++nlane == BURN_LANES) {
+        BurnLanes(dt_s, k, j, nlane, lane_i, lane_rho, lane_e0, lane_y, arena);
+        nlane = 0;
+      }
+      continue;
+    }
+    Real h = h_(k, j, i);
+    Real temp = pnet->eos_.IsTable() ? pnet->temp_cache_(k, j, i) : 0.0;
+    bool is_stiff = (stiff(k, j, i) != 0);
+    int nstep;
+    BurnCache::Result res;
+    BurnCache::Key key;
+    if (pcache != nullptr) {
+      key = pcache->MakeKey(dt_s, rho, e0, h, temp, is_stiff, y);
+    }
+    if (pcache != nullptr && pcache->Find(key, &res)) {
+      //a cell in the same state was burned already
+      for (int n=0; n<NBURN; ++n) y[n] = res.y[n];
+      h = res.h;
+      temp = res.temp;
+      is_stiff = res.stiff;
+      nstep = 0;
+    } else {
+      Real y0[NBURN];
+      for (int n=0; n<NBURN; ++n) y0[n] = y[n];
+      nstep = IntegrateCell(rho, e0, dt_s, y, &h, &temp, &is_stiff, arena);
+      if (nstep < 0) {
+        std::stringstream cell;
+        cell << "cell (" << k << "," << j << "," << i << ") of MeshBlock " << pmb->gid;
+        nstep = RecoverCell(cell.str(), rho, e0, dt_s, y0, y, &h, &temp, &is_stiff,
+                            arena);
+      }
+      if (nstep < 0) {
+        std::stringstream msg;
+        msg << "### FATAL ERROR in BurnIntegrator::BurnTile" << std::endl
+            << "burn failed in cell (" << k << "," << j << "," << i << ") of MeshBlock "
+            << pmb->gid << ", rho = " << rho << ", e = " << e0 << std::endl;
+        throw std::runtime_error(msg.str().c_str());
+      }
+      if (pcache != nullptr) {
+        for (int n=0; n<NBURN; ++n) res.y[n] = y[n];
+        res.h = h;
+        res.temp = temp;
+        res.stiff = is_stiff;
+        pcache->Insert(key, res);
+      }
+    }
+    if (lockstep_) lanes_(k, j, i) = 0;
+    FinishCell(k, j, i, rho, e0, y, h, temp, is_stiff, nstep);
+  }
+  if (nlane > 0) {
+    BurnLanes(dt_s, k, j, nlane, lane_i, lane_rho, lane_e0, lane_y, arena);
+  }
+  //scatter back, again one sweep per species
+  {
+    PERF_SCOPE(PERF_GATHER, NSCALARS*(iu-il+1), 0);
+    for (int n=0; n<NSCALARS; ++n) {
+      for (int i=il; i<=iu; ++i) {
+        Real yn = ytile[(i-il)*NBURN + n];
+        yn = (yn > 0.0) ? yn : 0.0;
+        s(n, k, j, i) = yn*w(IDN, k, j, i);
+        r(n, k, j, i) = yn;
+      }
+    }
+  }
+  return;
+}
+
+//--------------------------------------------------------------------------------------
+//! \fn void BurnIntegrator::FinishCell(const int k, const int j, const int i,
+//                                      const Real rho, const Real e0,
+//                                      const Real y[NBURN], const Real h,
+//                                      const Real temp, const bool is_stiff,
+//                                      const int nstep)
+//  \brief keep the state of a burned cell for its next burn and deposit the released
+//  energy; the abundances are scattered back with the rest of the tile
+
+void BurnIntegrator::FinishCell(const int k, const int j, const int i, const Real rho,
+                                const Real e0, const Real y[NBURN], const Real h,
+                                const Real temp, const bool is_stiff, const int nstep) {
+  MeshBlock *pmb = pmy_mb_;
+  ChemNetwork *pnet = pmy_net_;
+  const Real gm1 = pmb->peos->GetGamma() - 1.0;
+  nsteps(k, j, i) = nstep;
+  stiff(k, j, i) = is_stiff ? 1 : 0;
+  h_(k, j, i) = h;
+  if (pnet->eos_.IsTable()) pnet->temp_cache_(k, j, i) = temp;
+  //released energy, code units
+  Real dED = rho*(y[NSCALARS] - 1.0)*e0/pnet->unit_E_in_cgs_;
+  pmb->phydro->u(IEN, k, j, i) += dED;
+  pmb->phydro->w(IPR, k, j, i) += gm1*dED;
+  return;
+}
+
+//--------------------------------------------------------------------------------------
+//! \fn void BurnIntegrator::BurnLanes(const Real dt, const int k, const int j,
+//                                     const int nlane, const int lane_i[],
+//                                     const Real lane_rho[], const Real lane_e0[],
+//                                     Real *lane_y[], BurnArena *arena)
+//  \brief burn cells lane_i[0..nlane-1] of row (k,j), nlane <= BURN_LANES, over dt (s)
+//  in lockstep; the cells whose lane fails its checks are burned again from their
+//  initial state by IntegrateCell, and sit out the lockstep for their next burn.
+//  lane_y are the compositions of the cells in the tile buffer. Lockstep cells bypass
+//  the burn cache.
+
+void BurnIntegrator::BurnLanes(const Real dt, const int k, const int j, const int nlane,
+                               const int lane_i[], const Real lane_rho[],
+                               const Real lane_e0[], Real *lane_y[],
+                               BurnArena *arena) {
+  ChemNetwork *pnet = pmy_net_;
+  Real temp[BURN_LANES];
+  bool ok[BURN_LANES];
+  for (int l=0; l<nlane; ++l) {
+    temp[l] = pnet->eos_.IsTable() ? pnet->temp_cache_(k, j, lane_i[l]) : 0.0;
+  }
+  LockstepBurn(nlane, lane_rho, lane_e0, dt, lane_y, temp, ok, arena);
+  for (int l=0; l<nlane; ++l) {
+    const int i = lane_i[l];
+    Real h = h_(k, j, i);
+    bool is_stiff = (stiff(k, j, i) != 0);
+    int nstep = lock_nsub_ + 1;
+    if (!ok[l]) {
+      //the lockstep burn left the cell at its initial state
+      temp[l] = pnet->eos_.IsTable() ? pnet->temp_cache_(k, j, i) : 0.0;
+      Real y0[NBURN];
+      for (int n=0; n<NBURN; ++n) y0[n] = lane_y[l][n];
+      nstep = IntegrateCell(lane_rho[l], lane_e0[l], dt, lane_y[l], &h, &temp[l],
+                            &is_stiff, arena);
+      if (nstep < 0) {
+        std::stringstream cell;
+        cell << "cell (" << k << "," << j << "," << i << ") of MeshBlock "
+             << pmy_mb_->gid;
+        nstep = RecoverCell(cell.str(), lane_rho[l], lane_e0[l], dt, y0, lane_y[l], &h,
+                            &temp[l], &is_stiff, arena);
+      }
+      if (nstep < 0) {
+        std::stringstream msg;
+        msg << "### FATAL ERROR in BurnIntegrator::BurnLanes" << std::endl
+            << "burn failed in cell (" << k << "," << j << "," << i << ") of MeshBlock "
+            << pmy_mb_->gid << ", rho = " << lane_rho[l] << ", e = " << lane_e0[l]
+            << std::endl;
+        throw std::runtime_error(msg.str().c_str());
+      }
+    }
+    lanes_(k, j, i) = ok[l] ? 1 : -1;
+    FinishCell(k, j, i, lane_rho[l], lane_e0[l], lane_y[l], h, temp[l], is_stiff,
+               nstep);
+  }
+  return;
+}
+
+//--------------------------------------------------------------------------------------
+//! \fn void BurnIntegrator::LockstepBurn(const int nlane, const Real rho[],
+//                                        const Real e0[], const Real dt, Real *y[],
+//                                        Real temp[], bool ok[], BurnArena *arena)
+//  \brief fixed-step burn of nlane <= BURN_LANES cells over dt (s), one per SIMD lane:
+//  backward Euler, then BDF2, with lock_newton_ simplified Newton iterations per
+//  substep. rho, e0, y and temp are those of IntegrateCell, one per lane. Every lane
+//  runs the same instructions, with no step-size control. A lane passes if in every
+//  substep the last Newton correction is below NEWTON_TOL and the local error
+//  estimate, from the divided differences of f filtered by the Newton matrix, is within
+//  the burn_* tolerances. ok[l] returns whether lane l passed; y[l] and temp[l] are
+//  updated only if so.
+
+void BurnIntegrator::LockstepBurn(const int nlane, const Real rho[], const Real e0[],
+                                  const Real dt, Real *y[], Real temp[], bool ok[],
+                                  BurnArena *arena) {
+  const Real hsub = dt/lock_nsub_;
+  BurnArena::Scope scope(arena);
+  LaneReal (*jac)[N] = reinterpret_cast<LaneReal (*)[N]>(arena->Take<LaneReal>(N*N));
+  LaneReal (*a)[N] = reinterpret_cast<LaneReal (*)[N]>(arena->Take<LaneReal>(N*N));
+  LaneReal yn[N], ynm1[N], fn[N], fnm1[N], yk[N], base[N], g[N];
+  LaneReal rdata[3], dmax, errmax;
+  int indx[N][BURN_LANES];
+  bool fail[BURN_LANES];
+  //unused lanes repeat lane 0, so that they compute something harmless
+  for (int l=0; l<BURN_LANES; ++l) {
+    const int m = (l < nlane) ? l : 0;
+    for (int n=0; n<N; ++n) yn[n].v[l] = y[m][n];
+    rdata[0].v[l] = rho[m];
+    rdata[1].v[l] = e0[m];
+    rdata[2].v[l] = temp[m];
+    fail[l] = false;
+  }
+  Real hprev = 0.0;
+  for (int s=0; s<=lock_nsub_; ++s) {
+    //the first substep of dt/nsub is split in LOCK_START and the rest
+    const Real h = (s == 0) ? LOCK_START*hsub : (s == 1) ? (1.0 - LOCK_START)*hsub : hsub;
+    pmy_net_->RHSLanes(yn, fn, jac, rdata);
+    //y = base + beta h f(y): backward Euler y = yn + h f(y) for the first substep,
+    //then variable-step BDF2 with the step ratio w
+    const Real w = (s == 0) ? 0.0 : h/hprev;
+    const Real beta = (1.0 + w)/(1.0 + 2.0*w);
+    const Real cn = (1.0 + w)*(1.0 + w)/(1.0 + 2.0*w);
+    const Real cnm1 = -w*w/(1.0 + 2.0*w);
+    for (int n=0; n<N; ++n) {
+      base[n] = (s == 0) ? yn[n] : cn*yn[n] + cnm1*ynm1[n];
+    }
+    //Newton matrix 1 - beta h J at yn for every iteration, jac[j][i] = df[i]/dy[j]
+    for (int n=0; n<N; ++n) {
+      for (int m=0; m<N; ++m) a[n][m] = (-beta*h)*jac[m][n];
+      a[n][n] += 1.0;
+    }
+    LaneLUDecompose(a, indx, fail);
+    for (int n=0; n<N; ++n) yk[n] = yn[n];
+    for (int it=0; it<lock_newton_; ++it) {
+      if (it > 0) {
+        pmy_net_->RHSLanes(yk, g, nullptr, rdata);
+      } else {
+        for (int n=0; n<N; ++n) g[n] = fn[n];
+      }
+      //correction: (1 - beta h J) dy = base + beta h f(yk) - yk
+      for (int n=0; n<N; ++n) g[n] = base[n] + (beta*h)*g[n] - yk[n];
+      LaneLUSolve(a, indx, g);
+      dmax = 0.0;
+      for (int n=0; n<N; ++n) {
+        yk[n] += g[n];
+#pragma omp simd
+        for (int l=0; l<BURN_LANES; ++l) {
+          const Real scale = set_.atol + set_.rtol*std::max(std::abs(yn[n].v[l]),
+                                                            std::abs(yk[n].v[l]));
+          dmax.v[l] = std::max(dmax.v[l], std::abs(g[n].v[l])/scale);
+        }
+      }
+    }
+    //local error with f(y) = (y - base)/(beta h): h^2 y''/2 for backward Euler,
+    //h^3 y''' (1 + w)^2/(6 w (1 + 2 w)) for BDF2, with y''' from the divided
+    //differences of f; filtered by the Newton matrix, which damps the stiff
+    //components as the method does (Hairer & Wanner)
+    const Real cerr = (s == 0) ? ERR_BE*h : (1.0 + w)/(3.0*(1.0 + 2.0*w))*h;
+    for (int n=0; n<N; ++n) {
+      LaneReal fk = (yk[n] - base[n])*(1.0/(beta*h));
+      g[n] = (s == 0) ? cerr*(fk - fn[n]) : cerr*(fk - (1.0 + w)*fn[n] + w*fnm1[n]);
+    }
+    LaneLUSolve(a, indx, g);
+    errmax = 0.0;
+    for (int n=0; n<N; ++n) {
+#pragma omp simd
+      for (int l=0; l<BURN_LANES; ++l) {
+        const Real scale = set_.atol + set_.rtol*std::max(std::abs(yn[n].v[l]),
+                                                          std::abs(yk[n].v[l]));
+        errmax.v[l] = std::max(errmax.v[l], std::abs(g[n].v[l])/scale);
+      }
+    }
+    for (int l=0; l<BURN_LANES; ++l) {
+      //NaN fails both
+      if (!(dmax.v[l] <= NEWTON_TOL) || !(errmax.v[l] <= 1.0)) fail[l] = true;
+    }
+    for (int n=0; n<N; ++n) {
+      ynm1[n] = yn[n];
+      fnm1[n] = fn[n];
+      yn[n] = yk[n];
+    }
+    hprev = h;
+  }
+  for (int l=0; l<nlane; ++l) {
+    ok[l] = !fail[l];
+    if (!ok[l]) continue;
+    for (int n=0; n<N; ++n) y[l][n] = yn[n].v[l];
+    temp[l] = rdata[2].v[l];
+  }
+  return;
+}
+
+//--------------------------------------------------------------------------------------
+//! \fn int BurnIntegrator::IntegrateCell(const Real rho, const Real e0, const Real dt,
+//                                         Real y[NBURN], Real *h, Real *temp,
+//                                         bool *stiff, BurnArena *arena)
+//  \brief integration of one cell over dt: explicit while the cell is not stiff, then
+//  Rosenbrock for the rest of the step. With a regime table the settings are those of
+//  the regime of the cell at the start of the step.
+
+int BurnIntegrator::IntegrateCell(const Real rho, const Real e0, const Real dt,
+                                  Real y[NBURN], Real *h, Real *temp, bool *stiff,
+                                  BurnArena *arena) {
+  return Integrate(CellSettings(rho, e0, y, *temp), false, rho, e0, dt, y, h, temp,
+                   stiff, (arena != nullptr) ? arena : &arena_);
+}
+
+//--------------------------------------------------------------------------------------
+//! \fn int BurnIntegrator::Integrate(const Settings &set, const bool exact,
+//                                     const Real rho, const Real e0, const Real dt,
+//                                     Real y[NBURN], Real *h, Real *temp, bool *stiff,
+//                                     BurnArena *arena)
+//  \brief the burn of IntegrateCell with the settings set. With exact, for the
+//  recovery, the cell is integrated by Rosenbrock from the start with the exact energy
+//  derivatives in the Jacobian.
+
+int BurnIntegrator::Integrate(const Settings &set, const bool exact, const Real rho,
+                              const Real e0, const Real dt, Real y[NBURN], Real *h,
+                              Real *temp, bool *stiff, BurnArena *arena) {
+  Real rdata[3] = {rho, e0, *temp};
+  if (!(*h > 0.0)) *h = set.hinit*dt;
+  Real t = 0.0;
+  int nstep = 0;
+  if (set.expl && !*stiff && !exact) {
+    nstep = ExplicitSteps(set, rdata, dt, y, h, &t, stiff);
+    if (nstep < 0) return -1;
+  }
+  if (t < dt*(1.0 - 1.0e-12)) {
+    int n = RosenbrockSteps(set, rdata, dt, y, h, &t, nstep, stiff, exact, arena);
+    if (n < 0) return -1;
+    nstep = n;
+  }
+  *temp = rdata[2];
+  return nstep;
+}
+
+//--------------------------------------------------------------------------------------
+//! \fn const BurnIntegrator::Settings &BurnIntegrator::CellSettings(const Real rho,
+//                                           const Real e0, const Real y[NBURN],
+//                                           const Real tguess) const
+//  \brief settings of a cell at the start of its burn: those of its regime, its
+//  temperature and dominant species, in the regime table, else burn_*
+
+const BurnIntegrator::Settings &BurnIntegrator::CellSettings(const Real rho,
+                                                             const Real e0,
+                                                             const Real y[NBURN],
+                                                             const Real tguess) const {
+  if (ptune_ != nullptr) {
+    const Real t9 = 1.0e-9*CellTemperature(rho, e0, y, tguess);
+    const Settings *preg = ptune_->Find(BurnTuning::DominantSpecies(y), t9);
+    if (preg != nullptr) return *preg;
+  }
+  return set_;
+}
+
+//--------------------------------------------------------------------------------------
+//! \fn int BurnIntegrator::RecoverCell(const std::string &where, const Real rho,
+//                                       const Real e0, const Real dt,
+//                                       const Real y0[NBURN], Real y[NBURN], Real *h,
+//                                       Real *temp, bool *stiff, BurnArena *arena)
+//  \brief burn a failed cell again from y0 with each rung of the recovery ladder in
+//  turn, until one succeeds, with the settings IntegrateCell used. A burn fails by a
+//  step below 1e-20 of dt, by running out of steps, or at a state without temperature.
+//  The rungs, ever more robust and expensive: (1) a first trial step of recover_hinit_
+//  of dt, (2) Rosenbrock from the start, with the exact energy derivatives in the
+//  Jacobian, (3) the same in recover_nsub_ equal substeps, (4) BackwardEulerSteps.
+//  Rungs 2 to 4 may take recover_steps_ times the steps, per substep in 3. Counts the
+//  outcome by rung and logs the first recover_log_ of the rank, with the state of the
+//  cell and the rung that succeeded.
+
+int BurnIntegrator::RecoverCell(const std::string &where, const Real rho, const Real e0,
+                                const Real dt, const Real y0[NBURN], Real y[NBURN],
+                                Real *h, Real *temp, bool *stiff, BurnArena *arena) {
+  if (!recover_) return -1;
+  if (arena == nullptr) arena = &arena_;
+  const Settings &set = CellSettings(rho, e0, y0, *temp);
+  //the implicit rungs with a larger step budget
+  Settings iset = set;
+  iset.maxsteps = set.maxsteps*recover_steps_;
+  int rung, nstep = -1;
+  Real hr = 0.0, tr = 0.0;
+  bool sr = false;
+  for (rung=0; rung<NRUNG; ++rung) {
+    for (int n=0; n<N; ++n) y[n] = y0[n];
+    hr = recover_hinit_*dt;
+    tr = *temp;
+    if (rung == 0) {
+      //a small first step, with the methods of the burn
+      sr = false;
+      nstep = Integrate(set, false, rho, e0, dt, y, &hr, &tr, &sr, arena);
+    } else if (rung == 1) {
+      //Rosenbrock on the full system with the exact Jacobian
+      sr = true;
+      nstep = Integrate(iset, true, rho, e0, dt, y, &hr, &tr, &sr, arena);
+    } else if (rung == 2) {
+      //the same in equal substeps, each with the step budget of the last rung
+      const Real dts = dt/recover_nsub_;
+      hr = recover_hinit_*dts;
+      sr = true;
+      nstep = 0;
+      for (int s=0; s<recover_nsub_ && nstep >= 0; ++s) {
+        const int n = Integrate(iset, true, rho, e0, dts, y, &hr, &tr, &sr, arena);
+        nstep = (n < 0) ? -1 : nstep + n;
+      }
+    } else {
+      //backward Euler
+      Real rdata[3] = {rho, e0, tr};
+      sr = true;
+      nstep = BackwardEulerSteps(iset, rdata, dt, y, &hr, arena);
+      tr = rdata[2];
+    }
+    if (nstep >= 0) break;
+  }
+  nrecover[rung]++;
+  //one atomic increment, so that concurrent cells see distinct log numbers
+  const long nlog = nrecover_log.fetch_add(1);
+  if (nlog < recover_log_) {
+    std::stringstream msg;
+    msg << "### WARNING in BurnIntegrator::RecoverCell" << std::endl
+        << "burn failed in " << where << ", rho = " << rho << ", e = " << e0
+        << ", T = " << CellTemperature(rho, e0, y0, *temp) << ", dt = " << dt
+        << std::endl << "y =";
+    for (int n=0; n<NSCALARS; ++n) {
+      msg << " " << ChemNetwork::species_names[n] << " " << y0[n];
+    }
+    msg << std::endl;
+    if (rung < NRUNG) {
+      msg << "recovered by " << RECOVER_RUNG[rung] << " in " << nstep << " steps"
+          << std::endl;
+    } else {
+      msg << "not recovered by any rung" << std::endl;
+    }
+    if (nlog + 1 == recover_log_) {
+      msg << "further recoveries are only counted" << std::endl;
+    }
+    std::cout << msg.str() << std::flush;
+  }
+  if (nstep < 0) {
+    for (int n=0; n<N; ++n) y[n] = y0[n];
+    return -1;
+  }
+  *h = hr;
+  *temp = tr;
+  *stiff = sr;
+  return nstep;
+}
+
+//--------------------------------------------------------------------------------------
+//! \fn Real BurnIntegrator::CellTemperature(const Real rho, const Real e0,
+//                                           const Real y[NBURN],
+//                                           const Real tguess) const
+//  \brief temperature (K) of a cell at the start of its burn, the arguments of
+//  IntegrateCell; with e0 = 0 the prescribed temperature tguess
+
+Real BurnIntegrator::CellTemperature(const Real rho, const Real e0, const Real y[NBURN],
+                                     const Real tguess) const {
+  if (!(e0 > 0.0)) return tguess;
+  return pmy_net_->Temperature(rho, rho*y[NSCALARS]*e0/pmy_net_->unit_E_in_cgs_, y,
+                               tguess);
+}
+
+//--------------------------------------------------------------------------------------
+//! \fn Real BurnIntegrator::SpecificEnergy(const Real rho, const Real temp,
+//                                          const Real y[NSCALARS]) const
+//  \brief specific internal energy (erg/g) of the network EOS
+
+Real BurnIntegrator::SpecificEnergy(const Real rho, const Real temp,
+                                    const Real y[NSCALARS]) const {
+  return pmy_net_->InternalEnergyDensity(rho, temp, y)*pmy_net_->unit_E_in_cgs_/rho;
+}
+
+//--------------------------------------------------------------------------------------
+//! \fn int BurnIntegrator::BurnZone(const Real rho, const Real dt, const int nburn,
+//                                    Real *ED, Real y[NSCALARS])
+//  \brief nburn burns of one cell at fixed density, each from the energy left by the
+//  last and with the step size and stiffness it ended with, as in BurnTile
+
+int BurnIntegrator::BurnZone(const Real rho, const Real dt, const int nburn, Real *ED,
+                             Real y[NSCALARS]) {
+  const Real dt_s = dt*pmy_net_->unit_time_in_s_/nburn;
+  Real yb[NBURN];
+  for (int n=0; n<NSCALARS; ++n) yb[n] = y[n];
+  Real h = 0.0, temp = 0.0;
+  bool is_stiff = false;
+  int nmax = 0;
+  for (int b=0; b<nburn; ++b) {
+    const Real e0 = (*ED)*pmy_net_->unit_E_in_cgs_/rho;
+    if (!(e0 > 0.0)) return -1;
+    yb[NSCALARS] = 1.0;
+    Real y0[NBURN];
+    for (int n=0; n<NBURN; ++n) y0[n] = yb[n];
+    int nstep = IntegrateCell(rho, e0, dt_s, yb, &h, &temp, &is_stiff);
+    if (nstep < 0) {
+      std::stringstream cell;
+      cell << "burn " << b << " of a zone";
+      nstep = RecoverCell(cell.str(), rho, e0, dt_s, y0, yb, &h, &temp, &is_stiff);
+    }
+    if (nstep < 0) return -1;
+    nmax = std::max(nmax, nstep);
+    *ED += rho*(yb[NSCALARS] - 1.0)*e0/pmy_net_->unit_E_in_cgs_;
+    //what the scatter and the temperature cache keep of the cell
+    for (int n=0; n<NSCALARS; ++n) yb[n] = (yb[n] > 0.0) ? yb[n] : 0.0;
+    if (!pmy_net_->eos_.IsTable()) temp = 0.0;
+  }
+  for (int n=0; n<NSCALARS; ++n) y[n] = yb[n];
+  return nmax;
+}
+
+//--------------------------------------------------------------------------------------
+//! \fn int BurnIntegrator::ExplicitSteps(const Settings &set, Real rdata[3],
+//                                         const Real dt, Real y[NBURN], Real *h, Real *t,
+//                                         bool *stiff)
+//  \brief adaptive Dormand-Prince RK5(4) steps from t towards dt. Stops early, with
+//  stiff = true, once the step size is limited by stability rather than accuracy.
+//  Returns the number of steps, or -1 on failure.
+
+int BurnIntegrator::ExplicitSteps(const Settings &set, Real rdata[3], const Real dt,
+                                  Real y[NBURN], Real *h, Real *t, bool *stiff) {
+  Real k1[NBURN], k2[NBURN], k3[NBURN], k4[NBURN], k5[NBURN], k6[NBURN], k7[NBURN];
+  Real ytmp[NBURN], ysti[NBURN];
+  //too cold to burn: nothing changes over the rest of the step
+  int burning = pmy_net_->RHSFull(y, k1, nullptr, rdata);
+  //no temperature for this state (the EOS inversion failed): smaller steps cannot
+  //help, leave the cell to the recovery
+  if (rdata[2] != rdata[2]) return -1;
+  if (burning == 0) {
+    *t = dt;
+    return 0;
+  }
+  Real htry = *h;
+  Real hh = std::min(htry, dt - *t);
+  int nstep = 0;
+  int nstiff = 0, nonstiff = 0;
+  bool rejected = false;
+  while (nstep < set.maxsteps) {
+    nstep++;
+    for (int n=0; n<N; ++n) ytmp[n] = y[n] + hh*DP21*k1[n];
+    pmy_net_->RHSFull(ytmp, k2, nullptr, rdata);
+    for (int n=0; n<N; ++n) ytmp[n] = y[n] + hh*(DP31*k1[n] + DP32*k2[n]);
+    pmy_net_->RHSFull(ytmp, k3, nullptr, rdata);
+    for (int n=0; n<N; ++n) ytmp[n] = y[n] + hh*(DP41*k1[n] + DP42*k2[n] + DP43*k3[n]);
+    pmy_net_->RHSFull(ytmp, k4, nullptr, rdata);
+    for (int n=0; n<N; ++n) {
+      ytmp[n] = y[n] + hh*(DP51*k1[n] + DP52*k2[n] + DP53*k3[n] + DP54*k4[n]);
+    }
+    pmy_net_->RHSFull(ytmp, k5, nullptr, rdata);
+    for (int n=0; n<N; ++n) {
+      ysti[n] = y[n] + hh*(DP61*k1[n] + DP62*k2[n] + DP63*k3[n] + DP64*k4[n]
+                           + DP65*k5[n]);
+    }
+    pmy_net_->RHSFull(ysti, k6, nullptr, rdata);
+    for (int n=0; n<N; ++n) {
+      ytmp[n] = y[n] + hh*(DP71*k1[n] + DP73*k3[n] + DP74*k4[n] + DP75*k5[n]
+                           + DP76*k6[n]);
+    }
+    burning = pmy_net_->RHSFull(ytmp, k7, nullptr, rdata);
+    Real errmax = 0.0;
+    for (int n=0; n<N; ++n) {
+      Real err = hh*(DPE1*k1[n] + DPE3*k3[n] + DPE4*k4[n] + DPE5*k5[n] + DPE6*k6[n]
+                     + DPE7*k7[n]);
+      Real scale = set.atol + set.rtol*std::max(std::abs(y[n]), std::abs(ytmp[n]));
+      Real ratio = std::abs(err)/scale;
+      if (ratio != ratio) ratio = 1.0e10;  // NaN
+      errmax = std::max(errmax, ratio);
+    }
+    if (errmax > 1.0) {
+      //reject: shrink the step and retry
+      hh *= std::max(FACMIN, FACSAFE*std::pow(errmax, -0.2));
+      htry = hh;
+      rejected = true;
+      if (hh < 1.0e-20*dt) return -1;
+      continue;
+    }
+    *t += hh;
+    //stiffness test (Hairer & Wanner): h times the local Lipschitz estimate
+    //|f(y_new) - f(y_6)|/|y_new - y_6| beyond the stability boundary of the method
+    Real stnum = 0.0, stden = 0.0;
+    for (int n=0; n<N; ++n) {
+      stnum += SQR(k7[n] - k6[n]);
+      stden += SQR(ytmp[n] - ysti[n]);
+      y[n] = ytmp[n];
+      k1[n] = k7[n];  // first same as last
+    }
+    if (stden > 0.0 && hh*std::sqrt(stnum/stden) > HLAMB_STIFF) {
+      nonstiff = 0;
+      nstiff++;
+    } else if (++nonstiff >= NSTIFF) {
+      nstiff = 0;
+    }
+    Real fac = FACSAFE*std::pow(std::max(errmax, static_cast<Real>(1.0e-10)), -0.2);
+    fac = std::max(FACMIN, std::min(rejected ? 1.0 : FACMAX, fac));
+    rejected = false;
+    Real hnext = hh*fac;
+    //a step clipped to reach dt says nothing about the step size
+    if (hh < htry) hnext = std::max(hnext, htry);
+    htry = hnext;
+    *h = htry;
+    if (*t >= dt*(1.0 - 1.0e-12) || !burning) {
+      *t = dt;
+      return nstep;
+    }
+    if (nstiff >= NSTIFF) {
+      *stiff = true;
+      return nstep;
+    }
+    hh = std::min(htry, dt - *t);
+  }
+  return -1;
+}
+
+//--------------------------------------------------------------------------------------
+//! \fn int BurnIntegrator::RosenbrockSteps(const Settings &set, Real rdata[3],
+//                                           const Real dt, Real y[NBURN], Real *h,
+//                                           Real *t, const int nstep0, bool *stiff,
+//                                           const bool exact, BurnArena *arena)
+//  \brief adaptive Rosenbrock (Rodas3) steps from t to dt. At the end, stiff is set
+//  from a power-iteration bound of the spectral radius of the Jacobian, so that the
+//  next burn of the cell starts explicitly again once it is no longer stiff. With
+//  burn_lu = mixed the stage solves use float factors of the matrix, refined in Real,
+//  and the Real factors for the rest of the burn once a refinement does not converge.
+//  exact takes the energy derivatives of the Jacobian from dual numbers. Returns nstep0
+//  plus the number of steps, or -1 on failure.
+
+int BurnIntegrator::RosenbrockSteps(const Settings &set, Real rdata[3], const Real dt,
+                                    Real y[NBURN], Real *h, Real *t, const int nstep0,
+                                    bool *stiff, const bool exact, BurnArena *arena) {
+  BurnArena::Scope scope(arena);
+  Real (*jac)[N] = reinterpret_cast<Real (*)[N]>(arena->Take<Real>(N*N));
+  Real (*a)[N] = reinterpret_cast<Real (*)[N]>(arena->Take<Real>(N*N));
+  float (*af)[N] = nullptr;
+  if (mixed_lu_) af = reinterpret_cast<float (*)[N]>(arena->Take<float>(N*N));
+  Real f[NBURN], fs[NBURN];
+  Real k1[NBURN], k2[NBURN], k3[NBURN], k4[NBURN], ysav[NBURN], wt[NBURN];
+  int indx[NBURN];
+  //once float factors fail, the matrices of the cell stay too ill-conditioned for
+  //them for a while: Real factors for the rest of the burn
+  bool lu_double = !mixed_lu_;
+  Real htry = *h;
+  Real hh = std::min(htry, dt - *t);
+  int nstep = nstep0;
+  while (nstep < set.maxsteps) {
+    //too cold to burn: nothing changes over the rest of the step
+    int burning = pmy_net_->RHSFull(y, f, jac, rdata, exact);
+    //no temperature for this state, as in ExplicitSteps
+    if (rdata[2] != rdata[2]) return -1;
+    if (burning == 0) {
+      *t = dt;
+      return nstep;
+    }
+    for (int n=0; n<N; ++n) ysav[n] = y[n];
+    //the stages are increments of y: refine them to a fraction of the tolerances
+    if (!lu_double) {
+      for (int n=0; n<N; ++n) wt[n] = 1.0/(set.atol + set.rtol*std::abs(ysav[n]));
+    }
+    bool rejected = false;
+    Real errmax;
+    while (true) {
+      //A = 1/(GAM h) - J, with jac[j][i] = df[i]/dy[j]
+      for (int n=0; n<N; ++n) {
+        for (int m=0; m<N; ++m) a[n][m] = -jac[m][n];
+        a[n][n] += 1.0/(GAM*hh);
+      }
+      nstep++;
+      const Real hinv = 1.0/hh;
+      bool solved = (Factor(a, af, indx, &lu_double) == 0);
+      if (solved) {
+        for (int n=0; n<N; ++n) k1[n] = f[n];
+        solved = Solve(a, af, indx, wt, &lu_double, k1);
+      }
+      if (solved) {
+        for (int n=0; n<N; ++n) k2[n] = f[n] + C21*hinv*k1[n];
+        solved = Solve(a, af, indx, wt, &lu_double, k2);
+      }
+      if (solved) {
+        for (int n=0; n<N; ++n) y[n] = ysav[n] + A31*k1[n];
+        pmy_net_->RHSFull(y, fs, nullptr, rdata);
+        for (int n=0; n<N; ++n) k3[n] = fs[n] + hinv*(C31*k1[n] + C32*k2[n]);
+        solved = Solve(a, af, indx, wt, &lu_double, k3);
+      }
+      if (solved) {
+        for (int n=0; n<N; ++n) y[n] = ysav[n] + A41*k1[n] + A43*k3[n];
+        pmy_net_->RHSFull(y, fs, nullptr, rdata);
+        for (int n=0; n<N; ++n) {
+          k4[n] = fs[n] + hinv*(C41*k1[n] + C42*k2[n] + C43*k3[n]);
+        }
+        solved = Solve(a, af, indx, wt, &lu_double, k4);
+      }
+      if (!solved) {
+        errmax = 1.0e10;  // singular, treat as a rejected step
+      } else {
+        errmax = 0.0;
+        for (int n=0; n<N; ++n) {
+          y[n] += k4[n];
+          Real scale = set.atol + set.rtol*std::max(std::abs(ysav[n]), std::abs(y[n]));
+          Real ratio = std::abs(k4[n])/scale;
+          if (ratio != ratio) ratio = 1.0e10;  // NaN
+          errmax = std::max(errmax, ratio);
+        }
+      }
+      if (errmax <= 1.0) break;
+      //reject: shrink the step and retry from ysav
+      hh *= std::max(FACMIN, FACSAFE*std::pow(errmax, -1.0/3.0));
+      htry = hh;
+      rejected = true;
+      if (nstep >= set.maxsteps || hh < 1.0e-20*dt) {
+        for (int n=0; n<N; ++n) y[n] = ysav[n];
+        return -1;
+      }
+    }
+    *t += hh;
+    //next trial step; do not grow right after a rejection
+    Real fac = FACSAFE*std::pow(std::max(errmax, static_cast<Real>(1.0e-10)), -1.0/3.0);
+    fac = std::max(FACMIN, std::min(rejected ? 1.0 : FACMAX, fac));
+    Real hnext = hh*fac;
+    //a step clipped to reach dt says nothing about the step size
+    if (hh < htry) hnext = std::max(hnext, htry);
+    htry = hnext;
+    if (*t >= dt*(1.0 - 1.0e-12)) {
+      *h = htry;
+      *stiff = htry*SpectralRadius(jac) > HLAMB_STIFF;
+      return nstep;
+    }
+    hh = std::min(htry, dt - *t);
+  }
+  return -1;
+}
+
+//--------------------------------------------------------------------------------------
+//! \fn int BurnIntegrator::BackwardEulerSteps(const Settings &set, Real rdata[3],
+//                                              const Real dt, Real y[NBURN], Real *h,
+//                                              BurnArena *arena)
+//  \brief adaptive backward Euler steps from 0 to dt on the full system, the last rung
+//  of the recovery. Each step is solved by simplified Newton iterations on the exact
+//  Jacobian at its start, and its local error estimated from h/2 (f(y_new) - f(y)).
+//  Only first order, but L-stable and free of the error estimates of the embedded
+//  pairs; with the exact Jacobian mass and energy are kept to the Newton tolerance.
+//  Returns the number of steps, or -1 on failure.
+
+int BurnIntegrator::BackwardEulerSteps(const Settings &set, Real rdata[3], const Real dt,
+                                       Real y[NBURN], Real *h, BurnArena *arena) {
+  BurnArena::Scope scope(arena);
+  Real (*jac)[N] = reinterpret_cast<Real (*)[N]>(arena->Take<Real>(N*N));
+  Real (*a)[N] = reinterpret_cast<Real (*)[N]>(arena->Take<Real>(N*N));
+  Real f[NBURN], fn[NBURN], dy[NBURN], ysav[NBURN];
+  int indx[NBURN];
+  Real t = 0.0;
+  Real hh = std::min(*h, dt);
+  int nstep = 0;
+  while (nstep < set.maxsteps) {
+    const int burning = pmy_net_->RHSFull(y, f, jac, rdata, true);
+    //no temperature for this state, as in ExplicitSteps
+    if (rdata[2] != rdata[2]) return -1;
+    //too cold to burn: nothing changes over the rest of the step
+    if (burning == 0) return nstep;
+    for (int n=0; n<N; ++n) ysav[n] = y[n];
+    bool rejected = false;
+    Real errmax;
+    while (true) {
+      //A = 1/h - J, with jac[j][i] = df[i]/dy[j]
+      for (int n=0; n<N; ++n) {
+        for (int m=0; m<N; ++m) a[n][m] = -jac[m][n];
+        a[n][n] += 1.0/hh;
+      }
+      nstep++;
+      bool converged = false;
+      if (LUDecompose(a, indx) == 0) {
+        for (int n=0; n<N; ++n) fn[n] = f[n];
+        for (int iter=0; iter<BE_NEWTON && !converged; ++iter) {
+          if (iter > 0) pmy_net_->RHSFull(y, fn, nullptr, rdata);
+          for (int n=0; n<N; ++n) dy[n] = fn[n] - (y[n] - ysav[n])/hh;
+          LUSolve(a, indx, dy);
+          Real dmax = 0.0;
+          for (int n=0; n<N; ++n) {
+            y[n] += dy[n];
+            Real ratio = std::abs(dy[n])/(set.atol + set.rtol*std::abs(y[n]));
+            if (ratio != ratio) ratio = 1.0e10;  // NaN
+            dmax = std::max(dmax, ratio);
+          }
+          converged = (dmax <= BE_NEWTON_TOL);
+        }
+      }
+      errmax = 1.0e10;  // singular or not converged, treat as a rejected step
+      if (converged) {
+        //h^2 y''/2, filtered by the Newton matrix as in the lockstep burn
+        pmy_net_->RHSFull(y, fn, nullptr, rdata);
+        for (int n=0; n<N; ++n) dy[n] = ERR_BE*(fn[n] - f[n]);
+        LUSolve(a, indx, dy);
+        errmax = 0.0;
+        for (int n=0; n<N; ++n) {
+          Real scale = set.atol + set.rtol*std::max(std::abs(ysav[n]), std::abs(y[n]));
+          Real ratio = std::abs(dy[n])/scale;
+          if (ratio != ratio) ratio = 1.0e10;  // NaN
+          errmax = std::max(errmax, ratio);
+        }
+      }
+      if (errmax <= 1.0) break;
+      //reject: shrink the step and retry from ysav
+      for (int n=0; n<N; ++n) y[n] = ysav[n];
+      hh *= std::max(FACMIN, FACSAFE*std::pow(errmax, -0.5));
+      rejected = true;
+      if (nstep >= set.maxsteps || hh < 1.0e-20*dt) return -1;
+    }
+    t += hh;
+    Real fac = FACSAFE*std::pow(std::max(errmax, static_cast<Real>(1.0e-10)), -0.5);
+    fac = std::max(FACMIN, std::min(rejected ? 1.0 : FACMAX, fac));
+    *h = hh*fac;
+    if (t >= dt*(1.0 - 1.0e-12)) return nstep;
+    hh = std::min(*h, dt - t);
+  }
+  return -1;
+}
+
+//--------------------------------------------------------------------------------------
+//! \fn Real BurnIntegrator::SpectralRadius(const Real jac[NBURN][NBURN])
+//  \brief power-iteration estimate of the largest |eigenvalue| of jac[j][i] = df[i]/dy[j]
+
+Real BurnIntegrator::SpectralRadius(const Real jac[NBURN][NBURN]) {
+  Real v[NBURN], w[NBURN];
+  for (int n=0; n<N; ++n) v[n] = 1.0;
+  Real norm = std::sqrt(static_cast<Real>(N));
+  Real rho = 0.0;
+  for (int iter=0; iter<NPOWER; ++iter) {
+    Real wnorm = 0.0;
+    for (int i=0; i<N; ++i) {
+      w[i] = 0.0;
+      for (int j=0; j<N; ++j) w[i] += jac[j][i]*v[j];
+      wnorm += w[i]*w[i];
+    }
+    wnorm = std::sqrt(wnorm);
+    rho = wnorm/norm;
+    if (!(wnorm > 0.0)) break;
+    for (int n=0; n<N; ++n) v[n] = w[n]/wnorm;
+    norm = 1.0;
+  }
+  return rho;
+}
+
+namespace {
+//! \fn int LUDecompose(T a[N][N], int indx[N])
+//  \brief in-place LU decomposition with partial pivoting; returns 1 if singular
+template <typename T>
+int LUDecompose(T a[N][N], int indx[N]) {
+  PERF_SCOPE(PERF_LINSOLVE, 2.0*N*N*N/3.0, 0);
+  for (int k=0; k<N; ++k) {
+    int ip = k;
+    T big = std::abs(a[k][k]);
+    for (int i=k+1; i<N; ++i) {
+      if (std::abs(a[i][k]) > big) {
+        big = std::abs(a[i][k]);
+        ip = i;
+      }
+    }
+    if (big == 0.0) return 1;
+    indx[k] = ip;
+    if (ip != k) {
+      for (int j=0; j<N; ++j) std::swap(a[k][j], a[ip][j]);
+    }
+    const T inv = static_cast<T>(1.0)/a[k][k];
+    for (int i=k+1; i<N; ++i) {
+      const T l = a[i][k]*inv;
+      a[i][k] = l;
+      if (l != 0.0) {
+        for (int j=k+1; j<N; ++j) a[i][j] -= l*a[k][j];
+      }
+    }
+  }
+  return 0;
+}
+
+//! \fn void LUSolve(const T a[N][N], const int indx[N], T b[N])
+//  \brief solve with the factors from LUDecompose, b is overwritten by the solution
+template <typename T>
+void LUSolve(const T a[N][N], const int indx[N], T b[N]) {
+  PERF_SCOPE(PERF_LINSOLVE, 2.0*N*N, 0);
+  //the factors were built with full-row swaps: permute b row by row while solving L
+  for (int i=0; i<N; ++i) {
+    std::swap(b[i], b[indx[i]]);
+    T sum = b[i];
+    for (int j=0; j<i; ++j) sum -= a[i][j]*b[j];
+    b[i] = sum;
+  }
+  for (int i=N-1; i>=0; --i) {
+    T sum = b[i];
+    for (int j=i+1; j<N; ++j) sum -= a[i][j]*b[j];
+    b[i] = sum/a[i][i];
+  }
+}
+
+//! \fn int Factor(Real a[N][N], float af[N][N], int indx[N], bool *lu_double)
+//  \brief factors of a for Solve: float ones in af, leaving a intact for the
+//  refinement, unless lu_double is set or a does not fit in a float; otherwise, and
+//  then with lu_double set, Real ones in place. Returns 1 if singular.
+int Factor(Real a[N][N], float af[N][N], int indx[N], bool *lu_double) {
+  if (!*lu_double) {
+    bool fits = true;
+    for (int n=0; n<N; ++n) {
+      for (int m=0; m<N; ++m) {
+        fits = fits && (std::abs(a[n][m]) <= FLT_MAX);
+        af[n][m] = static_cast<float>(a[n][m]);
+      }
+    }
+    if (fits && LUDecompose(af, indx) == 0) return 0;
+    *lu_double = true;
+  }
+  return LUDecompose(a, indx);
+}
+
+//! \fn bool Solve(Real a[N][N], const float af[N][N], int indx[N], const Real wt[N],
+//                  bool *lu_double, Real b[N])
+//  \brief solve a x = b with the factors from Factor, b is overwritten by x. A
+//  refinement that does not converge falls back to Real factors, which lu_double then
+//  marks for the later solves. Returns false if those are singular.
+bool Solve(Real a[N][N], const float af[N][N], int indx[N], const Real wt[N],
+           bool *lu_double, Real b[N]) {
+  if (!*lu_double) {
+    if (RefinedSolve(a, af, indx, wt, b)) return true;
+    *lu_double = true;
+    if (LUDecompose(a, indx) != 0) return false;
+  }
+  LUSolve(a, indx, b);
+  return true;
+}
+
+//! \fn bool RefinedSolve(const Real a[N][N], const float af[N][N], const int indx[N],
+//                         const Real wt[N], Real b[N])
+//  \brief float solve with the factors af, then up to REFINE_MAX steps of iterative
+//  refinement with the residual of a in Real. Returns true, with the solution in b,
+//  once the largest correction times wt is below REFINE_TOL, and false with b
+//  unchanged if it never is (a too ill-conditioned for float factors, or overflow).
+bool RefinedSolve(const Real a[N][N], const float af[N][N], const int indx[N],
+                  const Real wt[N], Real b[N]) {
+  Real x[N];
+  float d[N];
+  for (int n=0; n<N; ++n) d[n] = static_cast<float>(b[n]);
+  LUSolve(af, indx, d);
+  for (int n=0; n<N; ++n) x[n] = d[n];
+  for (int iter=0; iter<REFINE_MAX; ++iter) {
+    for (int i=0; i<N; ++i) {
+      Real r = b[i];
+      for (int j=0; j<N; ++j) r -= a[i][j]*x[j];
+      d[i] = static_cast<float>(r);
+    }
+    LUSolve(af, indx, d);
+    Real dmax = 0.0;
+    for (int n=0; n<N; ++n) {
+      x[n] += d[n];
+      dmax = std::max(dmax, std::abs(d[n])*wt[n]);
+    }
+    if (dmax <= REFINE_TOL) {
+      for (int n=0; n<N; ++n) b[n] = x[n];
+      return true;
+    }
+  }
+  return false;
+}
+
+//! \fn void LaneLUDecompose(LaneReal a[][N], int indx[][BURN_LANES], bool singular[])
+//  \brief LUDecompose of BURN_LANES matrices at once, lane l of every element being
+//  matrix l; each lane has its own pivots. singular[l] is set for a singular lane,
+//  whose factors are then garbage.
+void LaneLUDecompose(LaneReal a[][N], int indx[][BURN_LANES], bool singular[]) {
+  PERF_SCOPE(PERF_LINSOLVE, 2.0*N*N*N/3.0*BURN_LANES, 0);
+  for (int k=0; k<N; ++k) {
+    for (int l=0; l<BURN_LANES; ++l) {
+      int ip = k;
+      Real big = std::abs(a[k][k].v[l]);
+      for (int i=k+1; i<N; ++i) {
+        if (std::abs(a[i][k].v[l]) > big) {
+          big = std::abs(a[i][k].v[l]);
+          ip = i;
+        }
+      }
+      if (big == 0.0) singular[l] = true;
+      indx[k][l] = ip;
+      if (ip != k) {
+        for (int j=0; j<N; ++j) std::swap(a[k][j].v[l], a[ip][j].v[l]);
+      }
+    }
+    const LaneReal inv = 1.0/a[k][k];
+    for (int i=k+1; i<N; ++i) {
+      const LaneReal lik = a[i][k]*inv;
+      a[i][k] = lik;
+      for (int j=k+1; j<N; ++j) a[i][j] -= lik*a[k][j];
+    }
+  }
+}
+
+//! \fn void LaneLUSolve(const LaneReal a[][N], const int indx[][BURN_LANES],
+//                       LaneReal b[])
+//  \brief LUSolve with the factors from LaneLUDecompose, every lane at once
+void LaneLUSolve(const LaneReal a[][N], const int indx[][BURN_LANES], LaneReal b[]) {
+  PERF_SCOPE(PERF_LINSOLVE, 2.0*N*N*BURN_LANES, 0);
+  for (int i=0; i<N; ++i) {
+    for (int l=0; l<BURN_LANES; ++l) std::swap(b[i].v[l], b[indx[i][l]].v[l]);
+    LaneReal sum = b[i];
+    for (int j=0; j<i; ++j) sum -= a[i][j]*b[j];
+    b[i] = sum;
+  }
+  for (int i=N-1; i>=0; --i) {
+    LaneReal sum = b[i];
+    for (int j=i+1; j<N; ++j) sum -= a[i][j]*b[j];
+    b[i] = sum/a[i][i];
+  }
+}
+} // namespace
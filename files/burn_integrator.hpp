@@ -0,0 +1,161 @@
+#ifndef CHEMISTRY_UTILS_BURN_INTEGRATOR_HPP_
+#define CHEMISTRY_UTILS_BURN_INTEGRATOR_HPP_
+//======================================================================================
+// Athena++ astrophysical MHD code
+// Copyright (C) 2014 James M. Stone  <jmstone@princeton.edu>
+// See LICENSE file for full public license information.
+//======================================================================================
+//! \file burn_integrator.hpp
+//  \brief self-heating nuclear burn: the abundances and the specific internal energy
+//  are integrated together by a stiff solver, with the temperature updated from the
+//  energy at every right-hand-side evaluation
+//
+//  The system is the one of ChemNetwork::RHSFull, y[0:NSCALARS-1] abundances and
+//  y[NSCALARS] = e/e0 with e0 the specific internal energy at the start of the step.
+//  Cells start with the explicit Dormand-Prince RK5(4) method and switch to the
+//  L-stable Rosenbrock method Rodas3 once they are stiff, so that a single hydro step
+//  can cover a thermonuclear runaway. Both conserve mass and the sum of binding and
+//  internal energy to round-off. The energy released is added to the hydro energy.
+//  The solver is configured by the <chemistry> burn_* options, read in the constructor.
+//======================================================================================
+
+// C++ headers
+#include <atomic>   // atomic
+#include <cstddef>  // size_t
+#include <string>   // string
+
+// Athena++ headers
+#include "../../athena.hpp"
+#include "../../athena_arrays.hpp"
+#include "burn_arena.hpp"
+
+class BurnCache;
+class BurnSurrogate;
+class BurnTuning;
+class ChemNetwork;
+class MeshBlock;
+class ParameterInput;
+
+//! \class BurnIntegrator
+//  \brief coupled burn of the cells of one MeshBlock, configured by <chemistry> burn_*
+class BurnIntegrator {
+ public:
+  static const int NBURN = NSCALARS + 1;  // abundances and scaled energy
+  static const int NRUNG = 4;             // rungs of the recovery ladder
+
+  //solver settings of a burn
+  struct Settings {
+    Real rtol, atol;  // relative and absolute error tolerances
+    int maxsteps;     // maximum number of steps in one cell per burn
+    bool expl;        // start non-stiff cells with the explicit method
+    Real hinit;       // first trial step of a cell without a last step, in units of dt
+  };
+
+  //pmb = nullptr: only IntegrateCell is available, for burns outside the mesh
+  BurnIntegrator(ChemNetwork *pnet, MeshBlock *pmb, ParameterInput *pin);
+  ~BurnIntegrator();
+
+  //burn every active cell of the MeshBlock over dt (code units), updating the
+  //scalars and the hydro energy
+  void BurnMeshBlock(const Real dt);
+  //burn cells il..iu of row (k,j), iu-il < TileSize(), with scratch from arena.
+  //Different cells may be burned concurrently, each call with its own arena.
+  void BurnTile(const Real dt, const int k, const int j, const int il, const int iu,
+                BurnArena *arena);
+  //burn one cell over dt (s) at density rho (g/cm3). y[0:12] are abundances and y[13] = 1
+  //is the scaled energy, updated in place; h is the first trial step (0: a fraction hinit
+  //of dt) and returns the last accepted one, temp the temperature guess (0 if none) and
+  //returns the final temperature. stiff selects the implicit method from the start, and
+  //returns whether the cell is stiff at the end. Returns the number of steps, or -1 on
+  //failure. With e0 = 0 the temperature is held at temp and only the abundances change, a
+  //burn along a prescribed thermodynamic history. The scratch comes from arena, or with
+  //nullptr from the integrator's own, for callers on one thread.
+  int IntegrateCell(const Real rho, const Real e0, const Real dt, Real y[NBURN],
+                    Real *h, Real *temp, bool *stiff, BurnArena *arena=nullptr);
+  //burn a cell down the recovery ladder after IntegrateCell failed, from its initial
+  //abundances y0 and with the other arguments of that call; where names the cell in
+  //the log. Returns the number of steps, or -1 with y = y0 if every rung failed or
+  //burn_recover = false.
+  int RecoverCell(const std::string &where, const Real rho, const Real e0,
+                  const Real dt, const Real y0[NBURN], Real y[NBURN], Real *h,
+                  Real *temp, bool *stiff, BurnArena *arena=nullptr);
+  //burn a cell at rest over dt (code units) in nburn equal burns, as BurnMeshBlock
+  //would with that hydro step: rho in g/cm3, ED the energy density (code units) and y
+  //the abundances, both updated. Returns the most steps of one burn, or -1 on failure.
+  int BurnZone(const Real rho, const Real dt, const int nburn, Real *ED,
+               Real y[NSCALARS]);
+  //specific internal energy (erg/g) at density rho (g/cm3), temperature temp (K) and
+  //abundances y, the e0 of IntegrateCell
+  Real SpecificEnergy(const Real rho, const Real temp, const Real y[NSCALARS]) const;
+
+  //cells per gather/scatter tile, <chemistry> burn_tile
+  int TileSize() const {return ntile_;}
+  //arena bytes a thread needs for BurnTile and IntegrateCell
+  std::size_t ArenaBytes() const;
+  //burn every cell with set instead of burn_* and the regime table; for the tuner
+  void SetSettings(const Settings &set) {set_ = set; ptune_ = nullptr;}
+  const Settings &GetSettings() const {return set_;}
+
+  //number of steps taken by each cell in the last burn, a measure of its cost
+  AthenaArray<int> nsteps;
+  //1 if the cell was stiff at the end of its last burn; its next burn is implicit
+  AthenaArray<int> stiff;
+
+  //cache shared by the MeshBlocks of the rank, nullptr unless burn_cache = true
+  static BurnCache *pcache;
+  //regime table of the rank, nullptr unless burn_tune_file is set
+  static BurnTuning *ptune;
+  //table of small burns of the rank, nullptr unless burn_surrogate_file is set
+  static BurnSurrogate *psurr;
+  //failed cell burns of the rank recovered by each rung, and (last) not recovered
+  static std::atomic<long> nrecover[NRUNG + 1];
+  //whether something burns the MeshBlocks every step; set by BurnScheduler, which the
+  //problem generator creates with burn = coupled
+  static bool driven;
+
+ private:
+  ChemNetwork *pmy_net_;
+  MeshBlock *pmy_mb_;
+  Settings set_;         // burn_* settings, of the cells outside the regime table
+  const BurnTuning *ptune_;  // regime table used by this integrator, or nullptr
+  AthenaArray<Real> h_;  // last accepted step of each cell (s), to start the next burn
+  int ntile_;            // cells per gather/scatter tile along x1
+  BurnArena arena_;      // scratch of the burns called from one thread
+  bool lockstep_;        // burn easy cells in lockstep, <chemistry> burn_lockstep
+  int lock_nsub_;        // fixed substeps of a lockstep burn
+  int lock_newton_;      // Newton iterations per substep
+  int lock_maxsteps_;    // most adaptive steps of a cell for it to go in lockstep
+  AthenaArray<int> lanes_;  // 1 (-1) if the last burn passed (failed) in lockstep
+  bool mixed_lu_;        // float LU with Real refinement, <chemistry> burn_lu = mixed
+  bool recover_;         // recovery ladder for failed burns, <chemistry> burn_recover
+  Real recover_hinit_;   // first trial step of the recovery, in units of dt
+  int recover_nsub_;     // substeps of the third rung
+  int recover_steps_;    // step budget of the implicit rungs, in units of maxsteps
+  int recover_log_;      // recoveries of the rank written to the log
+
+  Real CellTemperature(const Real rho, const Real e0, const Real y[NBURN],
+                       const Real tguess) const;
+  const Settings &CellSettings(const Real rho, const Real e0, const Real y[NBURN],
+                               const Real tguess) const;
+  int Integrate(const Settings &set, const bool exact, const Real rho, const Real e0,
+                const Real dt, Real y[NBURN], Real *h, Real *temp, bool *stiff,
+                BurnArena *arena);
+  int ExplicitSteps(const Settings &set, Real rdata[3], const Real dt, Real y[NBURN],
+                    Real *h, Real *t, bool *stiff);
+  int RosenbrockSteps(const Settings &set, Real rdata[3], const Real dt, Real y[NBURN],
+                      Real *h, Real *t, const int nstep0, bool *stiff,
+                      const bool exact, BurnArena *arena);
+  int BackwardEulerSteps(const Settings &set, Real rdata[3], const Real dt,
+                         Real y[NBURN], Real *h, BurnArena *arena);
+  Real SpectralRadius(const Real jac[NBURN][NBURN]);
+  void BurnLanes(const Real dt, const int k, const int j, const int nlane,
+                 const int lane_i[], const Real lane_rho[], const Real lane_e0[],
+                 Real *lane_y[], BurnArena *arena);
+  void LockstepBurn(const int nlane, const Real rho[], const Real e0[], const Real dt,
+                    Real *y[], Real temp[], bool ok[], BurnArena *arena);
+  void FinishCell(const int k, const int j, const int i, const Real rho, const Real e0,
+                  const Real y[NBURN], const Real h, const Real temp,
+                  const bool is_stiff, const int nstep);
+};
+
+#endif // CHEMISTRY_UTILS_BURN_INTEGRATOR_HPP_
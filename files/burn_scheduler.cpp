@@ -0,0 +1,158 @@
+//======================================================================================
+// Athena++ astrophysical MHD code
+// Copyright (C) 2014 James M. Stone  <jmstone@princeton.edu>
+// See LICENSE file for full public license information.
+//======================================================================================
+//! \file burn_scheduler.cpp
+//  \brief implementation of the work-stealing pool for the coupled burn
+//======================================================================================
+
+// C++ headers
+#include <algorithm>  // std::stable_sort(), std::max()
+#include <stdexcept>  // std::runtime_error()
+
+// Athena++ headers
+#include "../../athena.hpp"
+#include "../../athena_arrays.hpp"
+#include "../../mesh/mesh.hpp"
+#include "../../parameter_input.hpp"
+#include "../../scalars/scalars.hpp"
+#include "burn_arena.hpp"
+#include "burn_integrator.hpp"
+#include "burn_scheduler.hpp"
+
+#ifdef OPENMP_PARALLEL
+#include <omp.h>
+#endif
+
+BurnScheduler::BurnScheduler(Mesh *pm, ParameterInput *pin) :
+    nstolen(0), pmy_mesh_(pm), arena_bytes_(0) {
+  nthreads_ = pin->GetOrAddInteger("chemistry", "burn_threads",
+                                   pm->GetNumMeshThreads());
+  if (nthreads_ < 1) nthreads_ = 1;
+  queues_.resize(nthreads_);
+  stolen_.resize(nthreads_);
+  locks_ = new std::mutex[nthreads_];
+  arenas_ = new BurnArena[nthreads_];
+  BurnIntegrator::driven = true;
+}
+
+BurnScheduler::~BurnScheduler() {
+  delete[] locks_;
+  delete[] arenas_;
+}
+
+//--------------------------------------------------------------------------------------
+//! \fn void BurnScheduler::Burn(const Real dt)
+//  \brief burn all chunks of all local MeshBlocks over dt
+
+void BurnScheduler::Burn(const Real dt) {
+  MakeChunks();
+  if (chunks_.empty()) return;
+
+  //most expensive chunks first, dealt round robin so that every thread starts with
+  //its share of the expensive ones
+  order_.resize(chunks_.size());
+  for (int n=0; n<static_cast<int>(order_.size()); ++n) order_[n] = n;
+  std::stable_sort(order_.begin(), order_.end(),
+                   [this](int a, int b) {return chunks_[a].cost > chunks_[b].cost;});
+  for (int t=0; t<nthreads_; ++t) {
+    queues_[t].chunk.clear();
+    queues_[t].front = 0;
+    stolen_[t] = 0;
+  }
+  for (int n=0; n<static_cast<int>(order_.size()); ++n) {
+    queues_[n % nthreads_].chunk.push_back(order_[n]);
+  }
+  for (int t=0; t<nthreads_; ++t) {
+    queues_[t].back = static_cast<int>(queues_[t].chunk.size());
+    //only grows the first time, or when the tile size changes
+    arenas_[t].Reserve(arena_bytes_);
+  }
+  error_.clear();
+
+#pragma omp parallel num_threads(nthreads_)
+  {
+    int tid = 0;
+#ifdef OPENMP_PARALLEL
+    tid = omp_get_thread_num();
+#endif
+    int c;
+    bool steal;
+    while ((c = NextChunk(tid, &steal)) >= 0) {
+      if (steal) stolen_[tid]++;
+      const Chunk &ch = chunks_[c];
+      //exceptions must not leave the parallel region
+      try {
+        ch.pburn->BurnTile(dt, ch.k, ch.j, ch.il, ch.iu, &arenas_[tid]);
+      } catch (std::exception &e) {
+        std::lock_guard<std::mutex> lock(error_lock_);
+        if (error_.empty()) error_ = e.what();
+        break;
+      }
+    }
+  }
+
+  nstolen = 0;
+  for (int t=0; t<nthreads_; ++t) nstolen += stolen_[t];
+  if (!error_.empty()) {
+    throw std::runtime_error(error_.c_str());
+  }
+  return;
+}
+
+//--------------------------------------------------------------------------------------
+//! \fn void BurnScheduler::MakeChunks()
+//  \brief one chunk per burn tile of every local MeshBlock, with its predicted cost
+
+void BurnScheduler::MakeChunks() {
+  chunks_.clear();
+  for (int b=0; b<pmy_mesh_->nblocal; ++b) {
+    MeshBlock *pmb = pmy_mesh_->my_blocks(b);
+    BurnIntegrator *pburn = pmb->pscalars->chemnet.pburn;
+    if (pburn == nullptr) continue;
+    const int ntile = pburn->TileSize();
+    arena_bytes_ = std::max(arena_bytes_, pburn->ArenaBytes());
+    for (int k=pmb->ks; k<=pmb->ke; ++k) {
+      for (int j=pmb->js; j<=pmb->je; ++j) {
+        for (int il=pmb->is; il<=pmb->ie; il+=ntile) {
+          Chunk ch;
+          ch.pburn = pburn;
+          ch.k = k;
+          ch.j = j;
+          ch.il = il;
+          ch.iu = std::min(il + ntile - 1, pmb->ie);
+          //a cell costs at least its gather, even if it did not burn
+          ch.cost = 0;
+          for (int i=ch.il; i<=ch.iu; ++i) ch.cost += pburn->nsteps(k, j, i) + 1;
+          chunks_.push_back(ch);
+        }
+      }
+    }
+  }
+  return;
+}
+
+//--------------------------------------------------------------------------------------
+//! \fn int BurnScheduler::NextChunk(const int tid, bool *steal)
+//  \brief next chunk for thread tid: the front of its own queue, else the back of
+//  another queue (steal = true); -1 when all are taken
+
+int BurnScheduler::NextChunk(const int tid, bool *steal) {
+  *steal = false;
+  {
+    std::lock_guard<std::mutex> lock(locks_[tid]);
+    Queue &q = queues_[tid];
+    if (q.front < q.back) return q.chunk[q.front++];
+  }
+  for (int v=1; v<nthreads_; ++v) {
+    const int victim = (tid + v) % nthreads_;
+    std::lock_guard<std::mutex> lock(locks_[victim]);
+    Queue &q = queues_[victim];
+    if (q.front < q.back) {
+      *steal = true;
+      return q.chunk[--q.back];
+    }
+  }
+  return -1;
+}
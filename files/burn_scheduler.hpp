@@ -0,0 +1,77 @@
+#ifndef CHEMISTRY_UTILS_BURN_SCHEDULER_HPP_
+#define CHEMISTRY_UTILS_BURN_SCHEDULER_HPP_
+//======================================================================================
+// Athena++ astrophysical MHD code
+// Copyright (C) 2014 James M. Stone  <jmstone@princeton.edu>
+// See LICENSE file for full public license information.
+//======================================================================================
+//! \file burn_scheduler.hpp
+//  \brief work-stealing thread pool for the coupled burn of all MeshBlocks of a rank
+//
+//  The cost of the coupled burn differs by orders of magnitude between cells: cold fuel
+//  takes no solver steps, a cell at the flame front thousands. Splitting the MeshBlocks
+//  statically over threads leaves most threads waiting for the one that owns the front.
+//  Instead the active cells of every local MeshBlock are cut into chunks of one burn
+//  tile (burn_tile cells along x1). The cost of a chunk is predicted from the solver
+//  steps its cells took in the previous burn, and the chunks are dealt, most expensive
+//  first, to one queue per thread. A thread takes chunks from the front of its own
+//  queue; once that is empty it steals from the back of the queues of the others.
+//  Every thread burns with scratch from its own BurnArena, and the queues keep their
+//  storage from burn to burn, so that a burn allocates nothing once the chunk count
+//  has settled.
+//======================================================================================
+
+// C++ headers
+#include <cstddef> // size_t
+#include <mutex>   // mutex
+#include <string>  // string
+#include <vector>  // vector
+
+// Athena++ headers
+#include "../../athena.hpp"
+
+class BurnArena;
+class BurnIntegrator;
+class Mesh;
+class ParameterInput;
+
+//! \class BurnScheduler
+//  \brief burns the local MeshBlocks with <chemistry> burn_threads threads
+class BurnScheduler {
+ public:
+  BurnScheduler(Mesh *pm, ParameterInput *pin);
+  ~BurnScheduler();
+
+  //burn every local MeshBlock over dt (code units)
+  void Burn(const Real dt);
+
+  long nstolen;  // chunks taken from another thread's queue in the last burn
+
+ private:
+  struct Chunk {
+    BurnIntegrator *pburn;
+    int k, j, il, iu;
+    long cost;  // predicted cost, solver steps in the previous burn
+  };
+  //chunk indices of one thread; chunk[front..back-1] are still to be burned
+  struct Queue {
+    std::vector<int> chunk;
+    int front, back;
+  };
+  Mesh *pmy_mesh_;
+  int nthreads_;
+  std::vector<Chunk> chunks_;
+  std::vector<int> order_;                // chunks, most expensive first
+  std::vector<Queue> queues_;             // one per thread
+  std::vector<long> stolen_;              // chunks stolen by each thread
+  std::mutex *locks_;                     // one per queue
+  BurnArena *arenas_;                     // burn scratch, one per thread
+  std::size_t arena_bytes_;               // scratch a thread needs
+  std::mutex error_lock_;
+  std::string error_;                     // first error raised by a thread
+
+  void MakeChunks();
+  int NextChunk(const int tid, bool *steal);
+};
+
+#endif // CHEMISTRY_UTILS_BURN_SCHEDULER_HPP_
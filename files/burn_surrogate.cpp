@@ -0,0 +1,358 @@
+//======================================================================================
+// Athena++ astrophysical MHD code
+// Copyright (C) 2014 James M. Stone  <jmstone@princeton.edu>
+// See LICENSE file for full public license information.
+//======================================================================================
+//! \file burn_surrogate.cpp
+//  \brief tabulated outcome of small burns, see burn_surrogate.hpp
+//======================================================================================
+
+// C++ headers
+#include <algorithm>  // std::max(), std::min()
+#include <cmath>      // std::abs(), std::log10(), std::pow()
+#include <cstring>    // std::strncmp()
+#include <fstream>    // ifstream, ofstream
+#include <iostream>   // cout, endl
+#include <sstream>    // stringstream
+#include <stdexcept>  // std::runtime_error()
+#include <string>     // string
+
+// Athena++ headers
+#include "../../athena.hpp"
+#include "../../parameter_input.hpp"
+#include "../../scalars/scalars.hpp"
+#include "burn_integrator.hpp"
+#include "burn_surrogate.hpp"
+
+namespace {
+// first bytes of a table file, with the version of the layout
+const char MAGIC[16] = "burn_surrogate1";
+// values per grid point: the mean rates of change of the abundances over dt (1/s),
+// and log10 of their magnitudes
+const int NV = 2*NSCALARS;
+// log10 of a rate of change that is zero
+const Real LOG_RATE_FLOOR = -300.0;
+
+int SpeciesIndex(const std::string name, const std::string block) {
+  for (int ispec=0; ispec < NSCALARS; ++ispec) {
+    if (ChemNetwork::species_names[ispec] == name) return ispec;
+  }
+  std::stringstream msg;
+  msg << "### FATAL ERROR in BurnSurrogate::Generate" << std::endl
+      << "<" << block << "> species " << name << " is not in the network" << std::endl;
+  throw std::runtime_error(msg.str().c_str());
+}
+} // namespace
+
+BurnSurrogate::BurnSurrogate() :
+    nlookup(0), nhit(0), fuel_(0), ash_(0), atol_(0.0), rtol_(0.0), demax_(0.0),
+    xother_(0.0) {
+  for (int d=0; d<NDIM; ++d) {
+    n_[d] = 0;
+    lo_[d] = 0.0;
+    du_[d] = 0.0;
+  }
+}
+
+//--------------------------------------------------------------------------------------
+//! \fn void BurnSurrogate::Generate(BurnIntegrator *pburn, ChemNetwork *pnet,
+//                                   ParameterInput *pin, const std::string block)
+//  \brief burn the composition of every grid point, then validate every hypercube
+//  against a burn at its center
+
+void BurnSurrogate::Generate(BurnIntegrator *pburn, ChemNetwork *pnet,
+                             ParameterInput *pin, const std::string block) {
+  fuel_ = SpeciesIndex(pin->GetString(block, "fuel"), block);
+  ash_ = SpeciesIndex(pin->GetString(block, "ash"), block);
+  Real hi[NDIM];
+  n_[0] = pin->GetOrAddInteger(block, "nrho", 12);
+  lo_[0] = std::log10(pin->GetOrAddReal(block, "rho_min", 1.0e5));
+  hi[0] = std::log10(pin->GetOrAddReal(block, "rho_max", 1.0e9));
+  n_[1] = pin->GetOrAddInteger(block, "nT", 16);
+  lo_[1] = std::log10(1.0e9*pin->GetOrAddReal(block, "T9_min", 0.1));
+  hi[1] = std::log10(1.0e9*pin->GetOrAddReal(block, "T9_max", 2.0));
+  n_[2] = pin->GetOrAddInteger(block, "nx", 6);
+  lo_[2] = pin->GetOrAddReal(block, "x_min", 0.05);
+  hi[2] = 1.0;
+  n_[3] = pin->GetOrAddInteger(block, "ndt", 8);
+  lo_[3] = std::log10(pin->GetOrAddReal(block, "dt_min", 1.0e-6));
+  hi[3] = std::log10(pin->GetOrAddReal(block, "dt_max", 1.0e-2));
+  for (int d=0; d<NDIM; ++d) {
+    if (n_[d] < 2 || !(hi[d] > lo_[d])) {
+      std::stringstream msg;
+      msg << "### FATAL ERROR in BurnSurrogate::Generate" << std::endl
+          << "<" << block << "> needs at least 2 points and a range of width > 0 "
+          << "along every axis" << std::endl;
+      throw std::runtime_error(msg.str().c_str());
+    }
+    du_[d] = (hi[d] - lo_[d])/(n_[d] - 1);
+  }
+  atol_ = pin->GetOrAddReal(block, "atol", 1.0e-8);
+  rtol_ = pin->GetOrAddReal(block, "rtol", 1.0e-2);
+  demax_ = pin->GetOrAddReal(block, "demax", 1.0e-2);
+
+  //grid points: a point is usable if its burn succeeded and is small
+  const int nnode = NumNodes();
+  val_.assign(nnode*NV, 0.0);
+  std::vector<char> good(nnode, 0);
+  for (int m=0; m<nnode; ++m) {
+    Real u[NDIM];
+    int rest = m;
+    for (int d=NDIM-1; d>=0; --d) {
+      u[d] = lo_[d] + (rest%n_[d])*du_[d];
+      rest /= n_[d];
+    }
+    Real dy[NSCALARS], de;
+    if (!BurnPoint(pburn, pnet, u, dy, &de) || !(std::abs(de) <= demax_)) continue;
+    Real *val = &val_[m*NV];
+    const Real dt = std::pow(10.0, u[3]);
+    for (int ispec=0; ispec < NSCALARS; ++ispec) {
+      val[ispec] = dy[ispec]/dt;
+      val[NSCALARS + ispec] = (dy[ispec] != 0.0) ? std::log10(std::abs(val[ispec]))
+                                                 : LOG_RATE_FLOOR;
+    }
+    good[m] = 1;
+  }
+
+  //hypercubes: all corners usable and the center reproduced
+  const int ncube = NumCubes();
+  trust_.assign(ncube, 0);
+  int ntrust = 0;
+  Real err_max = 0.0;
+  for (int c=0; c<ncube; ++c) {
+    int i[NDIM];
+    int rest = c;
+    for (int d=NDIM-1; d>=0; --d) {
+      i[d] = rest%(n_[d] - 1);
+      rest /= (n_[d] - 1);
+    }
+    bool ok = true;
+    for (int corner=0; corner < (1 << NDIM) && ok; ++corner) {
+      int m = 0;
+      for (int d=0; d<NDIM; ++d) m = m*n_[d] + i[d] + ((corner >> d) & 1);
+      ok = (good[m] != 0);
+    }
+    if (!ok) continue;
+    Real u[NDIM], w[NDIM];
+    for (int d=0; d<NDIM; ++d) {
+      u[d] = lo_[d] + (i[d] + 0.5)*du_[d];
+      w[d] = 0.5;
+    }
+    Real dy[NSCALARS], dyref[NSCALARS], de;
+    if (!BurnPoint(pburn, pnet, u, dyref, &de)) continue;
+    if (!Interpolate(i, w, std::pow(10.0, u[3]), dy)) continue;
+    Real err = 0.0, scale = 0.0;
+    for (int ispec=0; ispec < NSCALARS; ++ispec) {
+      const Real a = ChemNetwork::MassNumber(ispec);
+      err = std::max(err, a*std::abs(dy[ispec] - dyref[ispec]));
+      scale = std::max(scale, a*std::abs(dyref[ispec]));
+    }
+    if (err <= atol_ + rtol_*scale) {
+      trust_[c] = 1;
+      ntrust++;
+      err_max = std::max(err_max, err/(atol_ + rtol_*scale));
+    }
+  }
+  std::cout << "burn surrogate " << ChemNetwork::species_names[fuel_] << "/"
+            << ChemNetwork::species_names[ash_] << ": " << ntrust << " of " << ncube
+            << " hypercubes trusted, largest error " << err_max
+            << " of the tolerance in them" << std::endl;
+  return;
+}
+
+//--------------------------------------------------------------------------------------
+//! \fn bool BurnSurrogate::BurnPoint(BurnIntegrator *pburn, ChemNetwork *pnet,
+//                                    const Real u[NDIM], Real dy[NSCALARS],
+//                                    Real *de) const
+//  \brief burn of the fuel-ash composition at the state u of the grid: the change of
+//  the abundances, and of the energy relative to the internal energy. False if the
+//  integration failed.
+
+bool BurnSurrogate::BurnPoint(BurnIntegrator *pburn, ChemNetwork *pnet,
+                              const Real u[NDIM], Real dy[NSCALARS], Real *de) const {
+  const Real rho = std::pow(10.0, u[0]);
+  const Real temp = std::pow(10.0, u[1]);
+  const Real dt = std::pow(10.0, u[3]);
+  Real y0[NSCALARS], y[BurnIntegrator::NBURN];
+  for (int ispec=0; ispec < NSCALARS; ++ispec) y0[ispec] = 0.0;
+  y0[fuel_] = u[2]/ChemNetwork::MassNumber(fuel_);
+  y0[ash_] += (1.0 - u[2])/ChemNetwork::MassNumber(ash_);
+  for (int ispec=0; ispec < NSCALARS; ++ispec) y[ispec] = y0[ispec];
+  y[NSCALARS] = 1.0;
+  const Real e0 = pburn->SpecificEnergy(rho, temp, y0);
+  Real h = 0.0, t = temp;
+  bool stiff = false;
+  if (pburn->IntegrateCell(rho, e0, dt, y, &h, &t, &stiff) < 0) return false;
+  for (int ispec=0; ispec < NSCALARS; ++ispec) dy[ispec] = y[ispec] - y0[ispec];
+  *de = (pnet->BindingEnergy(y) - pnet->BindingEnergy(y0))/e0;
+  return true;
+}
+
+//--------------------------------------------------------------------------------------
+//! \fn int BurnSurrogate::CubeIndex(const int i[NDIM]) const
+//  \brief hypercube with lower corner i
+
+int BurnSurrogate::CubeIndex(const int i[NDIM]) const {
+  int c = 0;
+  for (int d=0; d<NDIM; ++d) c = c*(n_[d] - 1) + i[d];
+  return c;
+}
+
+//--------------------------------------------------------------------------------------
+//! \fn bool BurnSurrogate::Interpolate(const int i[NDIM], const Real w[NDIM],
+//                                      const Real dt, Real dy[NSCALARS]) const
+//  \brief change of the abundances over dt (s) in the hypercube with lower corner i,
+//  at the weights w in [0,1] of its upper corner along each axis. Rates of change vary
+//  by orders of magnitude across a hypercube, so one that has the same sign at all its
+//  corners is interpolated in log10, and only one that changes sign linearly. The
+//  products are then scaled to the mass the consumed species lose, which conserves
+//  mass exactly. False if there are products but nothing is consumed, or the reverse.
+
+bool BurnSurrogate::Interpolate(const int i[NDIM], const Real w[NDIM], const Real dt,
+                                Real dy[NSCALARS]) const {
+  const int NCORNER = 1 << NDIM;
+  int m[NCORNER];
+  Real wc[NCORNER];
+  for (int corner=0; corner < NCORNER; ++corner) {
+    m[corner] = 0;
+    wc[corner] = 1.0;
+    for (int d=0; d<NDIM; ++d) {
+      const int up = (corner >> d) & 1;
+      m[corner] = m[corner]*n_[d] + i[d] + up;
+      wc[corner] *= up ? w[d] : 1.0 - w[d];
+    }
+  }
+  Real gain = 0.0, loss = 0.0;  // mass fraction of the products, of the consumed
+  for (int ispec=0; ispec < NSCALARS; ++ispec) {
+    Real lin = 0.0, lg = 0.0;
+    int npos = 0, nneg = 0;
+    for (int corner=0; corner < NCORNER; ++corner) {
+      const Real *val = &val_[m[corner]*NV];
+      lin += wc[corner]*val[ispec];
+      lg += wc[corner]*val[NSCALARS + ispec];
+      if (val[ispec] > 0.0) npos++;
+      if (val[ispec] < 0.0) nneg++;
+    }
+    Real rate = lin;
+    if (npos == NCORNER) rate = std::pow(10.0, lg);
+    if (nneg == NCORNER) rate = -std::pow(10.0, lg);
+    dy[ispec] = rate*dt;
+    const Real dx = ChemNetwork::MassNumber(ispec)*dy[ispec];
+    if (dx > 0.0) gain += dx;
+    if (dx < 0.0) loss -= dx;
+  }
+  if (gain == 0.0 && loss == 0.0) return true;
+  if (!(gain > 0.0 && loss > 0.0)) return false;
+  const Real scale = loss/gain;
+  for (int ispec=0; ispec < NSCALARS; ++ispec) {
+    if (dy[ispec] > 0.0) dy[ispec] *= scale;
+  }
+  return true;
+}
+
+//--------------------------------------------------------------------------------------
+//! \fn bool BurnSurrogate::Burn(const Real rho, const Real temp, const Real dt,
+//                               Real y[NSCALARS])
+//  \brief the change of the abundances over dt from the table, if the composition is
+//  fuel and ash and the state is in a trusted hypercube
+
+bool BurnSurrogate::Burn(const Real rho, const Real temp, const Real dt,
+                         Real y[NSCALARS]) {
+  nlookup++;
+  Real xother = 0.0;
+  for (int ispec=0; ispec < NSCALARS; ++ispec) {
+    if (ispec != fuel_ && ispec != ash_) {
+      xother += ChemNetwork::MassNumber(ispec)*y[ispec];
+    }
+  }
+  if (!(xother <= xother_) || !(rho > 0.0) || !(temp > 0.0) || !(dt > 0.0)) {
+    return false;
+  }
+  const Real u[NDIM] = {std::log10(rho), std::log10(temp),
+                        ChemNetwork::MassNumber(fuel_)*y[fuel_], std::log10(dt)};
+  int i[NDIM];
+  Real w[NDIM];
+  for (int d=0; d<NDIM; ++d) {
+    const Real s = (u[d] - lo_[d])/du_[d];
+    if (!(s >= 0.0 && s <= n_[d] - 1)) return false;
+    i[d] = std::min(static_cast<int>(s), n_[d] - 2);
+    w[d] = s - i[d];
+  }
+  if (!trust_[CubeIndex(i)]) return false;
+  Real dy[NSCALARS];
+  if (!Interpolate(i, w, dt, dy)) return false;
+  for (int ispec=0; ispec < NSCALARS; ++ispec) y[ispec] += dy[ispec];
+  nhit++;
+  return true;
+}
+
+//--------------------------------------------------------------------------------------
+//! \fn void BurnSurrogate::Write(const std::string fname) const
+//  \brief the grid, trust criteria, changes and trust flags, in binary
+
+void BurnSurrogate::Write(const std::string fname) const {
+  std::ofstream os(fname.c_str(), std::ios::binary);
+  if (!os) {
+    std::stringstream msg;
+    msg << "### FATAL ERROR in BurnSurrogate::Write" << std::endl
+        << "Unable to open burn surrogate table " << fname << std::endl;
+    throw std::runtime_error(msg.str().c_str());
+  }
+  const int head[4] = {NSCALARS, static_cast<int>(sizeof(Real)), fuel_, ash_};
+  const Real crit[3] = {atol_, rtol_, demax_};
+  os.write(MAGIC, sizeof(MAGIC));
+  os.write(reinterpret_cast<const char *>(head), sizeof(head));
+  os.write(reinterpret_cast<const char *>(n_), sizeof(n_));
+  os.write(reinterpret_cast<const char *>(lo_), sizeof(lo_));
+  os.write(reinterpret_cast<const char *>(du_), sizeof(du_));
+  os.write(reinterpret_cast<const char *>(crit), sizeof(crit));
+  os.write(reinterpret_cast<const char *>(val_.data()), val_.size()*sizeof(Real));
+  os.write(trust_.data(), trust_.size());
+  return;
+}
+
+//--------------------------------------------------------------------------------------
+//! \fn void BurnSurrogate::Read(const std::string fname, const Real xother)
+//  \brief read a table written by Write() for the network and Real of this build
+
+void BurnSurrogate::Read(const std::string fname, const Real xother) {
+  std::ifstream is(fname.c_str(), std::ios::binary);
+  std::stringstream msg;
+  msg << "### FATAL ERROR in BurnSurrogate::Read" << std::endl;
+  if (!is) {
+    msg << "Unable to open burn surrogate table " << fname << std::endl;
+    throw std::runtime_error(msg.str().c_str());
+  }
+  char magic[sizeof(MAGIC)];
+  int head[4];
+  Real crit[3];
+  is.read(magic, sizeof(magic));
+  is.read(reinterpret_cast<char *>(head), sizeof(head));
+  is.read(reinterpret_cast<char *>(n_), sizeof(n_));
+  is.read(reinterpret_cast<char *>(lo_), sizeof(lo_));
+  is.read(reinterpret_cast<char *>(du_), sizeof(du_));
+  is.read(reinterpret_cast<char *>(crit), sizeof(crit));
+  bool ok = is && std::strncmp(magic, MAGIC, sizeof(MAGIC)) == 0
+            && head[0] == NSCALARS && head[1] == static_cast<int>(sizeof(Real))
+            && head[2] >= 0 && head[2] < NSCALARS && head[3] >= 0 && head[3] < NSCALARS;
+  for (int d=0; d<NDIM && ok; ++d) ok = (n_[d] >= 2 && du_[d] > 0.0);
+  if (ok) {
+    fuel_ = head[2];
+    ash_ = head[3];
+    val_.resize(NumNodes()*NV);
+    trust_.resize(NumCubes());
+    is.read(reinterpret_cast<char *>(val_.data()), val_.size()*sizeof(Real));
+    is.read(trust_.data(), trust_.size());
+    ok = static_cast<bool>(is);
+  }
+  if (!ok) {
+    msg << fname << " is not a burn surrogate table for this network and build"
+        << std::endl;
+    throw std::runtime_error(msg.str().c_str());
+  }
+  atol_ = crit[0];
+  rtol_ = crit[1];
+  demax_ = crit[2];
+  xother_ = xother;
+  return;
+}
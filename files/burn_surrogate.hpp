@@ -0,0 +1,87 @@
+#ifndef CHEMISTRY_UTILS_BURN_SURROGATE_HPP_
+#define CHEMISTRY_UTILS_BURN_SURROGATE_HPP_
+//======================================================================================
+// Athena++ astrophysical MHD code
+// Copyright (C) 2014 James M. Stone  <jmstone@princeton.edu>
+// See LICENSE file for full public license information.
+//======================================================================================
+//! \file burn_surrogate.hpp
+//  \brief tabulated outcome of small burns, used in place of the coupled burn
+//
+//  Over most of the domain the burn of one hydro step is a small and smooth change of a
+//  composition of two species, the fuel and its ash. The table holds the burn over dt of
+//  the composition X(fuel) = X, X(ash) = 1 - X, on a grid uniform in (log10 rho, log10 T,
+//  X, log10 dt), computed with the integrator of the coupled burn, as the mean rates of
+//  change of the abundances over dt. A cell whose mass fraction outside fuel and ash is
+//  below <chemistry> burn_surrogate_xother (1e-3) and whose state lies in a trusted
+//  hypercube of the grid takes the multilinear interpolation of the rates at its state,
+//  in log10 where they keep their sign, with the products scaled to conserve mass; its
+//  energy follows from the change of binding energy, so that mass and energy are
+//  conserved as by the integrator. Other cells are integrated.
+//
+//  A hypercube is trusted if at all its corners the burn succeeded and released less
+//  than demax of the internal energy, and if at its center the interpolated change
+//  matches a burn of the network to atol + rtol times the largest change of a mass
+//  fraction. The table is built and validated by the onezone_burn problem generator
+//  with golden_mode = surrogate from the parameters of <burn_surrogate>, and read with
+//  <chemistry> burn_surrogate_file. It is written in binary, for the Real of the build
+//  that made it.
+//======================================================================================
+
+// C++ headers
+#include <atomic>  // atomic
+#include <string>  // string
+#include <vector>  // vector
+
+// Athena++ headers
+#include "../../athena.hpp"
+
+class BurnIntegrator;
+class ChemNetwork;
+class ParameterInput;
+
+//! \class BurnSurrogate
+//  \brief change of the abundances over dt by (rho, T, X(fuel), dt), with a trust flag
+//  per hypercube of the grid
+class BurnSurrogate {
+ public:
+  BurnSurrogate();
+
+  //compute and validate the table with the integrator pburn, from the parameters of
+  //<block>, and report the share of trusted hypercubes
+  void Generate(BurnIntegrator *pburn, ChemNetwork *pnet, ParameterInput *pin,
+                const std::string block);
+  void Write(const std::string fname) const;
+  //read a table, to be used for cells with at most xother of other species
+  void Read(const std::string fname, const Real xother);
+
+  //burn of the abundances y at density rho (g/cm3) and temperature temp (K) over dt
+  //(s) from the table: returns true and updates y if the cell qualifies, false and
+  //leaves y unchanged otherwise. Thread safe.
+  bool Burn(const Real rho, const Real temp, const Real dt, Real y[NSCALARS]);
+
+  std::atomic<long> nlookup;  // cells tried since the start of the run
+  std::atomic<long> nhit;     // cells burned from the table
+
+ private:
+  static const int NDIM = 4;  // log10 rho, log10 T, X(fuel), log10 dt
+  int fuel_, ash_;            // species of the composition of the table
+  int n_[NDIM];               // grid points along each axis, >= 2
+  Real lo_[NDIM], du_[NDIM];  // first grid point and spacing
+  Real atol_, rtol_, demax_;  // trust criteria the table was built with
+  Real xother_;               // largest mass fraction of other species
+  //per grid point the mean rates of change of the abundances (1/s) and log10 of
+  //their magnitudes, 2*NSCALARS values
+  std::vector<Real> val_;
+  std::vector<char> trust_;   // 1 for a trusted hypercube
+
+  int NumNodes() const {return n_[0]*n_[1]*n_[2]*n_[3];}
+  int NumCubes() const {return (n_[0]-1)*(n_[1]-1)*(n_[2]-1)*(n_[3]-1);}
+  int CubeIndex(const int i[NDIM]) const;
+  bool Interpolate(const int i[NDIM], const Real w[NDIM], const Real dt,
+                   Real dy[NSCALARS]) const;
+  bool BurnPoint(BurnIntegrator *pburn, ChemNetwork *pnet, const Real u[NDIM],
+                 Real dy[NSCALARS], Real *de) const;
+};
+
+#endif // CHEMISTRY_UTILS_BURN_SURROGATE_HPP_
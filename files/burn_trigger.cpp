@@ -0,0 +1,166 @@
+//======================================================================================
+// Athena++ astrophysical MHD code
+// Copyright (C) 2014 James M. Stone  <jmstone@princeton.edu>
+// See LICENSE file for full public license information.
+//======================================================================================
+//! \file burn_trigger.cpp
+//  \brief output trigger tied to the state of the burn, see burn_trigger.hpp
+//======================================================================================
+
+// C++ headers
+#include <algorithm>  // std::max()
+#include <cmath>      // std::fabs()
+#include <iostream>   // cout, endl
+#include <sstream>    // stringstream
+#include <stdexcept>  // std::runtime_error()
+#include <string>     // string
+
+// Athena++ headers
+#include "../athena.hpp"
+#include "../athena_arrays.hpp"
+#include "../coordinates/coordinates.hpp"
+#include "../eos/eos.hpp"
+#include "../globals.hpp"
+#include "../hydro/hydro.hpp"
+#include "../mesh/mesh.hpp"
+#include "../parameter_input.hpp"
+#include "../scalars/scalars.hpp"
+#include "burn_trigger.hpp"
+
+#ifdef MPI_PARALLEL
+#include <mpi.h>
+#endif
+
+//--------------------------------------------------------------------------------------
+// BurnTrigger constructor; the state of the last output is kept in the input, so that
+// restarts carry on from it
+
+BurnTrigger::BurnTrigger(ParameterInput *pin, const std::string block) :
+    pin_(pin), block_(block), marked_(false), last_time_(0.0), xfuel0_(0.0),
+    have_cur_(false), cur_time_(0.0) {
+#ifndef INCLUDE_CHEMISTRY
+  std::stringstream msg;
+  msg << "### FATAL ERROR in BurnTrigger constructor" << std::endl
+      << "<" << block << "> trigger = burn requires a chemistry network" << std::endl;
+  throw std::runtime_error(msg.str().c_str());
+#endif
+  dt_min_ = pin->GetOrAddReal(block, "dt_min", 0.0);
+  denuc_ = pin->GetOrAddReal(block, "denuc", 1.0e16);
+  dtemp_ = pin->GetOrAddReal(block, "dtemp", 0.1);
+  dburn_ = pin->GetOrAddReal(block, "dburn", 0.05);
+  for (int n=0; n<NSTATE; ++n) last_[n] = 0.0;
+  if (pin->DoesParameterExist(block, "trigger_time")) {
+    marked_ = true;
+    last_time_ = pin->GetReal(block, "trigger_time");
+    last_[IEBIND] = pin->GetReal(block, "trigger_ebind");
+    last_[ITMAX] = pin->GetReal(block, "trigger_tmax");
+    last_[IXFUEL] = pin->GetReal(block, "trigger_xfuel");
+    xfuel0_ = pin->GetReal(block, "trigger_xfuel0");
+  }
+}
+
+//--------------------------------------------------------------------------------------
+//! \fn bool BurnTrigger::Due(Mesh *pm, const Real time)
+//  \brief whether dt_min has passed since the last output and the burn state has
+//  changed by more than one of the thresholds
+
+bool BurnTrigger::Due(Mesh *pm, const Real time) {
+  if (!marked_ || time - last_time_ < dt_min_) return false;
+  Reduce(pm, cur_);
+  cur_time_ = time;
+  have_cur_ = true;
+  if (denuc_ > 0.0 && std::fabs(cur_[IEBIND] - last_[IEBIND]) > denuc_) return true;
+  if (dtemp_ > 0.0 && std::fabs(cur_[ITMAX] - last_[ITMAX]) > dtemp_*last_[ITMAX]) {
+    return true;
+  }
+  if (dburn_ > 0.0 && xfuel0_ > 0.0
+      && std::fabs(cur_[IXFUEL] - last_[IXFUEL]) > dburn_*xfuel0_) {
+    return true;
+  }
+  return false;
+}
+
+//--------------------------------------------------------------------------------------
+//! \fn void BurnTrigger::Mark(Mesh *pm, const Real time)
+//  \brief make the burn state at time the reference of the next Due()
+
+void BurnTrigger::Mark(Mesh *pm, const Real time) {
+  if (!have_cur_ || cur_time_ != time) Reduce(pm, cur_);
+  have_cur_ = false;
+  for (int n=0; n<NSTATE; ++n) last_[n] = cur_[n];
+  if (!marked_) xfuel0_ = cur_[IXFUEL];
+  marked_ = true;
+  last_time_ = time;
+  pin_->SetReal(block_, "trigger_time", last_time_);
+  pin_->SetReal(block_, "trigger_ebind", last_[IEBIND]);
+  pin_->SetReal(block_, "trigger_tmax", last_[ITMAX]);
+  pin_->SetReal(block_, "trigger_xfuel", last_[IXFUEL]);
+  pin_->SetReal(block_, "trigger_xfuel0", xfuel0_);
+  return;
+}
+
+//--------------------------------------------------------------------------------------
+//! \fn void BurnTrigger::Reduce(Mesh *pm, Real state[NSTATE]) const
+//  \brief mass-averaged binding energy and fuel mass fraction and peak temperature over
+//  the whole mesh; the temperature is only computed if dtemp is used, and cells without
+//  one are left out of the peak and reported
+
+void BurnTrigger::Reduce(Mesh *pm, Real state[NSTATE]) const {
+  //mass, mass*Ebind, mass*Xfuel, and cells without a temperature
+  Real sum[4] = {0.0, 0.0, 0.0, 0.0};
+  Real tmax = 0.0;
+#ifdef INCLUDE_CHEMISTRY
+  Real y[NSCALARS];
+  for (int b=0; b<pm->nblocal; ++b) {
+    MeshBlock *pmb = pm->my_blocks(b);
+    ChemNetwork &chemnet = pmb->pscalars->chemnet;
+    const int ifuel = chemnet.FuelIndex();
+    const Real afuel = ChemNetwork::MassNumber(ifuel);
+    const Real gm1 = pmb->peos->GetGamma() - 1.0;
+    for (int k=pmb->ks; k<=pmb->ke; ++k) {
+      for (int j=pmb->js; j<=pmb->je; ++j) {
+        for (int i=pmb->is; i<=pmb->ie; ++i) {
+          const Real rho = pmb->phydro->w(IDN, k, j, i);
+          const Real dm = rho*pmb->pcoord->GetCellVolume(k, j, i);
+          for (int ispec=0; ispec < NSCALARS; ++ispec) {
+            y[ispec] = pmb->pscalars->s(ispec, k, j, i)/rho;
+          }
+          sum[0] += dm;
+          sum[1] += dm*chemnet.BindingEnergy(y);
+          sum[2] += dm*afuel*y[ifuel];
+          if (dtemp_ > 0.0) {
+            //internal energy density, as passed to the network
+            Real ED;
+            if (NON_BAROTROPIC_EOS) {
+              ED = pmb->phydro->w(IPR, k, j, i)/gm1;
+            } else {
+              ED = rho*SQR(pmb->peos->GetIsoSoundSpeed())/gm1;
+            }
+            //NaN where the tabulated EOS did not converge
+            const Real temp = chemnet.Temperature(chemnet.CellDensity(k, j, i), ED, y);
+            if (temp == temp) {
+              tmax = std::max(tmax, temp);
+            } else {
+              sum[3] += 1.0;
+            }
+          }
+        }
+      }
+    }
+  }
+#endif
+#ifdef MPI_PARALLEL
+  MPI_Allreduce(MPI_IN_PLACE, sum, 4, MPI_ATHENA_REAL, MPI_SUM, MPI_COMM_WORLD);
+  MPI_Allreduce(MPI_IN_PLACE, &tmax, 1, MPI_ATHENA_REAL, MPI_MAX, MPI_COMM_WORLD);
+#endif
+  if (sum[3] > 0.0 && Globals::my_rank == 0) {
+    std::cout << "### WARNING in BurnTrigger::Reduce" << std::endl
+              << static_cast<long>(sum[3]) << " cells without a temperature, the "
+              << "tabulated EOS did not converge; Tmax is that of the others" << std::endl;
+  }
+  const Real mass = (sum[0] > 0.0) ? sum[0] : 1.0;
+  state[IEBIND] = sum[1]/mass;
+  state[ITMAX] = tmax;
+  state[IXFUEL] = sum[2]/mass;
+  return;
+}
@@ -0,0 +1,65 @@
+#ifndef OUTPUTS_BURN_TRIGGER_HPP_
+#define OUTPUTS_BURN_TRIGGER_HPP_
+//======================================================================================
+// Athena++ astrophysical MHD code
+// Copyright (C) 2014 James M. Stone  <jmstone@princeton.edu>
+// See LICENSE file for full public license information.
+//======================================================================================
+//! \file burn_trigger.hpp
+//  \brief output trigger tied to the state of the burn
+//
+//  With trigger = burn in <abundance_output> or <tracer_particles>, an output is made
+//  when the burn has moved on since the last one, besides every dt: at least dt_min
+//  after it, as soon as one of
+//    Ebind  the mass-averaged binding energy [erg/g], i.e. the nuclear energy released
+//    Tmax   the peak temperature
+//    Xfuel  the mass-averaged mass fraction of the fuel isotope (NISOfuel)
+//  has changed by more than
+//    denuc  in erg/g                          (default 1e16)
+//    dtemp  relative to the last Tmax         (default 0.1)
+//    dburn  in burned fraction 1 - Xfuel/Xfuel at the first output (default 0.05)
+//  A threshold <= 0 disables its test. dt is then the longest interval between two
+//  outputs, so quiescent phases get a few dumps and a runaway as many as dt_min allows.
+//  The burn state is reduced over all ranks once per cycle, and only after dt_min.
+//======================================================================================
+
+// C++ headers
+#include <string>  // string
+
+// Athena++ headers
+#include "../athena.hpp"
+
+class Mesh;
+class ParameterInput;
+
+//! \class BurnTrigger
+//  \brief decides when the burn has changed enough since the last output
+class BurnTrigger {
+ public:
+  BurnTrigger(ParameterInput *pin, const std::string block);
+
+  //whether an output is due at time because the burn has changed; collective
+  bool Due(Mesh *pm, const Real time);
+  //remember the burn state of the output made at time; collective
+  void Mark(Mesh *pm, const Real time);
+
+ private:
+  enum {IEBIND, ITMAX, IXFUEL, NSTATE};
+  ParameterInput *pin_;
+  std::string block_;
+  Real dt_min_;        // shortest interval between two outputs
+  Real denuc_;         // change of the specific binding energy [erg/g]
+  Real dtemp_;         // relative change of the peak temperature
+  Real dburn_;         // change of the burned fuel fraction
+  bool marked_;        // an output has been made
+  Real last_time_;     // time of the last output
+  Real last_[NSTATE];  // burn state at the last output
+  Real xfuel0_;        // fuel mass fraction at the first output
+  bool have_cur_;      // cur_ holds the burn state at cur_time_
+  Real cur_time_;
+  Real cur_[NSTATE];
+
+  void Reduce(Mesh *pm, Real state[NSTATE]) const;
+};
+
+#endif // OUTPUTS_BURN_TRIGGER_HPP_
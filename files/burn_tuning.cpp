@@ -0,0 +1,142 @@
+//======================================================================================
+// Athena++ astrophysical MHD code
+// Copyright (C) 2014 James M. Stone  <jmstone@princeton.edu>
+// See LICENSE file for full public license information.
+//======================================================================================
+//! \file burn_tuning.cpp
+//  \brief table of solver settings by burning regime, see burn_tuning.hpp
+//======================================================================================
+
+// C++ headers
+#include <algorithm>  // std::sort()
+#include <fstream>    // ifstream, ofstream
+#include <iomanip>    // setprecision
+#include <iostream>   // endl
+#include <sstream>    // stringstream
+#include <stdexcept>  // std::runtime_error()
+#include <string>     // string
+
+// Athena++ headers
+#include "../../athena.hpp"
+#include "../../scalars/scalars.hpp"
+#include "burn_tuning.hpp"
+
+namespace {
+bool RegimeOrder(const BurnTuning::Regime &a, const BurnTuning::Regime &b) {
+  return (a.fuel != b.fuel) ? a.fuel < b.fuel : a.t9lo < b.t9lo;
+}
+} // namespace
+
+//--------------------------------------------------------------------------------------
+//! \fn void BurnTuning::Read(const std::string fname, const bool required)
+//  \brief read the regimes of a table written by Write()
+
+void BurnTuning::Read(const std::string fname, const bool required) {
+  regimes_.clear();
+  std::ifstream is(fname.c_str());
+  if (!is) {
+    if (!required) return;
+    std::stringstream msg;
+    msg << "### FATAL ERROR in BurnTuning::Read" << std::endl
+        << "Unable to open burn regime table " << fname << std::endl;
+    throw std::runtime_error(msg.str().c_str());
+  }
+  std::string line;
+  while (std::getline(is, line)) {
+    if (line.empty() || line[0] == '#') continue;
+    std::istringstream iss(line);
+    std::string name;
+    Regime reg;
+    int expl;
+    iss >> name >> reg.t9lo >> reg.t9hi >> reg.set.rtol >> reg.set.atol >> expl
+        >> reg.set.maxsteps >> reg.set.hinit >> reg.cost;
+    reg.fuel = -1;
+    for (int ispec=0; ispec < NSCALARS; ++ispec) {
+      if (ChemNetwork::species_names[ispec] == name) reg.fuel = ispec;
+    }
+    if (iss.fail() || reg.fuel < 0 || !(reg.t9hi >= reg.t9lo) || !(reg.set.rtol > 0.0)
+        || !(reg.set.atol > 0.0) || reg.set.maxsteps < 1 || !(reg.set.hinit > 0.0)) {
+      std::stringstream msg;
+      msg << "### FATAL ERROR in BurnTuning::Read" << std::endl
+          << "Invalid regime in " << fname << ": " << line << std::endl;
+      throw std::runtime_error(msg.str().c_str());
+    }
+    reg.set.expl = (expl != 0);
+    regimes_.push_back(reg);
+  }
+  std::sort(regimes_.begin(), regimes_.end(), RegimeOrder);
+  return;
+}
+
+//--------------------------------------------------------------------------------------
+//! \fn void BurnTuning::Write(const std::string fname) const
+//  \brief write the regimes, one per line
+
+void BurnTuning::Write(const std::string fname) const {
+  std::ofstream os(fname.c_str());
+  if (!os) {
+    std::stringstream msg;
+    msg << "### FATAL ERROR in BurnTuning::Write" << std::endl
+        << "Unable to open burn regime table " << fname << std::endl;
+    throw std::runtime_error(msg.str().c_str());
+  }
+  os << "# coupled burn settings by regime, <chemistry> burn_tune_file" << std::endl;
+  os << "# fuel  T9_lo  T9_hi  reltol  abstol  explicit  maxsteps  h_init  wall_time"
+     << std::endl;
+  for (const Regime &reg : regimes_) {
+    os << ChemNetwork::species_names[reg.fuel] << " " << std::setprecision(8)
+       << reg.t9lo << " " << reg.t9hi << " " << std::scientific << std::setprecision(3)
+       << reg.set.rtol << " " << reg.set.atol << " " << (reg.set.expl ? 1 : 0) << " "
+       << reg.set.maxsteps << " " << reg.set.hinit << " " << reg.cost << std::endl;
+    os.unsetf(std::ios::floatfield);
+  }
+  return;
+}
+
+//--------------------------------------------------------------------------------------
+//! \fn void BurnTuning::Replace(const int fuel, const Real t9lo, const Real t9hi,
+//                               const std::vector<Regime> &regimes)
+//  \brief drop the regimes of fuel that overlap [t9lo, t9hi], then add regimes, so
+//  that tuning runs of different fuels and temperature ranges fill one table
+
+void BurnTuning::Replace(const int fuel, const Real t9lo, const Real t9hi,
+                         const std::vector<Regime> &regimes) {
+  std::vector<Regime> keep;
+  for (const Regime &reg : regimes_) {
+    if (reg.fuel != fuel || reg.t9hi < t9lo || reg.t9lo > t9hi) keep.push_back(reg);
+  }
+  keep.insert(keep.end(), regimes.begin(), regimes.end());
+  std::sort(keep.begin(), keep.end(), RegimeOrder);
+  regimes_.swap(keep);
+  return;
+}
+
+//--------------------------------------------------------------------------------------
+//! \fn const BurnIntegrator::Settings *BurnTuning::Find(const int fuel,
+//                                                        const Real t9) const
+//  \brief first regime of fuel whose range holds t9; a table has a few tens of
+//  regimes, so a linear search
+
+const BurnIntegrator::Settings *BurnTuning::Find(const int fuel, const Real t9) const {
+  for (const Regime &reg : regimes_) {
+    if (reg.fuel == fuel && t9 >= reg.t9lo && t9 <= reg.t9hi) return &reg.set;
+  }
+  return nullptr;
+}
+
+//--------------------------------------------------------------------------------------
+//! \fn int BurnTuning::DominantSpecies(const Real y[NSCALARS])
+//  \brief species with the largest mass fraction
+
+int BurnTuning::DominantSpecies(const Real y[NSCALARS]) {
+  int imax = 0;
+  Real xmax = ChemNetwork::MassNumber(0)*y[0];
+  for (int ispec=1; ispec < NSCALARS; ++ispec) {
+    const Real x = ChemNetwork::MassNumber(ispec)*y[ispec];
+    if (x > xmax) {
+      xmax = x;
+      imax = ispec;
+    }
+  }
+  return imax;
+}
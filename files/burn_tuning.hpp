@@ -0,0 +1,63 @@
+#ifndef CHEMISTRY_UTILS_BURN_TUNING_HPP_
+#define CHEMISTRY_UTILS_BURN_TUNING_HPP_
+//======================================================================================
+// Athena++ astrophysical MHD code
+// Copyright (C) 2014 James M. Stone  <jmstone@princeton.edu>
+// See LICENSE file for full public license information.
+//======================================================================================
+//! \file burn_tuning.hpp
+//  \brief solver settings of the coupled burn by burning regime
+//
+//  A regime is a dominant species, the one with the largest mass fraction, and a range
+//  of temperature. The cheapest settings that reproduce the golden trajectories of a
+//  regime are found by the onezone_burn problem generator with golden_mode = tune and
+//  kept in a text table, one regime per line:
+//
+//    # fuel  T9_lo  T9_hi  reltol  abstol  explicit  maxsteps  h_init  wall_time
+//    12C  1.0  1.5  1.0e-04  1.0e-10  1  2000  1.0e+00  3.2e-03
+//
+//  h_init is the first trial step of a cell without a last step in units of the burn
+//  time, and wall_time the cost of the tuning burns of the regime (s). With
+//  <chemistry> burn_tune_file = table, each cell of the coupled burn is integrated with
+//  the settings of the first regime of its dominant species whose range holds its
+//  temperature, or with the burn_* settings if there is none.
+//======================================================================================
+
+// C++ headers
+#include <string>  // string
+#include <vector>  // vector
+
+// Athena++ headers
+#include "../../athena.hpp"
+#include "burn_integrator.hpp"
+
+//! \class BurnTuning
+//  \brief table of solver settings by dominant species and temperature
+class BurnTuning {
+ public:
+  struct Regime {
+    int fuel;         // dominant species
+    Real t9lo, t9hi;  // temperature range, 1e9 K
+    BurnIntegrator::Settings set;
+    Real cost;        // wall time of the tuning burns (s)
+  };
+
+  //read a table; a missing file is an error only if required
+  void Read(const std::string fname, const bool required);
+  void Write(const std::string fname) const;
+  //replace the regimes of fuel within [t9lo, t9hi] by regimes
+  void Replace(const int fuel, const Real t9lo, const Real t9hi,
+               const std::vector<Regime> &regimes);
+  //settings of the regime of dominant species fuel at temperature t9 (1e9 K), or
+  //nullptr if no regime holds it
+  const BurnIntegrator::Settings *Find(const int fuel, const Real t9) const;
+  int NumRegimes() const {return static_cast<int>(regimes_.size());}
+
+  //species with the largest mass fraction in the abundances y
+  static int DominantSpecies(const Real y[NSCALARS]);
+
+ private:
+  std::vector<Regime> regimes_;  // sorted by species and temperature
+};
+
+#endif // CHEMISTRY_UTILS_BURN_TUNING_HPP_
@@ -24,6 +24,7 @@
 #   -float            enable single precision (default is double)
 #   -mpi              enable parallelization with MPI
 #   -omp              enable parallelization with OpenMP
+#   -perf_counters    enable hardware performance counters around the chemistry kernels
 #   -hdf5             enable HDF5 output (requires the HDF5 library)
 #   --hdf5_path=path  path to HDF5 libraries (requires the HDF5 library)
 #   -fft              enable FFT (requires the FFTW library)
@@ -175,6 +176,13 @@ parser.add_argument('-omp',
                     default=False,
                     help='enable parallelization with OpenMP')
 
+# -perf_counters argument
+parser.add_argument('-perf_counters',
+                    action='store_true',
+                    default=False,
+                    help='enable hardware performance counters (perf_event_open, Linux) '
+                         'around the chemistry kernels')
+
 # --grav=[name] argument
 parser.add_argument('--grav',
                     default='none',
@@ -195,7 +203,7 @@ parser.add_argument('--fftw_path',
 # --chemistry argument
 parser.add_argument('--chemistry',
                     default=None,
-                    choices=["gow17", "H2", "kida","alpha13"],
+                    choices=["gow17", "H2", "kida","alpha13","nucnet"],
                     help='select chemical network')
 
 # --kida_rates argument
@@ -612,6 +620,8 @@ if args['chemistry'] is not None:
         + args['chemistry'] + '.cpp'
     makefile_options['CHEMISTRY_FILE'] = 'src/chemistry/*.cpp src/chemistry/utils/*.cpp'
     makefile_options['LIBRARY_FLAGS'] += ' -lsundials_cvode -lsundials_nvecserial'
+    # background I/O thread of the abundance output (std::thread)
+    makefile_options['LIBRARY_FLAGS'] += ' -lpthread'
     # specify the number of species for each network
     if args['chemistry'] == "gow17":
         definitions['NUMBER_PASSIVE_SCALARS'] = '12'
@@ -621,6 +631,11 @@ if args['chemistry'] is not None:
         definitions['NUMBER_PASSIVE_SCALARS'] = '2'
     elif args['chemistry'] == "alpha13":
         definitions['NUMBER_PASSIVE_SCALARS'] = '13'        
+    elif args['chemistry'] == "nucnet":
+        # the species come from the network file; --nscalars must match it
+        if args['nscalars'] == '0':
+            raise SystemExit('### CONFIGURE ERROR: --chemistry=nucnet requires '
+                             + '--nscalars=<number of species in the network file>')
 else:
     definitions['CHEMISTRY_OPTION'] = 'NOT_INCLUDE_CHEMISTRY'
     makefile_options['CHEMNET_FILE'] = ''
@@ -768,6 +783,10 @@ else:
         #   3180: pragma omp not recognized
         makefile_options['COMPILER_FLAGS'] += ' -diag-disable 3180'
 
+# -perf_counters argument
+if args['perf_counters']:
+    makefile_options['PREPROCESSOR_FLAGS'] += ' -DPERF_COUNTERS'
+
 # --grav argument
 if args['grav'] == "none":
     definitions['SELF_GRAVITY_ENABLED'] = '0'
@@ -902,6 +921,7 @@ print('  Radiation:                  ' + (args['radiation'] if args['radiation']
 print('  cvode_path:                 ' + args['cvode_path'])
 print('  Debug flags:                ' + ('ON' if args['debug'] else 'OFF'))
 print('  Code coverage flags:        ' + ('ON' if args['coverage'] else 'OFF'))
+print('  Performance counters:       ' + ('ON' if args['perf_counters'] else 'OFF'))
 print('  Linker flags:               ' + makefile_options['LINKER_FLAGS'] + ' '
       + makefile_options['LIBRARY_FLAGS'])
 print('  Floating-point precision:   ' + ('single' if args['float'] else 'double'))
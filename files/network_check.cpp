@@ -0,0 +1,257 @@
+//======================================================================================
+// Athena++ astrophysical MHD code
+// Copyright (C) 2014 James M. Stone  <jmstone@princeton.edu>
+//
+// This program is free software: you can redistribute and/or modify it under the terms
+// of the GNU General Public License (GPL) as published by the Free Software Foundation,
+// either version 3 of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+// PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+//
+// You should have received a copy of GNU GPL in the file LICENSE included in the code
+// distribution.  If not see <http://www.gnu.org/licenses/>.
+//======================================================================================
+//! \file network_check.cpp
+//  \brief right-hand side and Jacobian of the coupled burn against a reference
+//
+//  Evaluates ChemNetwork::RHSFull, with the exact energy derivatives, at every point of
+//  a grid of nT9 temperatures and nrho densities, both spaced logarithmically, for one
+//  composition. The values of f and the Jacobian are either recorded to, or compared
+//  against, a reference file:
+//
+//    check_mode = compare  compare against reference_file (default), and fail if an
+//                          entry is off by more than rtol
+//    check_mode = record   write reference_file
+//
+//  An entry v with reference r is off by |v - r|/(|r| + floor*rmax), rmax the largest
+//  reference |f| (|Jacobian|) of the grid point. network_check_alpha13.dat is recorded
+//  with alpha13, so that athinput.network_check checks both alpha13 itself and the
+//  general network with alpha13.net (--chemistry=nucnet) against it. The check runs in
+//  the problem generator of the first MeshBlock, so use one rank and nlim = 0.
+//======================================================================================
+
+// C++ headers
+#include <algorithm>  // std::max()
+#include <cmath>      // std::abs(), std::pow()
+#include <fstream>    // ifstream, ofstream
+#include <iomanip>    // setprecision
+#include <iostream>   // endl
+#include <sstream>    // stringstream
+#include <stdexcept>  // std::runtime_error()
+#include <string>     // c_str()
+#include <vector>     // vector container
+
+// Athena++ headers
+#include "../athena.hpp"
+#include "../athena_arrays.hpp"
+#include "../chemistry/utils/burn_integrator.hpp"
+#include "../coordinates/coordinates.hpp"
+#include "../eos/eos.hpp"
+#include "../globals.hpp"
+#include "../hydro/hydro.hpp"
+#include "../mesh/mesh.hpp"
+#include "../parameter_input.hpp"
+#include "../scalars/scalars.hpp"
+
+#ifndef INCLUDE_CHEMISTRY
+#error "network_check.cpp requires a chemistry network, configure with --chemistry"
+#endif
+
+namespace {
+const int NEQN = BurnIntegrator::NBURN;  // abundances and scaled energy
+const int NVAL = NEQN + NEQN*NEQN;  // f and the Jacobian of one grid point
+
+Real GridPoint(const Real vmin, const Real vmax, const int n, const int npts);
+void ReadReference(const std::string fname, const int npts, std::vector<Real> *ref);
+Real MaxError(const Real *val, const Real *ref, const int nval, const Real floor);
+} // namespace
+
+//======================================================================================
+//! \fn void MeshBlock::ProblemGenerator(ParameterInput *pin)
+//  \brief uniform background; the first MeshBlock runs the check. RHSFull is private
+//  to ChemNetwork, which lets MeshBlock call it.
+//======================================================================================
+
+void MeshBlock::ProblemGenerator(ParameterInput *pin) {
+  ChemNetwork &net = pscalars->chemnet;
+  //composition of the check, mole fractions; by default equal mass fractions, so
+  //that every reaction contributes
+  Real y0[NSCALARS];
+  for (int ispec=0; ispec < NSCALARS; ++ispec) {
+    y0[ispec] = pin->GetOrAddReal("problem", "s_init_"+net.species_names[ispec],
+                                  1.0/(NSCALARS*ChemNetwork::MassNumber(ispec)));
+  }
+
+  const Real T9min = pin->GetOrAddReal("problem", "T9_min", 0.5);
+  const Real T9max = pin->GetOrAddReal("problem", "T9_max", 5.0);
+  const int nT9 = pin->GetOrAddInteger("problem", "nT9", 4);
+  const Real rho_min = pin->GetOrAddReal("problem", "rho_min", 1.e6);
+  const Real rho_max = pin->GetOrAddReal("problem", "rho_max", 1.e8);
+  const int nrho = pin->GetOrAddInteger("problem", "nrho", 2);
+
+  for (int k=ks; k<=ke; ++k) {
+    for (int j=js; j<=je; ++j) {
+      for (int i=is; i<=ie; ++i) {
+        phydro->u(IDN, k, j, i) = rho_min;
+        phydro->u(IM1, k, j, i) = 0.0;
+        phydro->u(IM2, k, j, i) = 0.0;
+        phydro->u(IM3, k, j, i) = 0.0;
+        if (NON_BAROTROPIC_EOS) {
+          phydro->u(IEN, k, j, i) = net.InternalEnergyDensity(rho_min, 1.e9*T9min, y0);
+        }
+        for (int ispec=0; ispec < NSCALARS; ++ispec) {
+          pscalars->s(ispec, k, j, i) = y0[ispec]*rho_min;
+        }
+      }
+    }
+  }
+  if (gid != 0) return;
+
+  const std::string mode = pin->GetOrAddString("problem", "check_mode", "compare");
+  const std::string ref_file = pin->GetString("problem", "reference_file");
+  const Real rtol = pin->GetOrAddReal("problem", "rtol", 1.e-10);
+  const Real floor = pin->GetOrAddReal("problem", "floor", 1.e-12);
+  if (nT9 < 1 || nrho < 1) {
+    std::stringstream msg;
+    msg << "### FATAL ERROR in MeshBlock::ProblemGenerator" << std::endl
+        << "need nT9, nrho >= 1" << std::endl;
+    throw std::runtime_error(msg.str().c_str());
+  }
+
+  //f and the Jacobian at every grid point; e0 of the EOS, so that y[NEQN-1] = 1
+  BurnIntegrator burn(&net, nullptr, pin);
+  const int npts = nT9*nrho;
+  std::vector<Real> val(npts*NVAL, 0.0);
+  std::vector<int> flag(npts);
+  for (int p=0; p<npts; ++p) {
+    const Real temp = 1.e9*GridPoint(T9min, T9max, p/nrho, nT9);
+    const Real rho = GridPoint(rho_min, rho_max, p % nrho, nrho);
+    Real y[NEQN], f[NEQN], jac[NEQN][NEQN];
+    for (int ispec=0; ispec < NSCALARS; ++ispec) y[ispec] = y0[ispec];
+    y[NEQN-1] = 1.0;
+    for (int n=0; n<NEQN; ++n) {
+      f[n] = 0.0;
+      for (int m=0; m<NEQN; ++m) jac[n][m] = 0.0;
+    }
+    Real rdata[3] = {rho, burn.SpecificEnergy(rho, temp, y0), temp};
+    flag[p] = net.RHSFull(y, f, jac, rdata, true);
+    for (int n=0; n<NEQN; ++n) {
+      val[p*NVAL + n] = f[n];
+      for (int m=0; m<NEQN; ++m) val[p*NVAL + NEQN + n*NEQN + m] = jac[n][m];
+    }
+  }
+
+  if (mode == "record") {
+    std::ofstream os(ref_file.c_str());
+    os << "# f and Jacobian jac[j][i] = df[i]/dy[j] of RHSFull, row by row" << std::endl;
+    os << "# npts " << npts << " neqn " << NEQN << std::endl;
+    os << "# y";
+    for (int ispec=0; ispec < NSCALARS; ++ispec) os << " " << y0[ispec];
+    os << std::endl;
+    os << "# T9  rho[g/cm^3]  flag, then f, then the rows of jac" << std::endl;
+    os << std::scientific << std::setprecision(16);
+    for (int p=0; p<npts; ++p) {
+      os << GridPoint(T9min, T9max, p/nrho, nT9) << " "
+         << GridPoint(rho_min, rho_max, p % nrho, nrho) << " " << flag[p] << std::endl;
+      for (int n=0; n<NEQN+1; ++n) {
+        for (int m=0; m<NEQN; ++m) os << (m > 0 ? " " : "") << val[p*NVAL + n*NEQN + m];
+        os << std::endl;
+      }
+    }
+    std::cout << "network derivatives recorded to " << ref_file << std::endl;
+    return;
+  }
+
+  //compare mode: read the reference, every value after the three of the grid point
+  std::vector<Real> ref;
+  ReadReference(ref_file, npts, &ref);
+  bool pass = true;
+  std::cout << "# T9  rho  err_f  err_jac" << std::endl;
+  std::cout << std::scientific << std::setprecision(3);
+  for (int p=0; p<npts; ++p) {
+    Real err_f = MaxError(&val[p*NVAL], &ref[p*NVAL], NEQN, floor);
+    Real err_jac = MaxError(&val[p*NVAL + NEQN], &ref[p*NVAL + NEQN], NEQN*NEQN, floor);
+    bool ok = (err_f <= rtol && err_jac <= rtol);
+    pass = pass && ok;
+    std::cout << GridPoint(T9min, T9max, p/nrho, nT9) << " "
+              << GridPoint(rho_min, rho_max, p % nrho, nrho) << " " << err_f << " "
+              << err_jac << " " << (ok ? "PASS" : "FAIL") << std::endl;
+  }
+  std::cout.unsetf(std::ios_base::floatfield);
+  std::cout << "network derivatives against " << ref_file << ": "
+            << (pass ? "PASS" : "FAIL") << std::endl;
+  if (!pass) {
+    std::stringstream msg;
+    msg << "### FATAL ERROR in MeshBlock::ProblemGenerator" << std::endl
+        << "f or Jacobian of the network off the reference " << ref_file
+        << " by more than rtol = " << rtol << std::endl;
+    throw std::runtime_error(msg.str().c_str());
+  }
+  return;
+}
+
+namespace {
+//! \fn Real GridPoint(const Real vmin, const Real vmax, const int n, const int npts)
+//  \brief point n of npts log-spaced in [vmin, vmax]
+Real GridPoint(const Real vmin, const Real vmax, const int n, const int npts) {
+  if (npts == 1) return vmin;
+  return vmin*std::pow(vmax/vmin, static_cast<Real>(n)/(npts - 1));
+}
+
+//! \fn void ReadReference(const std::string fname, const int npts,
+//                         std::vector<Real> *ref)
+//  \brief f and Jacobian of npts grid points, NVAL values each, from a reference file
+void ReadReference(const std::string fname, const int npts, std::vector<Real> *ref) {
+  std::ifstream is(fname.c_str());
+  if (!is) {
+    std::stringstream msg;
+    msg << "### FATAL ERROR in MeshBlock::ProblemGenerator" << std::endl
+        << "Unable to open reference file " << fname
+        << ", run with problem/check_mode=record first" << std::endl;
+    throw std::runtime_error(msg.str().c_str());
+  }
+  ref->assign(npts*NVAL, 0.0);
+  std::string line;
+  int p = 0, n = 0;
+  bool point = true;  // the next line is the T9, rho and flag of a grid point
+  while (p < npts && std::getline(is, line)) {
+    if (line.empty() || line[0] == '#') continue;
+    if (point) {
+      point = false;
+      continue;
+    }
+    std::istringstream iss(line);
+    Real v;
+    while (n < NVAL && iss >> v) (*ref)[p*NVAL + n++] = v;
+    if (n == NVAL) {
+      ++p;
+      n = 0;
+      point = true;
+    }
+  }
+  if (p < npts) {
+    std::stringstream msg;
+    msg << "### FATAL ERROR in MeshBlock::ProblemGenerator" << std::endl
+        << "Reference file " << fname << " has " << p << " grid points, expected "
+        << npts << std::endl;
+    throw std::runtime_error(msg.str().c_str());
+  }
+  return;
+}
+
+//! \fn Real MaxError(const Real *val, const Real *ref, const int nval,
+//                    const Real floor)
+//  \brief largest |val - ref|/(|ref| + floor*max|ref|) of nval values
+Real MaxError(const Real *val, const Real *ref, const int nval, const Real floor) {
+  Real rmax = 0.0, err = 0.0;
+  for (int n=0; n<nval; ++n) rmax = std::max(rmax, std::abs(ref[n]));
+  for (int n=0; n<nval; ++n) {
+    Real scale = std::abs(ref[n]) + floor*rmax;
+    if (scale > 0.0) err = std::max(err, std::abs(val[n] - ref[n])/scale);
+    else if (val[n] != 0.0) err = std::max(err, static_cast<Real>(1.0));
+  }
+  return err;
+}
+} // namespace
@@ -32,12 +32,16 @@
 // Athena++ headers
 #include "../athena.hpp"
 #include "../athena_arrays.hpp"
+#include "../chemistry/utils/burn_scheduler.hpp"
+#include "../chemistry/utils/perf_counters.hpp"
 #include "../coordinates/coordinates.hpp"
 #include "../eos/eos.hpp"
 #include "../field/field.hpp"
 #include "../globals.hpp"
 #include "../hydro/hydro.hpp"
 #include "../mesh/mesh.hpp"
+#include "../outputs/abundance_output.hpp"
+#include "../outputs/tracer_particles.hpp"
 #include "../parameter_input.hpp"
 #include "../scalars/scalars.hpp"
 
@@ -47,9 +51,113 @@
 //======================================================================================
 
 Real ReactionTimeStep(MeshBlock *pmb);
+Real NuclearHistory(MeshBlock *pmb, int iout);
+
+namespace {
+// isotope mass numbers, used to turn network abundances into mass fractions
+const Real Aiso[NSCALARS] =
+{4.0, 12.0, 16.0, 20.0, 24.0, 28.0, 32.0, 36.0, 40.0, 44.0, 48.0, 52.0, 56.0};
+// order of the nuclear history outputs after the NSCALARS species masses
+enum {IHST_ENUC=NSCALARS, IHST_EDOT, IHST_MBURN, IHST_TMAX, IHST_TNAN, NHST_NUC};
+Real eb_init;     // binding energy of the initial composition [erg/g]
+Real xfuel_init;  // initial mass fraction of the fuel isotope
+AbundanceOutput *pabun = nullptr;  // compressed abundance dumps, if <abundance_output>
+TracerParticles *ptrc = nullptr;   // burn histories of tracers, if <tracer_particles>
+BurnScheduler *psched = nullptr;   // coupled burn, if <chemistry> burn = coupled
+} // namespace
 
 void Mesh::InitUserMeshData(ParameterInput *pin) {
   EnrollUserTimeStepFunction(ReactionTimeStep);
+#ifdef INCLUDE_CHEMISTRY
+  //in-situ reductions of the burn, so that integrated quantities keep the hst time
+  //resolution without full dumps:
+  //  M_<species>  total mass of each species
+  //  Enuc         nuclear energy released since t=0 [erg], from the change in binding
+  //               energy
+  //  Edot_nuc     nuclear energy generation rate [erg/s], from the q-weighted rates of
+  //               change
+  //  Mburn        burned mass of fuel; Mburn/mass is the burned-mass fraction
+  //  Tmax         peak temperature [K] of the cells with a temperature
+  //  Tnan         cells whose temperature inversion did not converge; they are left
+  //               out of Edot_nuc and Tmax
+  AllocateUserHistoryOutput(NHST_NUC);
+  for (int ispec=0; ispec < NSCALARS; ++ispec) {
+    std::string name = "M_" + ChemNetwork::species_names[ispec];
+    EnrollUserHistoryOutput(ispec, NuclearHistory, name.c_str());
+  }
+  EnrollUserHistoryOutput(IHST_ENUC, NuclearHistory, "Enuc[erg]");
+  EnrollUserHistoryOutput(IHST_EDOT, NuclearHistory, "Edot_nuc[erg/s]");
+  EnrollUserHistoryOutput(IHST_MBURN, NuclearHistory, "Mburn");
+  EnrollUserHistoryOutput(IHST_TMAX, NuclearHistory, "Tmax[K]",
+                          UserHistoryOperation::max);
+  EnrollUserHistoryOutput(IHST_TNAN, NuclearHistory, "Tnan");
+  if (pin->GetOrAddString("chemistry", "burn", "split") == "coupled") {
+    psched = new BurnScheduler(this, pin);
+  }
+  if (pin->DoesBlockExist("abundance_output")) {
+    pabun = new AbundanceOutput(this, pin);
+  }
+  if (pin->DoesBlockExist("tracer_particles")) {
+    ptrc = new TracerParticles(this, pin);
+  }
+#endif
+}
+
+//======================================================================================
+//! \fn void Mesh::UserWorkInLoop()
+//  \brief with burn = coupled, self-heating burn of every cell over the step; then
+//  compressed abundance dumps and tracer particles of the burned state
+//======================================================================================
+
+void Mesh::UserWorkInLoop() {
+  if (psched != nullptr) psched->Burn(dt);
+  if (pabun != nullptr) pabun->MakeOutput(this);
+  if (ptrc != nullptr) ptrc->Update(this);
+  return;
+}
+
+void Mesh::UserWorkAfterLoop(ParameterInput *pin) {
+  if (psched != nullptr) {
+    delete psched;
+    psched = nullptr;
+  }
+  if (pabun != nullptr) {
+    pabun->MakeOutput(this, true);
+    delete pabun;
+    pabun = nullptr;
+  }
+  if (ptrc != nullptr) {
+    ptrc->Finalize(this);
+    delete ptrc;
+    ptrc = nullptr;
+  }
+#ifdef INCLUDE_CHEMISTRY
+  //cycles and cache misses of the chemistry kernels, with -perf_counters
+  PerfReport(std::cout);
+#endif
+  return;
+}
+
+//======================================================================================
+//! \fn void MeshBlock::InitUserMeshBlockData(ParameterInput *pin)
+//  \brief reference state of the nuclear history outputs; set here rather than in the
+//  problem generator so that it is also available after a restart
+//======================================================================================
+
+void MeshBlock::InitUserMeshBlockData(ParameterInput *pin) {
+#ifdef INCLUDE_CHEMISTRY
+  const Real s_init = pin->GetOrAddReal("problem", "s_init", 0.);
+  Real y0[NSCALARS];
+  for (int ispec=0; ispec < NSCALARS; ++ispec) {
+    Real s_ispec = pin->GetOrAddReal("problem",
+        "s_init_"+pscalars->chemnet.species_names[ispec], -1);
+    y0[ispec] = (s_ispec >= 0.) ? s_ispec : s_init;
+  }
+  int ifuel = pscalars->chemnet.FuelIndex();
+  eb_init = pscalars->chemnet.BindingEnergy(y0);
+  xfuel_init = Aiso[ifuel]*y0[ifuel];
+#endif
+  return;
 }
 
 void MeshBlock::ProblemGenerator(ParameterInput *pin) {
@@ -80,21 +188,21 @@ void MeshBlock::ProblemGenerator(ParameterInput *pin) {
     }
   }
 
-  //intialize isotopic abundances
+  //intialize isotopic abundances, one unit-stride sweep per species
   if (NSCALARS > 0) {
-    for (int k=ks; k<=ke; ++k) {
-      for (int j=js; j<=je; ++j) {
-        for (int i=is; i<=ie; ++i) {
-          for (int ispec=0; ispec < NSCALARS; ++ispec) {
-            pscalars->s(ispec, k, j, i) = s_init*rho;
+    for (int ispec=0; ispec < NSCALARS; ++ispec) {
+      Real s_ispec = s_init;
 #ifdef INCLUDE_CHEMISTRY
-            Real s_ispec = pin->GetOrAddReal("problem",
-                "s_init_"+pscalars->chemnet.species_names[ispec], -1);
-            // Real s_ispec = 1.;
-            if (s_ispec >= 0.) {
-              pscalars->s(ispec, k, j, i) = s_ispec*rho;
-            }
+      Real s_in = pin->GetOrAddReal("problem",
+          "s_init_"+pscalars->chemnet.species_names[ispec], -1);
+      if (s_in >= 0.) {
+        s_ispec = s_in;
+      }
 #endif
+      for (int k=ks; k<=ke; ++k) {
+        for (int j=js; j<=je; ++j) {
+          for (int i=is; i<=ie; ++i) {
+            pscalars->s(ispec, k, j, i) = s_ispec*rho;
           }
         }
       }
@@ -104,6 +212,66 @@ void MeshBlock::ProblemGenerator(ParameterInput *pin) {
   return;
 }
 
+//======================================================================================
+//! \fn Real NuclearHistory(MeshBlock *pmb, int iout)
+//  \brief volume integrals (or maximum) of the burn diagnostics over a MeshBlock
+//======================================================================================
+
+Real NuclearHistory(MeshBlock *pmb, int iout) {
+  Real sum = 0.0;
+#ifdef INCLUDE_CHEMISTRY
+  ChemNetwork &chemnet = pmb->pscalars->chemnet;
+  const Real gm1 = pmb->peos->GetGamma() - 1.0;
+  const int ifuel = chemnet.FuelIndex();
+  //cell volumes in cm3, for the masses in g of the energy outputs
+  const Real cm3 = chemnet.LengthUnit()*chemnet.LengthUnit()*chemnet.LengthUnit();
+  Real y[NSCALARS];
+  for (int k=pmb->ks; k<=pmb->ke; ++k) {
+    for (int j=pmb->js; j<=pmb->je; ++j) {
+      for (int i=pmb->is; i<=pmb->ie; ++i) {
+        //code units for the mass outputs, g/cm3 for the network and the energies
+        const Real rho = pmb->phydro->w(IDN, k, j, i);
+        const Real rho_cgs = chemnet.CellDensity(k, j, i);
+        const Real vol = pmb->pcoord->GetCellVolume(k, j, i);
+        //internal energy density, as passed to the network
+        Real ED;
+        if (NON_BAROTROPIC_EOS) {
+          ED = pmb->phydro->w(IPR, k, j, i)/gm1;
+        } else {
+          ED = rho*SQR(pmb->peos->GetIsoSoundSpeed())/gm1;
+        }
+        if (iout < NSCALARS) {
+          sum += vol*Aiso[iout]*pmb->pscalars->s(iout, k, j, i);
+        } else if (iout == IHST_ENUC) {
+          for (int ispec=0; ispec < NSCALARS; ++ispec) {
+            y[ispec] = pmb->pscalars->s(ispec, k, j, i)/rho;
+          }
+          sum += vol*cm3*rho_cgs*(chemnet.BindingEnergy(y) - eb_init);
+        } else if (iout == IHST_MBURN) {
+          sum += vol*(rho*xfuel_init - Aiso[ifuel]*pmb->pscalars->s(ifuel, k, j, i));
+        } else {
+          for (int ispec=0; ispec < NSCALARS; ++ispec) {
+            y[ispec] = pmb->pscalars->s(ispec, k, j, i)/rho;
+          }
+          //NaN where the tabulated EOS did not converge, counted by Tnan
+          const Real temp = chemnet.Temperature(rho_cgs, ED, y);
+          if (iout == IHST_TNAN) {
+            if (temp != temp) sum += 1.0;
+          } else if (temp == temp) {
+            if (iout == IHST_EDOT) {
+              sum += vol*cm3*rho_cgs*chemnet.EnergyGenerationRate(rho_cgs, temp, y);
+            } else {
+              sum = std::max(sum, temp);
+            }
+          }
+        }
+      }
+    }
+  }
+#endif
+  return sum;
+}
+
 Real ReactionTimeStep(MeshBlock *pmb) {
     Real min_dt=FLT_MAX;
   for (int k=pmb->ks; k<=pmb->ke; ++k) {
@@ -0,0 +1,851 @@
+//======================================================================================
+// Athena++ astrophysical MHD code
+// Copyright (C) 2014 James M. Stone  <jmstone@princeton.edu>
+//
+// This program is free software: you can redistribute and/or modify it under the terms
+// of the GNU General Public License (GPL) as published by the Free Software Foundation,
+// either version 3 of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+// PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+//
+// You should have received a copy of GNU GPL in the file LICENSE included in the code
+// distribution.  If not see <http://www.gnu.org/licenses/>.
+//======================================================================================
+//! \file nucnet.cpp
+//  \brief implementation of functions in class ChemNetwork, using a general nuclear
+//  network read from a network file
+//======================================================================================
+
+// this class header
+#include "nucnet.hpp"
+
+//athena++ header
+#include "network.hpp"
+#include "../../scalars/scalars.hpp"
+#include "../../parameter_input.hpp"       //ParameterInput
+#include "../../mesh/mesh.hpp"
+#include "../../hydro/hydro.hpp"
+#include "../../defs.hpp"
+#include "../../eos/eos.hpp"
+#include "../utils/burn_integrator.hpp"
+#include "../utils/dual_number.hpp"
+#include "../utils/perf_counters.hpp"
+
+//c++ header
+#include <sstream>    // stringstream
+#include <iostream>   // endl
+#include <fstream>   //file()
+#include <algorithm>    // std::find()
+#include <cmath>       //exp, log, pow
+#include <stdexcept>   // std::runtime_error()
+#include <vector>      // vector container
+
+std::string ChemNetwork::species_names[NSCALARS];
+Real ChemNetwork::Aiso[NSCALARS];
+constexpr Real ChemNetwork::nucnet_Tcold;
+
+static const int MAXR = ChemNetwork::MAXR;
+static const int NREAC_MAX = ChemNetwork::NREAC_MAX;
+static const int NSET_MAX = ChemNetwork::NSET_MAX;
+static const int NSLOT = 2 * MAXR; /* reactant and product slots of a reaction */
+static_assert(MAXR == 3, "the rate kernels are written out for three slots");
+static const int NEQN = NSCALARS + 1;
+/* MeV per nucleon to erg/g */
+static const Real conv_factor = 9.64867e17;
+
+/* Network, the same for all MeshBlocks and read by the first. Species NSCALARS
+   is a placeholder of abundance one that pads reactions to MAXR reactants and
+   products. */
+static int nreac = 0;
+/* Species data: binding energy (MeV), partition function coefficients, charge */
+static Real q[NSCALARS];
+static Real g0[NSCALARS];
+static Real apf[NSCALARS];
+static Real bpf[NSCALARS];
+static Real cpf[NSCALARS];
+static Real zcharge[NSCALARS];
+/* Screening: coefficient per distinct charge of a species or compound nucleus; the
+   last charge is the placeholder, never screened */
+static std::vector<Real> gscr;
+static std::vector<int> ichg;          /* charge of species, NSCALARS+1 */
+/* Reactions, MAXR entries each */
+static std::vector<int> ireac;         /* reactants */
+static std::vector<int> iprod;         /* products */
+static std::vector<int> icomp;         /* charge of the compound nucleus */
+static std::vector<int> nreactant;
+static std::vector<Real> rfac;         /* constant factor of the forward rate */
+static std::vector<int> set_ptr;       /* rate fit sets of reaction r (CSR) */
+static std::vector<Real> calp;         /* 7 fit coefficients per set */
+static std::vector<int> reversible;
+static std::vector<Real> ca;           /* log of the reverse constant */
+static std::vector<Real> cb;           /* -Q (MeV) */
+static std::vector<Real> csr;          /* sign of the screening of the reverse */
+static std::vector<int> dnr;           /* reactants - products */
+/* Stoichiometric matrix S, CSR by species: f[i] = sum s_val r[s_col] */
+static std::vector<int> s_ptr, s_col;
+static std::vector<Real> s_val;
+/* Jacobian sparsity df[i]/dy[j], CSR by i, and the slot derivatives that add up
+   to each nonzero: jv[n] = sum c_val dslot[c_slot] */
+static std::vector<int> j_ptr, j_col;
+static std::vector<int> c_ptr, c_slot;
+static std::vector<Real> c_val;
+
+ChemNetwork::ChemNetwork(MeshBlock *pmb, ParameterInput *pin) {
+  //pmb is nullptr for a network outside the mesh, which only burns along given
+  //histories (see tracer_burn.hpp)
+  pmy_spec_ = (pmb != nullptr) ? pmb->pscalars : nullptr;
+  pmy_mb_ = pmb;
+
+  //set the parameters from input file
+  NISOfuel = pin->GetOrAddInteger("chemistry", "NISOfuel", 1);
+  /* Exact df(i)/de from dual-number rates; nucnet_dualder = false takes the
+     numerical derivative at the energy increment nucnet_epsder*e */
+  nucnet_dualder = pin->GetOrAddBoolean("chemistry","nucnet_dualder",true);
+  nucnet_epsder = pin->GetOrAddReal("chemistry","nucnet_epsder",1.e-8);
+  //units
+  unit_density = pin->GetOrAddReal("chemistry", "unit_density",1.);
+  unit_length_in_cm_ = pin->GetOrAddReal("chemistry", "unit_length_in_cm", 1.);
+  unit_vel_in_cms_ = pin->GetOrAddReal("chemistry", "unit_vel_in_cms",1.);
+  unit_time_in_s_ = unit_length_in_cm_/unit_vel_in_cms_;
+  unit_E_in_cgs_ = unit_density * unit_vel_in_cms_ * unit_vel_in_cms_;
+
+  //the network is the same for every MeshBlock; the first one reads it
+  if (nreac == 0) {
+    ReadNetwork(pin->GetString("chemistry", "network_data_file"));
+  }
+
+  //equation of state used to get the temperature inside the burn, after the
+  //network for the mass numbers
+  eos_.Init(pin, unit_E_in_cgs_, Aiso[NSCALARS-1]);
+  if (eos_.IsTable() && pmb != nullptr) {
+    temp_cache_.NewAthenaArray(pmb->ncells3, pmb->ncells2, pmb->ncells1);
+  }
+  temp_guess_ = 0.0;
+  kcell_ = jcell_ = icell_ = 0;
+
+  //operator split (abundances at fixed energy) or coupled burn
+  std::string burn = pin->GetOrAddString("chemistry", "burn", "split");
+  pburn = nullptr;
+  if (burn == "coupled") {
+    if (!NON_BAROTROPIC_EOS) {
+      std::stringstream msg;
+      msg << "### FATAL ERROR in ChemNetwork constructor" << std::endl
+          << "<chemistry> burn = coupled needs an energy equation" << std::endl;
+      throw std::runtime_error(msg.str().c_str());
+    }
+    if (pmb != nullptr) pburn = new BurnIntegrator(this, pmb, pin);
+  } else if (burn != "split") {
+    std::stringstream msg;
+    msg << "### FATAL ERROR in ChemNetwork constructor" << std::endl
+        << "<chemistry> burn = " << burn << " unknown, use split or coupled" << std::endl;
+    throw std::runtime_error(msg.str().c_str());
+  }
+}
+
+ChemNetwork::~ChemNetwork() {
+  if (pburn != nullptr) delete pburn;
+  if (eos_.IsTable()) temp_cache_.DeleteAthenaArray();
+}
+
+void ChemNetwork::InitializeNextStep(const int k, const int j, const int i) {
+  if (pburn != nullptr && !BurnIntegrator::driven) {
+    //RHS and Edot are zero in coupled mode, so nothing would ever burn
+    std::stringstream msg;
+    msg << "### FATAL ERROR in ChemNetwork::InitializeNextStep" << std::endl
+        << "<chemistry> burn = coupled, but the problem generator does not drive the "
+        << "coupled burn with a BurnScheduler" << std::endl;
+    throw std::runtime_error(msg.str().c_str());
+  }
+  rho_ = CellDensity(k, j, i);
+  kcell_ = k;
+  jcell_ = j;
+  icell_ = i;
+  temp_guess_ = eos_.IsTable() ? temp_cache_(k, j, i) : 0.0;
+  return;
+}
+
+Real ChemNetwork::CellDensity(const int k, const int j, const int i) const {
+  Real rho = pmy_mb_->phydro->w(IDN, k, j, i);
+  Real rho_floor = pmy_mb_->peos->GetDensityFloor();
+  rho = (rho > rho_floor) ?  rho : rho_floor;
+  //density in proper units
+  return rho * unit_density;
+}
+
+void ChemNetwork::ReadNetwork(const std::string fname) {
+  const Real five_thirds = 5.0 / 3.0;
+  const Real conv_rev = 9.867425e9;
+
+  std::ifstream net_file(fname.c_str());
+  if (!net_file) {
+    std::stringstream msg;
+    msg << "### FATAL ERROR in ChemNetwork::ReadNetwork" << std::endl
+        << "Unable to open " << fname << std::endl;
+    throw std::runtime_error(msg.str().c_str());
+  }
+
+  int nspec = 0;
+  std::vector<Real> rev_const;  /* C of each reaction, 0 for the default */
+  std::string line;
+  int nline = 0;
+  set_ptr.assign(1, 0);
+  while (std::getline(net_file, line)) {
+    nline++;
+    line = line.substr(0, line.find('#'));
+    std::istringstream iss(line);
+    std::vector<std::string> tok;
+    std::string word;
+    while (iss >> word) tok.push_back(word);
+    if (tok.empty()) continue;
+
+    std::stringstream msg;
+    msg << "### FATAL ERROR in ChemNetwork::ReadNetwork" << std::endl
+        << fname << ", line " << nline << ": ";
+    if (tok[0] == "species") {
+      if (tok.size() != 9 || nreac > 0 || nspec >= NSCALARS) {
+        msg << "expected species <name> <A> <Z> <q> <g0> <apf> <bpf> <cpf>, before "
+            << "the reactions and at most NSCALARS = " << NSCALARS << std::endl;
+        throw std::runtime_error(msg.str().c_str());
+      }
+      species_names[nspec] = tok[1];
+      Aiso[nspec] = std::stod(tok[2]);
+      zcharge[nspec] = std::stod(tok[3]);
+      q[nspec] = std::stod(tok[4]);
+      g0[nspec] = std::stod(tok[5]);
+      apf[nspec] = std::stod(tok[6]);
+      bpf[nspec] = std::stod(tok[7]);
+      cpf[nspec] = std::stod(tok[8]);
+      nspec++;
+    } else if (tok[0] == "reaction") {
+      if (nspec != NSCALARS) {
+        msg << nspec << " species, but the code is configured with --nscalars="
+            << NSCALARS << std::endl;
+        throw std::runtime_error(msg.str().c_str());
+      }
+      if (nreac > 0 && set_ptr[nreac] == set_ptr[nreac-1]) {
+        msg << "the previous reaction has no rate" << std::endl;
+        throw std::runtime_error(msg.str().c_str());
+      }
+      if (nreac >= NREAC_MAX) {
+        msg << "more than NREAC_MAX = " << NREAC_MAX << " reactions" << std::endl;
+        throw std::runtime_error(msg.str().c_str());
+      }
+      int nr = 0, np = 0;
+      bool arrow = false;
+      ireac.resize((nreac+1)*MAXR, NSCALARS);
+      iprod.resize((nreac+1)*MAXR, NSCALARS);
+      for (size_t n=1; n<tok.size(); ++n) {
+        if (tok[n] == "->") {
+          arrow = true;
+          continue;
+        }
+        const std::string *it = std::find(species_names, species_names + NSCALARS,
+                                          tok[n]);
+        if (it == species_names + NSCALARS) {
+          msg << "unknown species " << tok[n] << std::endl;
+          throw std::runtime_error(msg.str().c_str());
+        }
+        const int ispec = static_cast<int>(it - species_names);
+        if ((arrow && np == MAXR) || (!arrow && nr == MAXR)) {
+          msg << "more than MAXR = " << MAXR << " reactants or products" << std::endl;
+          throw std::runtime_error(msg.str().c_str());
+        }
+        if (arrow) {
+          iprod[nreac*MAXR + np++] = ispec;
+        } else {
+          ireac[nreac*MAXR + nr++] = ispec;
+        }
+      }
+      Real da = 0.0, dz = 0.0;
+      for (int m = 0; m < MAXR; ++m) {
+        if (ireac[nreac*MAXR + m] < NSCALARS) {
+          da += Aiso[ireac[nreac*MAXR + m]];
+          dz += zcharge[ireac[nreac*MAXR + m]];
+        }
+        if (iprod[nreac*MAXR + m] < NSCALARS) {
+          da -= Aiso[iprod[nreac*MAXR + m]];
+          dz -= zcharge[iprod[nreac*MAXR + m]];
+        }
+      }
+      if (nr == 0 || np == 0 || da != 0.0 || dz != 0.0) {
+        msg << "expected reaction <reactants> -> <products>, conserving A and Z"
+            << std::endl;
+        throw std::runtime_error(msg.str().c_str());
+      }
+      nreactant.push_back(nr);
+      dnr.push_back(nr - np);
+      rfac.push_back(1.0);
+      reversible.push_back(0);
+      csr.push_back(0.0);
+      rev_const.push_back(0.0);
+      set_ptr.push_back(set_ptr[nreac]);
+      nreac++;
+    } else if (nreac == 0) {
+      msg << tok[0] << " before the first reaction" << std::endl;
+      throw std::runtime_error(msg.str().c_str());
+    } else if (tok[0] == "factor" && tok.size() == 2) {
+      rfac[nreac-1] = std::stod(tok[1]);
+    } else if (tok[0] == "reverse" && (tok.size() == 2 || tok.size() == 3)) {
+      reversible[nreac-1] = 1;
+      csr[nreac-1] = std::stod(tok[1]);
+      if (tok.size() == 3) rev_const[nreac-1] = std::stod(tok[2]);
+    } else if (tok[0] == "rate" && tok.size() == 8) {
+      if (set_ptr[nreac] >= NSET_MAX) {
+        msg << "more than NSET_MAX = " << NSET_MAX << " rate sets" << std::endl;
+        throw std::runtime_error(msg.str().c_str());
+      }
+      for (int l = 0; l < 7; ++l) {
+        calp.push_back(std::stod(tok[l+1]));
+      }
+      set_ptr[nreac]++;
+    } else {
+      msg << "expected species, reaction, factor, reverse or rate" << std::endl;
+      throw std::runtime_error(msg.str().c_str());
+    }
+  }
+  net_file.close();
+  if (nreac == 0 || set_ptr[nreac] == set_ptr[nreac-1]) {
+    std::stringstream msg;
+    msg << "### FATAL ERROR in ChemNetwork::ReadNetwork" << std::endl
+        << fname << ": no reactions, or the last one has no rate" << std::endl;
+    throw std::runtime_error(msg.str().c_str());
+  }
+
+  /* Identical reactants: 1/m! in the fits. Reverse rates: -Q and the constant. */
+  ca.assign(nreac, 0.0);
+  cb.assign(nreac, 0.0);
+  for (int r = 0; r < nreac; ++r) {
+    Real lnsym = 0.0;
+    Real areac = 1.0, aprod = 1.0;
+    for (int m = 0; m < MAXR; ++m) {
+      const int i = ireac[r*MAXR + m];
+      if (i < NSCALARS) {
+        int mult = 0;
+        for (int l = 0; l <= m; ++l) {
+          if (ireac[r*MAXR + l] == i) mult++;
+        }
+        lnsym += log(static_cast<Real>(mult));
+        areac *= Aiso[i];
+        cb[r] += q[i];
+      }
+      const int k = iprod[r*MAXR + m];
+      if (k < NSCALARS) {
+        aprod *= Aiso[k];
+        cb[r] -= q[k];
+      }
+    }
+    if (lnsym != 0.0) {
+      for (int s = set_ptr[r]; s < set_ptr[r+1]; ++s) {
+        calp[7*s] -= lnsym;
+      }
+    }
+    if (reversible[r]) {
+      ca[r] = (rev_const[r] > 0.0) ? log(rev_const[r])
+            : log(pow(conv_rev, dnr[r]) * pow(areac / aprod, 1.5));
+    }
+  }
+
+  /* Screening charges: those of the species, of the compound nuclei, and the
+     placeholder */
+  std::vector<Real> zlist;
+  ichg.assign(NSCALARS + 1, 0);
+  icomp.assign(nreac, 0);
+  for (int i = 0; i <= NSCALARS + nreac; ++i) {
+    Real z = 0.0;
+    if (i < NSCALARS) {
+      z = zcharge[i];
+    } else if (i < NSCALARS + nreac) {
+      for (int m = 0; m < MAXR; ++m) {
+        const int l = ireac[(i-NSCALARS)*MAXR + m];
+        if (l < NSCALARS) z += zcharge[l];
+      }
+    }
+    int c = static_cast<int>(std::find(zlist.begin(), zlist.end(), z) - zlist.begin());
+    if (c == static_cast<int>(zlist.size())) zlist.push_back(z);
+    if (i < NSCALARS) ichg[i] = c;
+    else if (i < NSCALARS + nreac) icomp[i-NSCALARS] = c;
+  }
+  /* the placeholder gets a charge of its own, after all others */
+  zlist.push_back(0.0);
+  ichg[NSCALARS] = static_cast<int>(zlist.size()) - 1;
+  gscr.resize(zlist.size());
+  for (size_t c = 0; c < zlist.size(); ++c) {
+    gscr[c] = 0.2275e-3 * pow(zlist[c], five_thirds);
+  }
+
+  /* Stoichiometric matrix, net change of species i in reaction r */
+  std::vector<int> nu(NSCALARS * nreac, 0);
+  for (int r = 0; r < nreac; ++r) {
+    for (int m = 0; m < MAXR; ++m) {
+      if (ireac[r*MAXR + m] < NSCALARS) nu[ireac[r*MAXR + m]*nreac + r]--;
+      if (iprod[r*MAXR + m] < NSCALARS) nu[iprod[r*MAXR + m]*nreac + r]++;
+    }
+  }
+  s_ptr.assign(1, 0);
+  s_col.clear();
+  s_val.clear();
+  for (int i = 0; i < NSCALARS; ++i) {
+    for (int r = 0; r < nreac; ++r) {
+      if (nu[i*nreac + r] != 0) {
+        s_col.push_back(r);
+        s_val.push_back(nu[i*nreac + r]);
+      }
+    }
+    s_ptr.push_back(static_cast<int>(s_col.size()));
+  }
+
+  /* Jacobian: df[i]/dy[j] is nonzero if j takes part in a reaction that changes i;
+     each such reaction adds nu times the derivative of its flux in the slots of j */
+  j_ptr.assign(1, 0);
+  j_col.clear();
+  c_ptr.assign(1, 0);
+  c_slot.clear();
+  c_val.clear();
+  for (int i = 0; i < NSCALARS; ++i) {
+    for (int j = 0; j < NSCALARS; ++j) {
+      const size_t c0 = c_slot.size();
+      for (int p = s_ptr[i]; p < s_ptr[i+1]; ++p) {
+        const int r = s_col[p];
+        for (int m = 0; m < NSLOT; ++m) {
+          const int l = (m < MAXR) ? ireac[r*MAXR + m] : iprod[r*MAXR + m - MAXR];
+          if (l == j) {
+            c_slot.push_back(r*NSLOT + m);
+            c_val.push_back(s_val[p]);
+          }
+        }
+      }
+      if (c_slot.size() > c0) {
+        j_col.push_back(j);
+        c_ptr.push_back(static_cast<int>(c_slot.size()));
+      }
+    }
+    j_ptr.push_back(static_cast<int>(j_col.size()));
+  }
+  return;
+}
+
+template <typename T>
+void ChemNetwork::CalculateRates(const T rho, const T tp, T frv[], T rev[]) {
+  PERF_SCOPE(PERF_RATES, ((sizeof(T) == sizeof(Real)) ? 1.0 : 3.0)
+             * (13.0*set_ptr[nreac] + 24.0*nreac + 10.0*gscr.size() + 5.0*NSCALARS),
+             set_ptr[nreac] + 2.0*nreac + 2.0*gscr.size() + NSCALARS + 3.0);
+  /* Parameters for screening corrections, as in alpha13 */
+  const Real a1 = -0.897744;
+  const Real a2 =  4.0 * 0.95043;
+  const Real a3 = -4.0 * 0.18956;
+  const Real a4 = -0.81487;
+  const Real a5 = -2.58020;
+  const Real a6 = -0.57735;
+  const Real a8 =  2.0160;
+  const Real a7 =  0.29341 / a8;
+
+  const Real one_third   = 1.0 /  3.0;
+  const Real two_thirds  = 2.0 /  3.0;
+
+  /* the network arrays as locals, so that the stores to frv and rev cannot alias them */
+  const int nchg = static_cast<int>(gscr.size());
+  const int *ir = ireac.data();
+  const int *ip = iprod.data();
+  const int *nr = nreactant.data();
+  const int *sp = set_ptr.data();
+  const int *ic = ichg.data();
+  const int *icmp = icomp.data();
+  const int *dn = dnr.data();
+  const int *isrev = reversible.data();
+  const Real *cal = calp.data();
+  const Real *fac = rfac.data();
+  const Real *lnc = ca.data();
+  const Real *mq = cb.data();
+  const Real *sgn = csr.data();
+  T t9, t9i, t9l, t923, t9r, g1, gam, gam4;
+  T pf[NSCALARS+1];              /* Partition functions */
+  T pf0_inv;
+  T fscr[NSCALARS+NREAC_MAX+1];  /* Screening factors, per charge */
+  T falp[NSET_MAX];              /* Rate fits, per set */
+
+  /* Calculation of forward rates */
+  t9   = fmax(0.01, 1.e-9 * tp);
+  t9i  = 1.0 / t9;
+  t9l  = log(t9);
+  t923 = pow(t9, two_thirds);
+  const T rhon[MAXR] = {1.0, rho, rho * rho};  /* rho^(n-1) */
+  const int nset = sp[nreac];
+#pragma omp simd
+  for (int s = 0; s < nset; ++s) {
+    const Real *c = &cal[7*s];
+    falp[s] = c[0] + t9i * (c[1] + t923 * (c[2] + t923 * (c[3] + t923 * (c[4] +
+              t923 * c[5])))) + t9l * c[6];
+  }
+  for (int s = 0; s < nset; ++s) {
+    falp[s] = exp(falp[s]);
+  }
+  for (int r = 0; r < nreac; ++r) {
+    T sum = 0.0;
+    for (int s = sp[r]; s < sp[r+1]; ++s) {
+      sum += falp[s];
+    }
+    frv[r] = fac[r] * rhon[nr[r]-1] * sum;
+  }
+
+  t9  = 1.e-9 * tp;
+  t9i = 1.0 / t9;
+  t9r = 11.605 * t9i;
+
+  /* Screening corrections to the forward rates */
+  g1 = t9i * pow(0.5 * rho, one_third);
+  for (int c = 0; c < nchg - 1; ++c) {
+    gam = fmin(150.0, g1 * gscr[c]);
+    if (gam < 1.0) {
+      fscr[c] = a6 * gam * sqrt(gam) + a7 * pow(gam, a8);
+    } else {
+      gam4 = sqrt(sqrt(gam));
+      fscr[c] = a1 * gam + a2 * gam4 + a3 / gam4 + a4 * log(gam) + a5;
+    }
+  }
+  fscr[nchg-1] = 0.0;
+
+  /* Calculation of partition functions */
+  for (int i = 0; i < NSCALARS; ++i) {
+    pf[i] = g0[i] * (1.0 + exp(apf[i] * t9i + bpf[i] + t9 * cpf[i]));
+  }
+  pf[NSCALARS] = 1.0;
+  pf0_inv = t9 * sqrt(t9) / rho;
+  /* (T9^1.5/rho)^dn of the reverse rates, dn = -MAXR+1..MAXR-1 */
+  T pf0_pow[2*MAXR-1];
+  pf0_pow[MAXR-1] = 1.0;
+  for (int m = 1; m < MAXR; ++m) {
+    pf0_pow[MAXR-1+m] = pf0_pow[MAXR-2+m] * pf0_inv;
+    pf0_pow[MAXR-1-m] = pf0_pow[MAXR-m] / pf0_inv;
+  }
+
+  for (int r = 0; r < nreac; ++r) {
+    const int *irr = &ir[r*MAXR];
+    const int *ipr = &ip[r*MAXR];
+    T sreac = fscr[ic[irr[0]]] + fscr[ic[irr[1]]] + fscr[ic[irr[2]]];
+    T sprod = fscr[ic[ipr[0]]] + fscr[ic[ipr[1]]] + fscr[ic[ipr[2]]];
+    frv[r] *= exp(sreac - fscr[icmp[r]]);
+    if (!isrev[r]) {
+      rev[r] = 0.0;
+      continue;
+    }
+    /* Reverse rate coefficient from detailed balance */
+    rev[r] = exp(lnc[r] + mq[r] * t9r + sgn[r] * (sprod - sreac))
+           * pf[irr[0]] * pf[irr[1]] * pf[irr[2]]
+           / (pf[ipr[0]] * pf[ipr[1]] * pf[ipr[2]]) * pf0_pow[MAXR-1+dn[r]];
+  }
+}
+
+template <typename T>
+void ChemNetwork::RatesOfChange(const T frv[], const T rev[], const Real y[NSCALARS],
+                                T f[]) {
+  const int *ir = ireac.data();
+  const int *ip = iprod.data();
+  const int *sp = s_ptr.data();
+  const int *sc = s_col.data();
+  const Real *sv = s_val.data();
+  Real yext[NSCALARS+1];
+  T r[NREAC_MAX];  /* Reaction fluxes */
+  for (int i = 0; i < NSCALARS; ++i) {
+    yext[i] = y[i];
+  }
+  yext[NSCALARS] = 1.0;
+
+#pragma omp simd
+  for (int k = 0; k < nreac; ++k) {
+    r[k] = frv[k] * (yext[ir[k*MAXR]] * yext[ir[k*MAXR+1]] * yext[ir[k*MAXR+2]]
+                     - rev[k] * yext[ip[k*MAXR]] * yext[ip[k*MAXR+1]]
+                       * yext[ip[k*MAXR+2]]);
+  }
+  for (int i = 0; i < NSCALARS; ++i) {
+    T fi = 0.0;
+    for (int p = sp[i]; p < sp[i+1]; ++p) {
+      fi += sv[p] * r[sc[p]];
+    }
+    f[i] = fi;
+  }
+}
+
+void ChemNetwork::PartialDerivatives(const Real frv[], const Real rev[],
+                                     const Real y[NSCALARS], Real f[NEQN],
+                                     Real df[NEQN][NEQN]) {
+  Real yext[NSCALARS+1];
+  Real dslot[NREAC_MAX*NSLOT];  /* flux derivatives wrt the species in each slot */
+  Real jv[NSCALARS*NSCALARS];   /* Jacobian nonzeros */
+  for (int i = 0; i < NSCALARS; ++i) {
+    yext[i] = y[i];
+  }
+  yext[NSCALARS] = 1.0;
+
+  RatesOfChange(frv, rev, y, f);
+
+  /* d(prod y_slots)/dy_slot m is the product over the other slots */
+  const int *ir = ireac.data();
+  const int *ip = iprod.data();
+#pragma omp simd
+  for (int k = 0; k < nreac; ++k) {
+    const Real y0 = yext[ir[k*MAXR]], y1 = yext[ir[k*MAXR+1]], y2 = yext[ir[k*MAXR+2]];
+    const Real w0 = yext[ip[k*MAXR]], w1 = yext[ip[k*MAXR+1]], w2 = yext[ip[k*MAXR+2]];
+    const Real fw = frv[k];
+    const Real bw = -frv[k] * rev[k];
+    dslot[k*NSLOT    ] = fw * y1 * y2;
+    dslot[k*NSLOT + 1] = fw * y0 * y2;
+    dslot[k*NSLOT + 2] = fw * y0 * y1;
+    dslot[k*NSLOT + 3] = bw * w1 * w2;
+    dslot[k*NSLOT + 4] = bw * w0 * w2;
+    dslot[k*NSLOT + 5] = bw * w0 * w1;
+  }
+  const int *cp = c_ptr.data();
+  const int *cs = c_slot.data();
+  const Real *cv = c_val.data();
+  const int nnz = j_ptr[NSCALARS];
+  for (int n = 0; n < nnz; ++n) {
+    Real v = 0.0;
+    for (int c = cp[n]; c < cp[n+1]; ++c) {
+      v += cv[c] * dslot[cs[c]];
+    }
+    jv[n] = v;
+  }
+
+  for (int j = 0; j < NEQN; ++j) {
+    for (int k = 0; k < NEQN; ++k) {
+      df[j][k] = 0.0;
+    }
+  }
+  for (int i = 0; i < NSCALARS; ++i) {
+    for (int n = j_ptr[i]; n < j_ptr[i+1]; ++n) {
+      df[j_col[n]][i] = jv[n];
+    }
+  }
+
+  Real edot = 0.0;
+  for (int k = 0; k < NSCALARS; ++k) {
+    edot += q[k] * f[k];
+  }
+  f[NEQN-1] = conv_factor * edot;
+  for (int j = 0; j < NSCALARS; ++j) {
+    edot = 0.0;
+    for (int k = 0; k < NSCALARS; ++k) {
+      edot += q[k] * df[j][k];
+    }
+    df[j][NEQN-1] = conv_factor * edot;
+  }
+}
+
+Real ChemNetwork::BindingEnergy(const Real y[NSCALARS]) {
+  Real eb = 0.0;
+  for (int k = 0; k < NSCALARS; ++k) {
+    eb += q[k] * y[k];
+  }
+  return conv_factor * eb;
+}
+
+Real ChemNetwork::EnergyGenerationRate(const Real rho, const Real temp,
+                                       const Real y[NSCALARS]) {
+  Real frv[NREAC_MAX]; /* Forward reaction rates */
+  Real rev[NREAC_MAX]; /* Reverse reaction rates */
+  Real f[NEQN];
+  Real y_corr[NSCALARS];
+  for (int i=0; i<NSCALARS; i++) {
+    y_corr[i] = (y[i] > 0.0) ? y[i] : 0.0;
+  }
+  CalculateRates(rho, temp, frv, rev);
+  RatesOfChange(frv, rev, y_corr, f);
+  Real edot = 0.0;
+  for (int k = 0; k < NSCALARS; ++k) {
+    edot += q[k] * f[k];
+  }
+  return conv_factor * edot;
+}
+
+int ChemNetwork::RHSFull(const Real y[NEQN], Real f[NEQN], Real jac[NEQN][NEQN],
+                         Real * rdata, const bool exact) {
+  /* Besides the rates: the fluxes and S r for f; the slot derivatives, their gather
+     and the energy column for the Jacobian, and the dual-number f */
+  PERF_SCOPE((jac == nullptr) ? PERF_RHS : PERF_JACOBIAN,
+             8.0*nreac + 2.0*s_col.size() + 2.0*NSCALARS + ((jac == nullptr) ? 0.0 :
+             12.0*nreac + 2.0*c_slot.size() + 2.0*NSCALARS*NSCALARS
+             + 3.0*(8.0*nreac + 2.0*s_col.size())), 0.0);
+  const Real rho = rdata[0];
+  const Real e0 = rdata[1];
+  /* e0 = 0: the temperature rdata[2] is prescribed, as in alpha13 */
+  const bool fixed_temp = !(e0 > 0.0);
+  const Real e0_inv = fixed_temp ? 0.0 : 1.0 / e0;
+  Real frv[NREAC_MAX]; /* Forward reaction rates */
+  Real rev[NREAC_MAX]; /* Reverse reaction rates */
+  Real y_corr[NSCALARS];
+  int j, k;
+
+  for (k = 0; k < NSCALARS; ++k) {
+    y_corr[k] = (y[k] > 0.0) ? y[k] : 0.0;
+  }
+  /* Temperature of the current energy, e = y[NEQN-1]*e0 */
+  Real temp = fixed_temp ? rdata[2] :
+      Temperature(rho, rho * y[NEQN-1] * e0 / unit_E_in_cgs_, y_corr, rdata[2]);
+  rdata[2] = temp;
+  if (temp < nucnet_Tcold) {
+    for (j = 0; j < NEQN; ++j) {
+      f[j] = 0.0;
+      if (jac != nullptr) {
+        for (k = 0; k < NEQN; ++k) {
+          jac[j][k] = 0.0;
+        }
+      }
+    }
+    return 0;
+  }
+
+  if (jac == nullptr) {
+    CalculateRates(rho, temp, frv, rev);
+    RatesOfChange(frv, rev, y_corr, f);
+    Real edot = 0.0;
+    for (k = 0; k < NSCALARS; ++k) {
+      edot += q[k] * f[k];
+    }
+    f[NEQN-1] = conv_factor * edot * e0_inv;
+    return 1;
+  }
+
+  /* With the Jacobian, the rates and their derivatives along y[NEQN-1] in one
+     pass: the temperature changes with the energy as dT/dy = e0/c_v */
+  Dual frv_d[NREAC_MAX], rev_d[NREAC_MAX];
+  const bool dual = ((nucnet_dualder || exact) && !fixed_temp);
+  if (dual) {
+    CalculateRates(Dual(rho), Dual(temp, e0 / SpecificHeat(rho, temp, y_corr)),
+                   frv_d, rev_d);
+    for (k = 0; k < nreac; ++k) {
+      frv[k] = frv_d[k].v;
+      rev[k] = rev_d[k].v;
+    }
+  } else {
+    CalculateRates(rho, temp, frv, rev);
+  }
+
+  /* f and jac, except for the partial derivatives wrt energy jac[NEQN-1][:] */
+  PartialDerivatives(frv, rev, y_corr, f, jac);
+  f[NEQN-1] *= e0_inv;
+  for (k = 0; k < NEQN - 1; ++k) {
+    jac[k][NEQN-1] *= e0_inv;
+  }
+
+  Real edot = 0.0;
+  if (fixed_temp) {
+    for (k = 0; k < NEQN; ++k) {
+      jac[NEQN-1][k] = 0.0;
+      jac[k][NEQN-1] = 0.0;
+    }
+  } else if (dual) {
+    Dual f_d[NEQN];
+    RatesOfChange(frv_d, rev_d, y_corr, f_d);
+    for (k = 0; k < NSCALARS; ++k) {
+      jac[NEQN-1][k] = f_d[k].d;
+      edot += q[k] * f_d[k].d;
+    }
+    jac[NEQN-1][NEQN-1] = conv_factor * edot * e0_inv;
+  } else {
+    /* last row numerically, at the perturbed energy */
+    Real fn[NEQN];
+    Real de = nucnet_epsder * y[NEQN-1];
+    Real temp1 = Temperature(rho, rho * (y[NEQN-1] + de) * e0 / unit_E_in_cgs_,
+                             y_corr, temp);
+    CalculateRates(rho, temp1, frv, rev);
+    RatesOfChange(frv, rev, y_corr, fn);
+    for (k = 0; k < NSCALARS; ++k) {
+      edot += q[k] * fn[k];
+    }
+    fn[NEQN-1] = conv_factor * edot * e0_inv;
+    Real e_diff_inv = 1.0 / de;
+    for (k = 0; k < NEQN; ++k) {
+      jac[NEQN-1][k] = (fn[k] - f[k]) * e_diff_inv;
+    }
+  }
+
+  if (eos_.IsTable() && !fixed_temp) {
+    /* With the tabulated EOS the temperature also depends on the composition
+       through the ion energy, 1.5 kT/m_u per ion (see alpha13) */
+    const Real de_ion = 1.5 * 1.380658e-16 * temp / (1.660539e-24 * e0);
+    for (j = 0; j < NSCALARS; ++j) {
+      if (!(y[j] > 0.0)) continue;
+      for (k = 0; k < NEQN; ++k) {
+        jac[j][k] -= de_ion * jac[NEQN-1][k];
+      }
+    }
+  }
+  return 1;
+}
+
+void ChemNetwork::RHSLanes(const LaneReal y[NEQN], LaneReal f[NEQN],
+                           LaneReal jac[NEQN][NEQN], LaneReal * rdata) {
+  /* The sparse kernels gather by index and do not vectorize across cells: RHSFull
+     lane by lane */
+  Real y_lane[NEQN], f_lane[NEQN], jac_lane[NEQN][NEQN], rdata_lane[3];
+  for (int l = 0; l < BURN_LANES; ++l) {
+    for (int k = 0; k < NEQN; ++k) y_lane[k] = y[k].v[l];
+    for (int k = 0; k < 3; ++k) rdata_lane[k] = rdata[k].v[l];
+    RHSFull(y_lane, f_lane, (jac == nullptr) ? nullptr : jac_lane, rdata_lane);
+    rdata[2].v[l] = rdata_lane[2];
+    for (int k = 0; k < NEQN; ++k) f[k].v[l] = f_lane[k];
+    if (jac == nullptr) continue;
+    for (int j = 0; j < NEQN; ++j) {
+      for (int k = 0; k < NEQN; ++k) jac[j][k].v[l] = jac_lane[j][k];
+    }
+  }
+}
+
+void ChemNetwork::RHS(const Real t, const Real y[NSCALARS], const Real ED,
+                      Real ydot[NSCALARS]) {
+  //the coupled burn updates the abundances itself
+  if (pburn != nullptr) {
+    for (int i=0; i<NSCALARS; i++) {
+      ydot[i] = 0.0;
+    }
+    return;
+  }
+  PERF_SCOPE(PERF_RHS, 8.0*nreac + 2.0*s_col.size(), 0.0);
+  Real frv[NREAC_MAX]; /* Forward reaction rates */
+  Real rev[NREAC_MAX]; /* Reverse reaction rates */
+  Real f[NEQN];
+  Real y_corr[NSCALARS];
+  for (int i=0; i<NSCALARS; i++) {
+    y_corr[i] = (y[i] > 0.0) ? y[i] : 0.0;
+  }
+  Real temp = Temperature(rho_, ED, y_corr, temp_guess_);
+  if (temp != temp) {
+    //the tabulated EOS did not converge; a NaN right-hand side would only make CVODE
+    //fail later without saying why, and must not warm-start the next inversion
+    std::stringstream msg;
+    msg << "### FATAL ERROR in ChemNetwork::RHS" << std::endl
+        << "temperature inversion did not converge in cell (" << kcell_ << ","
+        << jcell_ << "," << icell_ << "), rho = " << rho_ << " g/cm3, ED = " << ED
+        << std::endl;
+    throw std::runtime_error(msg.str().c_str());
+  }
+  if (eos_.IsTable()) {
+    //successive calls for one cell differ little; start the next inversion here
+    temp_guess_ = temp;
+    temp_cache_(kcell_, jcell_, icell_) = temp;
+  }
+  CalculateRates(rho_, temp, frv, rev);
+  RatesOfChange(frv, rev, y_corr, f);
+  for (int i=0; i<NSCALARS; i++) {
+    //return in code units
+    ydot[i] = unit_time_in_s_*f[i];
+  }
+  return;
+}
+
+Real ChemNetwork::Edot(const Real t, const Real y[NSCALARS], const Real ED) {
+  //isothermal, or energy already deposited by the coupled burn
+  if (!NON_BAROTROPIC_EOS || pburn != nullptr) {
+    return 0;
+  }
+  Real ydot[NSCALARS];
+  RHS(t, y, ED, ydot);
+  Real edot = 0.0;
+  for (int i = 0; i < NSCALARS; ++i) {
+    edot += q[i] * ydot[i];
+  }
+  //erg/g per code time to energy density per code time
+  return rho_ * conv_factor * edot / unit_E_in_cgs_;
+}
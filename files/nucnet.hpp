@@ -0,0 +1,167 @@
+#ifndef NUCNET_HPP
+#define NUCNET_HPP
+//======================================================================================
+// Athena++ astrophysical MHD code
+// Copyright (C) 2014 James M. Stone  <jmstone@princeton.edu>
+// See LICENSE file for full public license information.
+//======================================================================================
+//! \file nucnet.hpp
+//  \brief general nuclear reaction network, with the species and reactions read from
+//  a network file at startup (configure with --chemistry=nucnet --nscalars=<species>)
+//
+//  The network file <chemistry> network_data_file is read by the first MeshBlock. It
+//  holds, one entry per line ('#' starts a comment):
+//
+//    species <name> <A> <Z> <q> <g0> <apf> <bpf> <cpf>
+//        binding energy q in MeV and partition function g0*(1 + exp(apf/T9 + bpf +
+//        cpf*T9)); species are numbered in the order of the file
+//    reaction <reactants> -> <products>
+//        at most MAXR reactants and MAXR products; the lines below belong to it
+//    factor <c>
+//        constant factor of the forward rate (default 1)
+//    reverse <sign> [<C>]
+//        the reverse rate follows from detailed balance, with the constant C
+//        (default 9.867425e9^(nr-np) (prod A_reactants/prod A_products)^1.5) and the
+//        screening of the reverse times sign (1 is detailed balance)
+//    rate <a0> <a1> <a2> <a3> <a4> <a5> <a6>
+//        one set of the REACLIB fit exp(a0 + a1/T9 + a2 T9^-1/3 + a3 T9^1/3 + a4 T9 +
+//        a5 T9^5/3 + a6 ln T9); the forward rate is the sum over its sets
+//
+//  The forward rate of a reaction with n reactants is factor rho^(n-1) sum exp(fit)/
+//  prod(m!) for m identical reactants, screened as in alpha13. The reaction flux is
+//  r = frv (prod y_reactants - rev prod y_products), and dy/dt = S r with the
+//  stoichiometric matrix S. At startup the network is turned into flat arrays: the
+//  reactants and products of every reaction padded to MAXR with a species of abundance
+//  one, S in CSR format by species, and the sparsity of the Jacobian in CSR format,
+//  with the list of (nonzero, reaction slot) contributions that fill it. The RHS is a
+//  loop over reactions and a sparse product; the Jacobian one more loop over reactions
+//  and a gather of the slot derivatives. The temperature derivatives are exact, from
+//  the dual-number evaluation of the rates. alpha13.net is the alpha13 network.
+//======================================================================================
+//c++ headers
+#include <string> //std::string
+
+// Athena++ classes headers
+#include "network.hpp"
+#include "../../athena.hpp"
+#include "../../athena_arrays.hpp"
+#include "../utils/simd_lanes.hpp"
+#include "../utils/tabulated_eos.hpp"
+
+class BurnIntegrator;
+
+//! \class ChemNetwork
+//  \brief nuclear network read from a file, with the interface of alpha13
+class ChemNetwork : public NetworkWrapper {
+  //It would be convenient to know the species names in
+  //initialization of chemical species in problem
+  friend class MeshBlock;
+  //the coupled burn calls RHSFull and needs the unit conversions
+  friend class BurnIntegrator;
+public:
+  //pmb = nullptr: a network outside the mesh, for burns along given histories
+  ChemNetwork(MeshBlock *pmb, ParameterInput *pin);
+  ~ChemNetwork();
+
+  //a list of species name, used in output; set from the network file
+  static std::string species_names[NSCALARS];
+
+  //Set the rates of chemical reactions, eg. through density and radiation field.
+  //k, j, i are the corresponding index of the grid
+  void InitializeNextStep(const int k, const int j, const int i);
+
+  //RHS: right-hand-side of ODE. dy/dt = ydot(t, y). Here y are the abundance
+  //of species. all input/output variables are in code units
+  void RHS(const Real t, const Real y[NSCALARS], const Real ED,
+           Real ydot[NSCALARS]);
+
+  //energy equation dED/dt, all input/output variables are in code units
+  //(ED is the energy density)
+  Real Edot(const Real t, const Real y[NSCALARS], const Real ED);
+
+  //nuclear binding energy of the composition y, in erg/g
+  Real BindingEnergy(const Real y[NSCALARS]);
+  //temperature (K) from density (g/cm3), energy density (code units) and
+  //composition; with the tabulated EOS, tguess > 0 starts the inversion, and
+  //the result is NaN if the inversion does not converge
+  Real Temperature(const Real rho, const Real ED, const Real y[NSCALARS],
+                   const Real tguess=0.0) {return eos_.Temperature(rho, ED, y, tguess);}
+  //energy density (code units) from density (g/cm3), temperature and composition
+  Real InternalEnergyDensity(const Real rho, const Real temp, const Real y[NSCALARS]) {
+    return eos_.InternalEnergyDensity(rho, temp, y);
+  }
+  //nuclear energy generation rate, in erg/g/s, at density rho (g/cm3) and
+  //temperature temp (K)
+  Real EnergyGenerationRate(const Real rho, const Real temp, const Real y[NSCALARS]);
+  //density of cell (k,j,i) in g/cm3 with the hydro density floor, the rho that
+  //Temperature and EnergyGenerationRate take
+  Real CellDensity(const int k, const int j, const int i) const;
+  //length unit in cm, which turns code volumes into cm3
+  Real LengthUnit() const {return unit_length_in_cm_;}
+  //index of the isotope considered fuel, read from input
+  int FuelIndex() const {return NISOfuel;}
+  //mass number of species ispec, to convert abundances to mass fractions
+  static Real MassNumber(const int ispec) {return Aiso[ispec];}
+
+  //coupled abundance-energy burn (<chemistry> burn = coupled), nullptr when the
+  //burn is operator split from the energy; driven as for alpha13
+  BurnIntegrator *pburn;
+
+  static const int MAXR = 3;          // reactants or products of a reaction
+  static const int NREAC_MAX = 512;   // reactions of a network
+  static const int NSET_MAX = 2048;   // rate fit sets of a network
+
+private:
+  PassiveScalars *pmy_spec_;
+  MeshBlock *pmy_mb_;
+
+  static const int NEQN = NSCALARS + 1;
+  static Real Aiso[NSCALARS]; // mass numbers, from the network file
+  static constexpr Real nucnet_Tcold = 2.e8; //below this the plasma is inert
+
+  Real unit_density; //read from input
+  int NISOfuel; //read from input
+  bool nucnet_dualder; //exact energy derivatives from dual numbers, read from input
+  Real nucnet_epsder; //else the energy increment of the numerical derivatives
+  Real unit_length_in_cm_; //read from input
+  Real unit_vel_in_cms_; //read from input
+  Real unit_time_in_s_; //from length and velocity units
+  Real unit_E_in_cgs_; //unit of energy density, in erg cm-3
+  Real rho_; //density, updated at InitializeNextStep from hydro variable
+  //ideal gas, or the electron-degenerate EOS table with <chemistry> eos = table
+  NetworkEOS eos_;
+  //temperature guesses for the temperature inversion, as in alpha13
+  Real temp_guess_;
+  AthenaArray<Real> temp_cache_;
+  int kcell_, jcell_, icell_; //current cell, set at InitializeNextStep
+
+  //read the network file and build the flat reaction arrays
+  void ReadNetwork(const std::string fname);
+  //specific heat de/dT (erg/g/K) at constant density
+  Real SpecificHeat(const Real rho, const Real temp, const Real y[NSCALARS]) {
+    return eos_.SpecificHeat(rho, temp, y);
+  }
+
+  //forward rates frv and reverse coefficients rev (backward rate = frv*rev) of
+  //every reaction; generic in the scalar type for the dual-number derivatives
+  template <typename T>
+  void CalculateRates(const T rho, const T tp, T frv[], T rev[]);
+  //rates of change f[0:NSCALARS-1] = S r of the abundances y
+  template <typename T>
+  void RatesOfChange(const T frv[], const T rev[], const Real y[NSCALARS], T f[]);
+  //f and the Jacobian df[j][i] = df[i]/dy[j] with respect to the abundances, and
+  //the energy generation rate f[NEQN-1] with its derivatives df[j][NEQN-1]
+  void PartialDerivatives(const Real frv[], const Real rev[], const Real y[NSCALARS],
+                          Real f[NEQN], Real df[NEQN][NEQN]);
+
+  //the system of the coupled burn, as ChemNetwork::RHSFull of alpha13; exact = true
+  //takes the energy derivatives from dual numbers whatever nucnet_dualder
+  int RHSFull(const Real y[NEQN], Real f[NEQN], Real jac[NEQN][NEQN], Real * rdata,
+              const bool exact=false);
+  //RHSFull of BURN_LANES cells for the lockstep burn, as in alpha13; here one lane
+  //at a time
+  void RHSLanes(const LaneReal y[NEQN], LaneReal f[NEQN], LaneReal jac[NEQN][NEQN],
+                LaneReal * rdata);
+};
+
+#endif // NUCNET_HPP
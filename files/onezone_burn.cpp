@@ -0,0 +1,617 @@
+//======================================================================================
+// Athena++ astrophysical MHD code
+// Copyright (C) 2014 James M. Stone  <jmstone@princeton.edu>
+//
+// This program is free software: you can redistribute and/or modify it under the terms
+// of the GNU General Public License (GPL) as published by the Free Software Foundation,
+// either version 3 of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+// PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+//
+// You should have received a copy of GNU GPL in the file LICENSE included in the code
+// distribution.  If not see <http://www.gnu.org/licenses/>.
+//======================================================================================
+//! \file onezone_burn.cpp
+//  \brief golden-trajectory one-zone burns for the alpha13 network
+//
+//  Every cell along x1 is an independent one-zone burn at fixed density, with the
+//  temperature spaced logarithmically between T9_min and T9_max. The hydro is run as a
+//  static background, so cells do not talk to each other. At the end of the run the
+//  final abundances and the integrated energy release of each trajectory are either
+//  recorded to, or compared against, a stored reference file:
+//
+//    golden_mode = compare  compare against the reference file (default), report the
+//                           error and the wall-time speedup, and fail if outside the
+//                           tolerances
+//    golden_mode = record   write the reference file; an existing one is only
+//                           overwritten with golden_overwrite = true
+//    golden_mode = none     do nothing
+//
+//  The report is written to <problem_id>.golden. The references golden_onezone_*.dat of
+//  the athinput.onezone_* decks are recorded with the coupled burn at burn_reltol =
+//  1e-10, burn_abstol = 1e-16. Their wall time is that of the machine they were
+//  recorded on, so for a meaningful speedup record them again locally with
+//  problem/golden_mode=record problem/golden_overwrite=true and those tolerances.
+//
+//    golden_mode = tune     search the coupled burn settings of each burning regime
+//
+//  tune burns every trajectory again with each combination of the candidate settings
+//    tune_reltol   burn_reltol            (default "1e-3 1e-4 1e-5 1e-6")
+//    tune_abstol   burn_abstol            (default "1e-8 1e-10 1e-12")
+//    tune_explicit burn_explicit, 1 or 0  (default "1 0")
+//    tune_hinit    first trial step in units of the burn time (default "1 1e-3")
+//  over tune_time (default tlim) in tune_nburn (100) equal burns, on rank 0, timing
+//  each the fastest of tune_repeat (3) times. The trajectories are split into tune_nbin
+//  (4) bins of temperature; the regime of a bin, with the dominant species of the
+//  initial composition, gets the fastest settings whose trajectories all pass the
+//  tolerances of compare mode, and burn_maxsteps tune_maxsteps_factor (10) times the
+//  most steps one of their burns took. The regimes replace those of the same species
+//  and temperatures in the table tune_file (burn_tune.dat), which <chemistry>
+//  burn_tune_file reads. The mesh burn is not used, run with nlim = 0.
+//
+//    golden_mode = surrogate  build and validate the table of small burns of the
+//                             <burn_surrogate> parameters (see burn_surrogate.hpp)
+//                             and write it to <burn_surrogate> file
+//
+//  Like tune it runs on rank 0 after the mesh burn, which is not needed. The table is
+//  then checked on the trajectories by compare mode with <chemistry>
+//  burn_surrogate_file set.
+//======================================================================================
+
+// c headers
+#include <stdio.h>    // c style file
+
+// C++ headers
+#include <algorithm>  // std::min()
+#include <chrono>     // steady_clock
+#include <cmath>      // std::abs(), std::pow()
+#include <fstream>    // ifstream, ofstream
+#include <iomanip>    // setprecision
+#include <iostream>   // endl
+#include <sstream>    // stringstream
+#include <stdexcept>  // std::runtime_error()
+#include <string>     // c_str()
+#include <vector>     // vector container
+
+// Athena++ headers
+#include "../athena.hpp"
+#include "../athena_arrays.hpp"
+#include "../chemistry/utils/burn_cache.hpp"
+#include "../chemistry/utils/burn_integrator.hpp"
+#include "../chemistry/utils/burn_scheduler.hpp"
+#include "../chemistry/utils/burn_surrogate.hpp"
+#include "../chemistry/utils/burn_tuning.hpp"
+#include "../chemistry/utils/perf_counters.hpp"
+#include "../coordinates/coordinates.hpp"
+#include "../eos/eos.hpp"
+#include "../globals.hpp"
+#include "../hydro/hydro.hpp"
+#include "../mesh/mesh.hpp"
+#include "../parameter_input.hpp"
+#include "../scalars/scalars.hpp"
+
+#ifdef MPI_PARALLEL
+#include <mpi.h>
+#endif
+
+#ifndef INCLUDE_CHEMISTRY
+#error "onezone_burn.cpp requires a chemistry network, configure with --chemistry"
+#endif
+
+namespace {
+// isotope mass numbers, used to turn network abundances into mass fractions
+const Real Aiso[NSCALARS] =
+{4.0, 12.0, 16.0, 20.0, 24.0, 28.0, 32.0, 36.0, 40.0, 44.0, 48.0, 52.0, 56.0};
+
+Real rho0, T9min, T9max;
+int ntraj;
+Real eb0; // initial binding energy, the same for every trajectory [erg/g]
+std::chrono::steady_clock::time_point wall_start;
+BurnScheduler *psched = nullptr;  // coupled burn, if <chemistry> burn = coupled
+
+Real TrajectoryT9(int n);
+int TrajectoryIndex(MeshBlock *pmb, int i);
+void ReadReference(const std::string fname, std::vector<Real> *ref, Real *wall_time);
+bool WithinTolerance(const Real res[], const Real ref[], const Real tol[3],
+                     Real *err_x, Real *err_eps);
+std::vector<Real> ParseList(ParameterInput *pin, const std::string name,
+                            const std::string def);
+void TuneRegimes(Mesh *pm, ParameterInput *pin);
+} // namespace
+
+Real ReactionTimeStep(MeshBlock *pmb);
+
+//======================================================================================
+//! \fn void Mesh::InitUserMeshData(ParameterInput *pin)
+//  \brief read the trajectory grid and start the wall clock
+//======================================================================================
+
+void Mesh::InitUserMeshData(ParameterInput *pin) {
+  EnrollUserTimeStepFunction(ReactionTimeStep);
+  rho0 = pin->GetReal("problem", "rho");
+  T9min = pin->GetReal("problem", "T9_min");
+  T9max = pin->GetOrAddReal("problem", "T9_max", T9min);
+  ntraj = pin->GetInteger("mesh", "nx1");
+  wall_start = std::chrono::steady_clock::now();
+  if (pin->GetOrAddString("chemistry", "burn", "split") == "coupled") {
+    psched = new BurnScheduler(this, pin);
+  }
+  return;
+}
+
+//======================================================================================
+//! \fn void MeshBlock::ProblemGenerator(ParameterInput *pin)
+//  \brief uniform density and composition, temperature varying along x1
+//======================================================================================
+
+void MeshBlock::ProblemGenerator(ParameterInput *pin) {
+  Real y0[NSCALARS];
+  for (int ispec=0; ispec < NSCALARS; ++ispec) {
+    y0[ispec] = pin->GetOrAddReal("problem",
+        "s_init_"+pscalars->chemnet.species_names[ispec], 0.);
+  }
+  eb0 = pscalars->chemnet.BindingEnergy(y0);
+
+  for (int k=ks; k<=ke; ++k) {
+    for (int j=js; j<=je; ++j) {
+      for (int i=is; i<=ie; ++i) {
+        int n = TrajectoryIndex(this, i);
+        Real temp = 1.e9*TrajectoryT9(n);
+        phydro->u(IDN, k, j, i) = rho0;
+        phydro->u(IM1, k, j, i) = 0.0;
+        phydro->u(IM2, k, j, i) = 0.0;
+        phydro->u(IM3, k, j, i) = 0.0;
+        //same EOS ChemNetwork::RHS uses to recover the temperature
+        phydro->u(IEN, k, j, i) =
+            pscalars->chemnet.InternalEnergyDensity(rho0, temp, y0);
+        for (int ispec=0; ispec < NSCALARS; ++ispec) {
+          pscalars->s(ispec, k, j, i) = y0[ispec]*rho0;
+        }
+      }
+    }
+  }
+  return;
+}
+
+//======================================================================================
+//! \fn void Mesh::UserWorkInLoop()
+//  \brief with burn = coupled, self-heating burn of every trajectory over the step,
+//  spread over the threads by the work-stealing scheduler
+//======================================================================================
+
+void Mesh::UserWorkInLoop() {
+  if (psched != nullptr) psched->Burn(dt);
+  return;
+}
+
+//======================================================================================
+//! \fn void Mesh::UserWorkAfterLoop(ParameterInput *pin)
+//  \brief record or compare the final state of every trajectory
+//======================================================================================
+
+void Mesh::UserWorkAfterLoop(ParameterInput *pin) {
+  if (psched != nullptr) {
+    delete psched;
+    psched = nullptr;
+  }
+  //share of the cell burns copied from the burn cache
+  if (BurnIntegrator::pcache != nullptr) {
+    long count[2] = {BurnIntegrator::pcache->nlookup, BurnIntegrator::pcache->nhit};
+#ifdef MPI_PARALLEL
+    MPI_Allreduce(MPI_IN_PLACE, count, 2, MPI_LONG, MPI_SUM, MPI_COMM_WORLD);
+#endif
+    if (Globals::my_rank == 0 && count[0] > 0) {
+      std::cout << "burn cache: " << count[1] << " of " << count[0]
+                << " cell burns reused, hit rate "
+                << static_cast<Real>(count[1])/count[0] << std::endl;
+    }
+  }
+  //share of the cell burns taken from the surrogate table
+  if (BurnIntegrator::psurr != nullptr) {
+    long count[2] = {BurnIntegrator::psurr->nlookup, BurnIntegrator::psurr->nhit};
+#ifdef MPI_PARALLEL
+    MPI_Allreduce(MPI_IN_PLACE, count, 2, MPI_LONG, MPI_SUM, MPI_COMM_WORLD);
+#endif
+    if (Globals::my_rank == 0 && count[0] > 0) {
+      std::cout << "burn surrogate: " << count[1] << " of " << count[0]
+                << " cell burns from the table, hit rate "
+                << static_cast<Real>(count[1])/count[0] << std::endl;
+    }
+  }
+  //failed cell burns and the rungs of the recovery ladder that saved them
+  {
+    long count[BurnIntegrator::NRUNG + 1];
+    long nfail = 0;
+    for (int r=0; r<=BurnIntegrator::NRUNG; ++r) {
+      count[r] = BurnIntegrator::nrecover[r];
+    }
+#ifdef MPI_PARALLEL
+    MPI_Allreduce(MPI_IN_PLACE, count, BurnIntegrator::NRUNG + 1, MPI_LONG, MPI_SUM,
+                  MPI_COMM_WORLD);
+#endif
+    for (int r=0; r<=BurnIntegrator::NRUNG; ++r) nfail += count[r];
+    if (Globals::my_rank == 0 && nfail > 0) {
+      std::cout << "burn recovery: " << nfail << " failed cell burns, recovered by rung";
+      for (int r=0; r<BurnIntegrator::NRUNG; ++r) std::cout << " " << count[r];
+      std::cout << ", not recovered " << count[BurnIntegrator::NRUNG] << std::endl;
+    }
+  }
+  //cycles and cache misses of the chemistry kernels, with -perf_counters
+  PerfReport(std::cout);
+  std::string mode = pin->GetOrAddString("problem", "golden_mode", "compare");
+  if (mode == "none") return;
+  if (mode == "tune") {
+    TuneRegimes(this, pin);
+    return;
+  }
+  if (mode == "surrogate") {
+    if (Globals::my_rank == 0 && nblocal > 0) {
+      BurnIntegrator burn(&my_blocks(0)->pscalars->chemnet, nullptr, pin);
+      BurnSurrogate table;
+      table.Generate(&burn, &my_blocks(0)->pscalars->chemnet, pin, "burn_surrogate");
+      std::string fname = pin->GetOrAddString("burn_surrogate", "file",
+                                              "burn_surrogate.bin");
+      table.Write(fname);
+      std::cout << "burn surrogate table written to " << fname << std::endl;
+    }
+    return;
+  }
+  const Real wall_time = std::chrono::duration<Real>(
+      std::chrono::steady_clock::now() - wall_start).count();
+
+  //final mass fractions and energy release of every trajectory; each trajectory is
+  //owned by exactly one rank, so a sum over ranks gathers them
+  const int nv = NSCALARS + 1;
+  std::vector<Real> res(ntraj*nv, 0.0);
+  for (int b=0; b<nblocal; ++b) {
+    MeshBlock *pmb = my_blocks(b);
+    int k = pmb->ks, j = pmb->js;
+    for (int i=pmb->is; i<=pmb->ie; ++i) {
+      int n = TrajectoryIndex(pmb, i);
+      Real rho = pmb->phydro->u(IDN, k, j, i);
+      Real y[NSCALARS];
+      for (int ispec=0; ispec < NSCALARS; ++ispec) {
+        y[ispec] = pmb->pscalars->s(ispec, k, j, i)/rho;
+        res[n*nv + ispec] = Aiso[ispec]*y[ispec];
+      }
+      res[n*nv + NSCALARS] = pmb->pscalars->chemnet.BindingEnergy(y) - eb0;
+    }
+  }
+#ifdef MPI_PARALLEL
+  MPI_Allreduce(MPI_IN_PLACE, &res[0], ntraj*nv, MPI_ATHENA_REAL, MPI_SUM,
+                MPI_COMM_WORLD);
+#endif
+  if (Globals::my_rank != 0) return;
+
+  std::string ref_file = pin->GetString("problem", "reference_file");
+  std::string label = pin->GetOrAddString("problem", "label", "default");
+
+  if (mode == "record") {
+    //the reference is the gate of every other run, never replace it by accident
+    if (!pin->GetOrAddBoolean("problem", "golden_overwrite", false)
+        && std::ifstream(ref_file.c_str()).good()) {
+      std::stringstream msg;
+      msg << "### FATAL ERROR in Mesh::UserWorkAfterLoop" << std::endl
+          << "Reference file " << ref_file << " exists, set problem/golden_overwrite="
+          << "true to record it again" << std::endl;
+      throw std::runtime_error(msg.str().c_str());
+    }
+    std::ofstream os(ref_file.c_str());
+    os << "# golden one-zone trajectories, rho = " << rho0 << " g/cm^3" << std::endl;
+    os << "# label " << label << std::endl;
+    os << "# wall_time " << std::setprecision(6) << wall_time << std::endl;
+    os << "# ntraj " << ntraj << std::endl;
+    os << "# T9  eps_nuc[erg/g]  X(";
+    for (int ispec=0; ispec < NSCALARS; ++ispec) {
+      os << " " << ChemNetwork::species_names[ispec];
+    }
+    os << " )" << std::endl;
+    os << std::scientific << std::setprecision(16);
+    for (int n=0; n<ntraj; ++n) {
+      os << TrajectoryT9(n) << " " << res[n*nv + NSCALARS];
+      for (int ispec=0; ispec < NSCALARS; ++ispec) {
+        os << " " << res[n*nv + ispec];
+      }
+      os << std::endl;
+    }
+    std::cout << "golden trajectories recorded to " << ref_file << std::endl;
+    return;
+  }
+
+  //compare mode: read the reference
+  Real ref_wall_time = 0.0;
+  std::vector<Real> ref;
+  ReadReference(ref_file, &ref, &ref_wall_time);
+
+  const Real tol[3] = {pin->GetOrAddReal("problem", "X_atol", 1.e-6),
+                       pin->GetOrAddReal("problem", "X_rtol", 1.e-3),
+                       pin->GetOrAddReal("problem", "eps_rtol", 1.e-3)};
+  bool pass = true;
+  std::string fname = pin->GetString("job", "problem_id") + ".golden";
+  std::ofstream os(fname.c_str());
+  os << "# label " << label << std::endl;
+  os << "# T9  err_X(max)  err_eps(rel)  status" << std::endl;
+  os << std::scientific << std::setprecision(6);
+  for (int n=0; n<ntraj; ++n) {
+    Real err_x, err_eps;
+    bool ok = WithinTolerance(&res[n*nv], &ref[n*nv], tol, &err_x, &err_eps);
+    pass = pass && ok;
+    os << TrajectoryT9(n) << " " << err_x << " " << err_eps << " "
+       << (ok ? "PASS" : "FAIL") << std::endl;
+  }
+  Real speedup = (wall_time > 0.0) ? ref_wall_time/wall_time : 0.0;
+  os << "# wall_time " << wall_time << " ref_wall_time " << ref_wall_time
+     << " wall_time_per_trajectory " << wall_time/ntraj
+     << " speedup " << speedup << std::endl;
+  os.close();
+  std::cout << "golden trajectories [" << label << "]: " << (pass ? "PASS" : "FAIL")
+            << ", speedup " << std::setprecision(3) << std::fixed << speedup
+            << ", report in " << fname << std::endl;
+  if (!pass) {
+    std::stringstream msg;
+    msg << "### FATAL ERROR in Mesh::UserWorkAfterLoop" << std::endl
+        << "Golden trajectories outside tolerance, see " << fname << std::endl;
+    throw std::runtime_error(msg.str().c_str());
+  }
+  return;
+}
+
+Real ReactionTimeStep(MeshBlock *pmb) {
+  Real min_dt=FLT_MAX;
+  for (int k=pmb->ks; k<=pmb->ke; ++k) {
+    for (int j=pmb->js; j<=pmb->je; ++j) {
+      for (int i=pmb->is; i<=pmb->ie; ++i) {
+        Real dt;
+        dt = 2*pmb->pscalars->h(k,j,i) + 1e-20;
+        min_dt = std::min(min_dt, dt);
+      }
+    }
+  }
+  return min_dt;
+}
+
+namespace {
+//! \fn Real TrajectoryT9(int n)
+//  \brief temperature of trajectory n, log-spaced in [T9_min, T9_max]
+Real TrajectoryT9(int n) {
+  if (ntraj == 1) return T9min;
+  return T9min*std::pow(T9max/T9min, static_cast<Real>(n)/(ntraj - 1));
+}
+
+//! \fn int TrajectoryIndex(MeshBlock *pmb, int i)
+//  \brief global x1 index of cell i, which labels the trajectory
+int TrajectoryIndex(MeshBlock *pmb, int i) {
+  Real x1min = pmb->pmy_mesh->mesh_size.x1min;
+  Real x1max = pmb->pmy_mesh->mesh_size.x1max;
+  Real dx = (x1max - x1min)/ntraj;
+  int n = static_cast<int>((pmb->pcoord->x1v(i) - x1min)/dx);
+  return std::min(std::max(n, 0), ntraj - 1);
+}
+
+//! \fn void ReadReference(const std::string fname, std::vector<Real> *ref,
+//                         Real *wall_time)
+//  \brief final mass fractions and energy release of every trajectory, NSCALARS + 1
+//  values each, and the wall time of the run, from a reference file
+void ReadReference(const std::string fname, std::vector<Real> *ref, Real *wall_time) {
+  std::ifstream is(fname.c_str());
+  if (!is) {
+    std::stringstream msg;
+    msg << "### FATAL ERROR in Mesh::UserWorkAfterLoop" << std::endl
+        << "Unable to open reference file " << fname
+        << ", run with problem/golden_mode=record first" << std::endl;
+    throw std::runtime_error(msg.str().c_str());
+  }
+  const int nv = NSCALARS + 1;
+  ref->assign(ntraj*nv, 0.0);
+  *wall_time = 0.0;
+  std::string line;
+  int n = 0;
+  while (std::getline(is, line)) {
+    std::istringstream iss(line);
+    if (line.compare(0, 11, "# wall_time") == 0) {
+      std::string tag1, tag2;
+      iss >> tag1 >> tag2 >> *wall_time;
+      continue;
+    }
+    if (line.empty() || line[0] == '#') continue;
+    if (n >= ntraj) break;
+    Real t9;
+    iss >> t9 >> (*ref)[n*nv + NSCALARS];
+    for (int ispec=0; ispec < NSCALARS; ++ispec) {
+      iss >> (*ref)[n*nv + ispec];
+    }
+    n++;
+  }
+  if (n != ntraj) {
+    std::stringstream msg;
+    msg << "### FATAL ERROR in Mesh::UserWorkAfterLoop" << std::endl
+        << "Reference file " << fname << " has " << n << " trajectories, expected "
+        << ntraj << std::endl;
+    throw std::runtime_error(msg.str().c_str());
+  }
+  return;
+}
+
+//! \fn bool WithinTolerance(const Real res[], const Real ref[], const Real tol[3],
+//                           Real *err_x, Real *err_eps)
+//  \brief whether the final state res of a trajectory matches ref, with tol = X_atol,
+//  X_rtol, eps_rtol. Mass fractions are compared with a mixed absolute/relative
+//  tolerance, since most of them end up close to zero; the energy release with a
+//  relative one. Returns the largest error of the mass fractions and that of the
+//  energy release.
+bool WithinTolerance(const Real res[], const Real ref[], const Real tol[3],
+                     Real *err_x, Real *err_eps) {
+  bool ok = true;
+  *err_x = 0.0;
+  for (int ispec=0; ispec < NSCALARS; ++ispec) {
+    Real err = std::abs(res[ispec] - ref[ispec]);
+    *err_x = std::max(*err_x, err);
+    if (!(err <= tol[0] + tol[1]*std::abs(ref[ispec]))) ok = false;
+  }
+  Real epsref = ref[NSCALARS];
+  *err_eps = std::abs(res[NSCALARS] - epsref)
+             /std::max(std::abs(epsref), static_cast<Real>(TINY_NUMBER));
+  if (!(*err_eps <= tol[2])) ok = false;
+  return ok;
+}
+
+//! \fn std::vector<Real> ParseList(ParameterInput *pin, const std::string name,
+//                                  const std::string def)
+//  \brief the values of the space-separated list <problem> name
+std::vector<Real> ParseList(ParameterInput *pin, const std::string name,
+                            const std::string def) {
+  std::istringstream iss(pin->GetOrAddString("problem", name, def));
+  std::vector<Real> list;
+  Real v;
+  while (iss >> v) list.push_back(v);
+  if (list.empty() || !iss.eof()) {
+    std::stringstream msg;
+    msg << "### FATAL ERROR in Mesh::UserWorkAfterLoop" << std::endl
+        << "<problem> " << name << " is not a list of numbers" << std::endl;
+    throw std::runtime_error(msg.str().c_str());
+  }
+  return list;
+}
+
+//! \fn void TuneRegimes(Mesh *pm, ParameterInput *pin)
+//  \brief golden_mode = tune: the fastest candidate settings of the coupled burn that
+//  reproduce the reference, per bin of trajectories, added to the regime table
+void TuneRegimes(Mesh *pm, ParameterInput *pin) {
+  if (Globals::my_rank != 0 || pm->nblocal == 0) return;
+  const int nv = NSCALARS + 1;
+  Real ref_wall_time;
+  std::vector<Real> ref;
+  ReadReference(pin->GetString("problem", "reference_file"), &ref, &ref_wall_time);
+  const Real tol[3] = {pin->GetOrAddReal("problem", "X_atol", 1.e-6),
+                       pin->GetOrAddReal("problem", "X_rtol", 1.e-3),
+                       pin->GetOrAddReal("problem", "eps_rtol", 1.e-3)};
+  std::vector<Real> rtol = ParseList(pin, "tune_reltol", "1e-3 1e-4 1e-5 1e-6");
+  std::vector<Real> atol = ParseList(pin, "tune_abstol", "1e-8 1e-10 1e-12");
+  std::vector<Real> expl = ParseList(pin, "tune_explicit", "1 0");
+  std::vector<Real> hinit = ParseList(pin, "tune_hinit", "1 1e-3");
+  const Real tburn = pin->GetOrAddReal("problem", "tune_time",
+                                       pin->GetReal("time", "tlim"));
+  const int nburn = std::max(1, pin->GetOrAddInteger("problem", "tune_nburn", 100));
+  const int nrepeat = std::max(1, pin->GetOrAddInteger("problem", "tune_repeat", 3));
+  const int nbin = std::min(ntraj,
+      std::max(1, pin->GetOrAddInteger("problem", "tune_nbin", 4)));
+  const Real factor = pin->GetOrAddReal("problem", "tune_maxsteps_factor", 10.0);
+  std::string tune_file = pin->GetOrAddString("problem", "tune_file", "burn_tune.dat");
+
+  ChemNetwork *pnet = &pm->my_blocks(0)->pscalars->chemnet;
+  BurnIntegrator burn(pnet, nullptr, pin);
+  //the first candidate is burn_*, to report the speedup over it
+  std::vector<BurnIntegrator::Settings> cand(1, burn.GetSettings());
+  for (Real rt : rtol) {
+    for (Real at : atol) {
+      for (Real ex : expl) {
+        for (Real hi : hinit) {
+          BurnIntegrator::Settings set = cand[0];
+          set.rtol = rt;
+          set.atol = at;
+          set.expl = (ex != 0.0);
+          set.hinit = hi;
+          cand.push_back(set);
+        }
+      }
+    }
+  }
+  const int ncand = static_cast<int>(cand.size());
+
+  Real y0[NSCALARS];
+  for (int ispec=0; ispec < NSCALARS; ++ispec) {
+    y0[ispec] = pin->GetOrAddReal("problem", "s_init_"+ChemNetwork::species_names[ispec],
+                                  0.);
+  }
+  //wall time (< 0: outside the tolerances) and most steps of one burn, of every
+  //trajectory with every candidate
+  std::vector<Real> cost(ntraj*ncand);
+  std::vector<int> steps(ntraj*ncand);
+  for (int n=0; n<ntraj; ++n) {
+    const Real ED0 = pnet->InternalEnergyDensity(rho0, 1.e9*TrajectoryT9(n), y0);
+    for (int c=0; c<ncand; ++c) {
+      burn.SetSettings(cand[c]);
+      Real wall = 0.0;
+      Real y[NSCALARS], ED;
+      int nmax = -1;
+      for (int r=0; r<nrepeat; ++r) {
+        for (int ispec=0; ispec < NSCALARS; ++ispec) y[ispec] = y0[ispec];
+        ED = ED0;
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        nmax = burn.BurnZone(rho0, tburn, nburn, &ED, y);
+        Real w = std::chrono::duration<Real>(
+            std::chrono::steady_clock::now() - start).count();
+        wall = (r == 0) ? w : std::min(wall, w);
+        if (nmax < 0) break;
+      }
+      Real res[NSCALARS + 1];
+      for (int ispec=0; ispec < NSCALARS; ++ispec) res[ispec] = Aiso[ispec]*y[ispec];
+      res[NSCALARS] = pnet->BindingEnergy(y) - eb0;
+      Real err_x, err_eps;
+      bool ok = (nmax >= 0) && WithinTolerance(res, &ref[n*nv], tol, &err_x, &err_eps);
+      cost[n*ncand + c] = ok ? wall : -1.0;
+      steps[n*ncand + c] = nmax;
+    }
+  }
+
+  //regimes: contiguous bins of trajectories, bounded halfway (in log T) between the
+  //last trajectory of a bin and the first of the next
+  const int fuel = BurnTuning::DominantSpecies(y0);
+  std::vector<BurnTuning::Regime> regimes;
+  for (int b=0; b<nbin; ++b) {
+    const int nlo = b*ntraj/nbin, nhi = (b + 1)*ntraj/nbin - 1;
+    int best = -1;
+    Real best_cost = 0.0;
+    for (int c=0; c<ncand; ++c) {
+      Real sum = 0.0;
+      for (int n=nlo; n<=nhi && sum >= 0.0; ++n) {
+        sum = (cost[n*ncand + c] < 0.0) ? -1.0 : sum + cost[n*ncand + c];
+      }
+      //ties go to the burn_* settings, then to the loosest candidate
+      if (sum >= 0.0 && (best < 0 || sum < best_cost)) {
+        best = c;
+        best_cost = sum;
+      }
+    }
+    BurnTuning::Regime reg;
+    reg.fuel = fuel;
+    reg.t9lo = (nlo == 0) ? TrajectoryT9(nlo)
+               : std::sqrt(TrajectoryT9(nlo - 1)*TrajectoryT9(nlo));
+    reg.t9hi = (nhi == ntraj - 1) ? TrajectoryT9(nhi)
+               : std::sqrt(TrajectoryT9(nhi)*TrajectoryT9(nhi + 1));
+    std::cout << "burn regime " << ChemNetwork::species_names[fuel] << " T9 "
+              << reg.t9lo << "-" << reg.t9hi << ": ";
+    if (best < 0) {
+      std::cout << "no candidate within tolerance, burn_* settings" << std::endl;
+      continue;
+    }
+    int nmax = 0;
+    Real base_cost = 0.0;
+    for (int n=nlo; n<=nhi; ++n) {
+      nmax = std::max(nmax, steps[n*ncand + best]);
+      base_cost = (base_cost < 0.0 || cost[n*ncand] < 0.0) ? -1.0
+                  : base_cost + cost[n*ncand];
+    }
+    reg.set = cand[best];
+    reg.set.maxsteps = std::min(cand[0].maxsteps,
+        std::max(1, static_cast<int>(factor*std::max(nmax, 1))));
+    reg.cost = best_cost;
+    regimes.push_back(reg);
+    std::cout << "reltol " << reg.set.rtol << " abstol " << reg.set.atol
+              << " explicit " << reg.set.expl << " h_init " << reg.set.hinit
+              << " maxsteps " << reg.set.maxsteps << ", wall time " << best_cost;
+    if (base_cost > 0.0) std::cout << ", speedup " << base_cost/best_cost;
+    std::cout << std::endl;
+  }
+
+  BurnTuning table;
+  table.Read(tune_file, false);
+  table.Replace(fuel, T9min, T9max, regimes);
+  table.Write(tune_file);
+  std::cout << "burn regimes written to " << tune_file << ", " << table.NumRegimes()
+            << " in the table" << std::endl;
+  return;
+}
+} // namespace
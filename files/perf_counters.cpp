@@ -0,0 +1,227 @@
+//======================================================================================
+// Athena++ astrophysical MHD code
+// Copyright (C) 2014 James M. Stone  <jmstone@princeton.edu>
+// See LICENSE file for full public license information.
+//======================================================================================
+//! \file perf_counters.cpp
+//  \brief hardware performance counters of the chemistry kernels, per thread through
+//  perf_event_open(2)
+//======================================================================================
+
+// C headers
+#ifdef PERF_COUNTERS
+#ifdef __linux__
+#include <linux/perf_event.h>  // perf_event_attr
+#include <sys/ioctl.h>         // ioctl()
+#include <sys/syscall.h>       // __NR_perf_event_open
+#include <unistd.h>            // syscall(), read()
+#endif
+#endif
+
+// C++ headers
+#include <algorithm>  // std::min()
+#include <cerrno>     // errno
+#include <cstdint>    // std::uint64_t
+#include <cstring>    // std::memset(), std::strerror()
+#include <iomanip>    // setw, setprecision
+#include <mutex>      // mutex
+#include <ostream>    // ostream
+#include <vector>     // vector
+
+// Athena++ headers
+#include "../../athena.hpp"
+#include "../../globals.hpp"
+#include "perf_counters.hpp"
+
+#ifdef MPI_PARALLEL
+#include <mpi.h>
+#endif
+
+#ifdef PERF_COUNTERS
+namespace {
+const char *region_names[NPERF_REGIONS] =
+    {"rates", "rhs", "jacobian", "linsolve", "gather/scatter"};
+//hardware events of a group: cycles, instructions, LLC references, LLC misses
+const int NEVENT = 4;
+//counts of a region: passes, estimated flops and transcendentals, events
+enum {ICALLS=0, IFLOPS, ITRANSC, IEVENT, NCOUNT=IEVENT+NEVENT};
+const int MAXDEPTH = 8;
+
+struct ThreadCounters {
+  int leader;              // group leader, -1 if the counters are unavailable
+  int nopen;               // events opened, listed in ievent in the order of the group
+  int ievent[NEVENT];
+  int depth;               // nesting of the open scopes
+  int stack[MAXDEPTH];
+  std::uint64_t last[NEVENT];  // events at the last scope boundary
+  double count[NPERF_REGIONS][NCOUNT];
+};
+
+std::mutex registry_lock;
+std::vector<ThreadCounters *> registry;  // threads that entered a scope, never freed
+int open_errno = 0;                      // first failure to open a leader
+
+//! \fn ThreadCounters *OpenCounters()
+//  \brief counters of the calling thread, user space only
+ThreadCounters *OpenCounters() {
+  ThreadCounters *tc = new ThreadCounters;
+  std::memset(tc, 0, sizeof(ThreadCounters));
+  tc->leader = -1;
+#ifdef __linux__
+  const std::uint64_t config[NEVENT] = {
+      PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS,
+      PERF_COUNT_HW_CACHE_REFERENCES, PERF_COUNT_HW_CACHE_MISSES};
+  for (int e=0; e<NEVENT; ++e) {
+    struct perf_event_attr attr;
+    std::memset(&attr, 0, sizeof(attr));
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.size = sizeof(attr);
+    attr.config = config[e];
+    attr.disabled = (tc->leader < 0) ? 1 : 0;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    attr.read_format = PERF_FORMAT_GROUP;
+    int fd = static_cast<int>(syscall(__NR_perf_event_open, &attr, 0, -1, tc->leader,
+                                      0));
+    if (fd < 0) {
+      //without cycles nothing is counted; a missing cache event leaves the rest
+      if (e == 0) {
+        std::lock_guard<std::mutex> lock(registry_lock);
+        if (open_errno == 0) open_errno = errno;
+        break;
+      }
+      continue;
+    }
+    if (tc->leader < 0) tc->leader = fd;
+    tc->ievent[tc->nopen++] = e;
+  }
+  if (tc->leader >= 0) {
+    ioctl(tc->leader, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+    ioctl(tc->leader, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+  }
+#endif
+  std::lock_guard<std::mutex> lock(registry_lock);
+  registry.push_back(tc);
+  return tc;
+}
+
+ThreadCounters *Counters() {
+  static thread_local ThreadCounters *ptc = nullptr;
+  if (ptc == nullptr) ptc = OpenCounters();
+  return ptc;
+}
+
+//! \fn void ReadEvents(ThreadCounters *tc, std::uint64_t now[NEVENT])
+//  \brief current values of the events, 0 for those not counted
+void ReadEvents(ThreadCounters *tc, std::uint64_t now[NEVENT]) {
+  for (int e=0; e<NEVENT; ++e) now[e] = 0;
+#ifdef __linux__
+  std::uint64_t buf[1 + NEVENT];
+  if (tc->leader < 0 || read(tc->leader, buf, sizeof(buf)) <= 0) return;
+  for (int n=0; n<tc->nopen && n<static_cast<int>(buf[0]); ++n) {
+    now[tc->ievent[n]] = buf[1 + n];
+  }
+#endif
+  return;
+}
+
+//! \fn void Charge(ThreadCounters *tc)
+//  \brief add the events since the last boundary to the innermost open region
+void Charge(ThreadCounters *tc) {
+  std::uint64_t now[NEVENT];
+  ReadEvents(tc, now);
+  int region = tc->stack[std::min(tc->depth, MAXDEPTH) - 1];
+  for (int e=0; e<NEVENT; ++e) {
+    tc->count[region][IEVENT + e] += static_cast<double>(now[e] - tc->last[e]);
+    tc->last[e] = now[e];
+  }
+  return;
+}
+} // namespace
+
+PerfScope::PerfScope(const PerfRegion region, const Real flops, const Real ntransc) {
+  ThreadCounters *tc = Counters();
+  if (tc->depth > 0) {
+    Charge(tc);
+  } else {
+    ReadEvents(tc, tc->last);
+  }
+  //deeper scopes than MAXDEPTH are counted in the innermost recorded one
+  if (tc->depth < MAXDEPTH) tc->stack[tc->depth] = region;
+  tc->depth++;
+  tc->count[region][ICALLS] += 1.0;
+  tc->count[region][IFLOPS] += flops;
+  tc->count[region][ITRANSC] += ntransc;
+}
+
+PerfScope::~PerfScope() {
+  ThreadCounters *tc = Counters();
+  Charge(tc);
+  tc->depth--;
+}
+#endif // PERF_COUNTERS
+
+//--------------------------------------------------------------------------------------
+//! \fn void PerfReport(std::ostream &os)
+//  \brief per rank and region: passes, cycles, instructions per cycle, LLC references
+//  and misses, and the estimated flop and transcendental counts
+
+void PerfReport(std::ostream &os) {
+#ifdef PERF_COUNTERS
+  //threads of this rank, then the number of threads and of those with counters
+  const int nlocal = NPERF_REGIONS*NCOUNT + 2;
+  std::vector<double> local(nlocal, 0.0);
+  {
+    std::lock_guard<std::mutex> lock(registry_lock);
+    for (ThreadCounters *tc : registry) {
+      for (int r=0; r<NPERF_REGIONS; ++r) {
+        for (int c=0; c<NCOUNT; ++c) local[r*NCOUNT + c] += tc->count[r][c];
+      }
+      local[nlocal-2] += 1.0;
+      if (tc->leader >= 0) local[nlocal-1] += 1.0;
+    }
+  }
+  std::vector<double> all(Globals::nranks*nlocal, 0.0);
+#ifdef MPI_PARALLEL
+  MPI_Gather(local.data(), nlocal, MPI_DOUBLE, all.data(), nlocal, MPI_DOUBLE, 0,
+             MPI_COMM_WORLD);
+#else
+  all = local;
+#endif
+  if (Globals::my_rank != 0) return;
+
+  os << "perf counters: per pass, exclusive of nested regions; flop and transc "
+     << "(exp, log, pow, sqrt) are estimates" << std::endl;
+  if (open_errno != 0) {
+    os << "hardware counters unavailable on rank 0: " << std::strerror(open_errno)
+       << " (see /proc/sys/kernel/perf_event_paranoid)" << std::endl;
+  }
+  os << std::setw(5) << "rank" << std::setw(16) << "region" << std::setw(12) << "calls"
+     << std::setw(12) << "cycles" << std::setw(7) << "IPC" << std::setw(12) << "LLC refs"
+     << std::setw(12) << "LLC miss" << std::setw(11) << "flop" << std::setw(9)
+     << "transc" << std::setw(11) << "flop/cycle" << std::endl;
+  for (int rank=0; rank<Globals::nranks; ++rank) {
+    const double *v = &all[rank*nlocal];
+    for (int r=0; r<NPERF_REGIONS; ++r) {
+      const double *c = &v[r*NCOUNT];
+      if (c[ICALLS] == 0.0) continue;
+      const double ncall = c[ICALLS];
+      const double cycles = c[IEVENT];
+      os << std::setw(5) << rank << std::setw(16) << region_names[r]
+         << std::setw(12) << static_cast<long>(ncall) << std::fixed
+         << std::setprecision(1) << std::setw(12) << cycles/ncall
+         << std::setprecision(2) << std::setw(7)
+         << ((cycles > 0.0) ? c[IEVENT+1]/cycles : 0.0)
+         << std::setprecision(1) << std::setw(12) << c[IEVENT+2]/ncall
+         << std::setw(12) << c[IEVENT+3]/ncall << std::setw(11) << c[IFLOPS]/ncall
+         << std::setw(9) << c[ITRANSC]/ncall << std::setprecision(3) << std::setw(11)
+         << ((cycles > 0.0) ? c[IFLOPS]/cycles : 0.0) << std::endl;
+      os.unsetf(std::ios_base::floatfield);
+    }
+    os << std::setw(5) << rank << "  " << static_cast<int>(v[nlocal-2])
+       << " threads, " << static_cast<int>(v[nlocal-1]) << " with hardware counters"
+       << std::endl;
+  }
+#endif // PERF_COUNTERS
+  return;
+}
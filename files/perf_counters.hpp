@@ -0,0 +1,56 @@
+#ifndef CHEMISTRY_UTILS_PERF_COUNTERS_HPP_
+#define CHEMISTRY_UTILS_PERF_COUNTERS_HPP_
+//======================================================================================
+// Athena++ astrophysical MHD code
+// Copyright (C) 2014 James M. Stone  <jmstone@princeton.edu>
+// See LICENSE file for full public license information.
+//======================================================================================
+//! \file perf_counters.hpp
+//  \brief hardware performance counters around the chemistry kernels (configure with
+//  -perf_counters, Linux only)
+//
+//  A PERF_SCOPE(region, flops, ntransc) statement counts cycles, instructions, and
+//  last-level cache references and misses from there to the end of the enclosing
+//  block, through perf_event_open(2) on the calling thread. flops and ntransc are the
+//  caller's estimates of the floating-point operations and transcendental functions
+//  (exp, log, pow, sqrt) of one pass; the hardware FP events are model specific, so
+//  they are not used. Counts are exclusive: a region nested in another (the rates in
+//  the RHS) is subtracted from the outer one. Every thread opens its own counters at
+//  its first scope, and the threads of a rank are summed in the report.
+//
+//  Without -perf_counters PERF_SCOPE compiles to nothing and PerfReport() prints
+//  nothing. Reading the counters costs a system call at every scope boundary, so the
+//  regions are the kernels of a cell (rates, RHS, Jacobian, LU) and the tile
+//  gather/scatter, not their inner loops. If the kernel refuses the counters
+//  (perf_event_paranoid, containers) the calls and estimates are still reported.
+//======================================================================================
+
+// C++ headers
+#include <ostream>  // ostream
+
+// Athena++ headers
+#include "../../athena.hpp"
+
+//! regions of the chemistry kernels
+enum PerfRegion {PERF_RATES=0, PERF_RHS, PERF_JACOBIAN, PERF_LINSOLVE, PERF_GATHER,
+                 NPERF_REGIONS};
+
+//! \class PerfScope
+//  \brief counts the enclosing block as one pass through region
+class PerfScope {
+ public:
+  PerfScope(const PerfRegion region, const Real flops, const Real ntransc);
+  ~PerfScope();
+};
+
+//counts per region of every rank, written by rank 0; call on all ranks at the end of
+//the run, outside the burn
+void PerfReport(std::ostream &os);
+
+#ifdef PERF_COUNTERS
+#define PERF_SCOPE(region, flops, ntransc) PerfScope perf_scope_(region, flops, ntransc)
+#else
+#define PERF_SCOPE(region, flops, ntransc)
+#endif
+
+#endif // CHEMISTRY_UTILS_PERF_COUNTERS_HPP_
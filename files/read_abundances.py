@@ -0,0 +1,115 @@
+"""
+Read compressed abundance dumps written by AbundanceOutput (abundance_output.cpp).
+
+Each rank writes <problem_id>.abun.r<rank>.<file_number>.h5. read_abundances() reads
+all rank files of one dump and restores dense mass-fraction arrays.
+"""
+
+# Python modules
+import glob
+import re
+
+import numpy as np
+
+# single precision primitive datasets written with hydro = true
+PRIM_NAMES = ('rho', 'vel1', 'vel2', 'vel3', 'press')
+
+def abundance_files(basename, file_number):
+    """Return the sorted list of rank files of dump file_number."""
+    pattern = '{0}.abun.r*.{1:05d}.h5'.format(basename, file_number)
+    files = glob.glob(pattern)
+    if not files:
+        raise IOError('no files match ' + pattern)
+    return sorted(files, key=lambda f: int(re.search(r'\.abun\.r(\d+)\.', f).group(1)))
+
+
+def decode(codes, threshold, dlog, dtype=np.float64):
+    """Turn 16-bit logarithmic codes back into mass fractions."""
+    codes = np.asarray(codes)
+    x = threshold * np.exp((codes.astype(dtype) - 1.0) * dlog)
+    x[codes == 0] = 0.0
+    return x
+
+
+def read_abundances(filename, species=None, dtype=np.float64):
+    """Read one dump.
+
+    filename may be a single rank file, or a (basename, file_number) tuple to read all
+    ranks. Returns a dict with 'Time', 'NumCycle', 'gid', 'x1f', 'x2f', 'x3f' (one row
+    per MeshBlock, sorted by gid) and one dense array X_<species> of shape
+    (nblocks, nx3, nx2, nx1) per species; cells below the threshold are zero. Dumps
+    written with hydro = true also give 'rho', 'vel1', 'vel2', 'vel3' and 'press'.
+    """
+    import h5py
+
+    if isinstance(filename, tuple):
+        files = abundance_files(*filename)
+    else:
+        files = [filename]
+
+    data = {}
+    gids, x1f, x2f, x3f, blocks = [], [], [], [], {}
+    for fname in files:
+        with h5py.File(fname, 'r') as f:
+            data['Time'] = f.attrs['Time']
+            data['NumCycle'] = f.attrs['NumCycle']
+            nx1, nx2, nx3 = f.attrs['MeshBlockSize']
+            precision, threshold, dlog = f.attrs['Quantization']
+            data['precision'] = precision
+            data['threshold'] = threshold
+            gid = f['gid'][:]
+            mask = f['mask'][:]
+            gids.append(gid)
+            x1f.append(f['x1f'][:])
+            x2f.append(f['x2f'][:])
+            x3f.append(f['x3f'][:])
+            for name in PRIM_NAMES:
+                if name in f:
+                    blocks.setdefault(name, []).append(f[name][:].astype(dtype))
+            names = [k for k in f.keys() if k.startswith('X_')]
+            for name in names:
+                if species is not None and name[2:] not in species:
+                    continue
+                codes = f[name][:]
+                dense = np.zeros((len(gid), nx3, nx2, nx1), dtype=dtype)
+                # blocks are stored in local order, only those with the mask bit set
+                present = np.flatnonzero(_species_mask(f, name, mask))
+                dense[present] = decode(codes, threshold, dlog, dtype)
+                blocks.setdefault(name, []).append(dense)
+
+    order = np.argsort(np.concatenate(gids))
+    data['gid'] = np.concatenate(gids)[order]
+    data['x1f'] = np.concatenate(x1f)[order]
+    data['x2f'] = np.concatenate(x2f)[order]
+    data['x3f'] = np.concatenate(x3f)[order]
+    nblocks = len(order)
+    for name, arrays in blocks.items():
+        # species missing from some rank files are zero on those ranks
+        if len(arrays) != len(files):
+            arrays = _fill_missing(files, name, arrays, dtype)
+        data[name] = np.concatenate(arrays)[order]
+        assert data[name].shape[0] == nblocks
+    return data
+
+
+def _species_mask(f, name, mask):
+    """Per-block mask column of species name; columns follow the network order given
+    by the SpeciesNames attribute."""
+    all_names = ['X_' + (n.decode() if isinstance(n, bytes) else n)
+                 for n in f.attrs['SpeciesNames']]
+    return mask[:, all_names.index(name)] != 0
+
+
+def _fill_missing(files, name, arrays, dtype):
+    """Insert zero blocks for rank files where species name was below threshold."""
+    import h5py
+    filled = []
+    it = iter(arrays)
+    for fname in files:
+        with h5py.File(fname, 'r') as f:
+            if name in f:
+                filled.append(next(it))
+            else:
+                nx1, nx2, nx3 = f.attrs['MeshBlockSize']
+                filled.append(np.zeros((f['gid'].shape[0], nx3, nx2, nx1), dtype=dtype))
+    return filled
@@ -0,0 +1,145 @@
+#ifndef CHEMISTRY_UTILS_SIMD_LANES_HPP_
+#define CHEMISTRY_UTILS_SIMD_LANES_HPP_
+//======================================================================================
+// Athena++ astrophysical MHD code
+// Copyright (C) 2014 James M. Stone  <jmstone@princeton.edu>
+// See LICENSE file for full public license information.
+//======================================================================================
+//! \file simd_lanes.hpp
+//  \brief W values of one scalar, one per cell, operated on together
+//
+//  Code written generically in the scalar type, like the rate kernels of the networks,
+//  evaluated with Lanes<W> computes W cells at once: every operation is a loop over
+//  the lanes that the compiler turns into vector instructions (the omp simd pragmas
+//  need -fopenmp-simd or -qopenmp-simd, and the vector exp() and log() a vector math
+//  library, SVML or libmvec with -ffast-math). Only the operations the rate code needs
+//  are provided. Comparisons are not: a kernel that branches on a value needs a lane
+//  version with both sides of the branch and a per-lane select.
+//
+//  BURN_LANES (default 8, one AVX-512 register of doubles) sets the width of the
+//  lockstep burn (<chemistry> burn_lockstep).
+//======================================================================================
+
+// C++ headers
+#include <cmath>  // exp(), log(), pow(), sqrt()
+
+// Athena++ headers
+#include "../../athena.hpp"
+
+#ifndef BURN_LANES
+#define BURN_LANES 8
+#endif
+
+//! \struct Lanes
+//  \brief values v[0..W-1] of W independent cells
+template <int W>
+struct Lanes {
+  Real v[W];
+  Lanes() = default;  // uninitialized, as a Real: scratch arrays cost nothing
+  Lanes(const Real a) {  // the same constant in every lane
+#pragma omp simd
+    for (int l=0; l<W; ++l) v[l] = a;
+  }
+
+  Lanes &operator+=(const Lanes &b) {
+#pragma omp simd
+    for (int l=0; l<W; ++l) v[l] += b.v[l];
+    return *this;
+  }
+  Lanes &operator-=(const Lanes &b) {
+#pragma omp simd
+    for (int l=0; l<W; ++l) v[l] -= b.v[l];
+    return *this;
+  }
+  Lanes &operator*=(const Lanes &b) {
+#pragma omp simd
+    for (int l=0; l<W; ++l) v[l] *= b.v[l];
+    return *this;
+  }
+  Lanes &operator*=(const Real b) {
+#pragma omp simd
+    for (int l=0; l<W; ++l) v[l] *= b;
+    return *this;
+  }
+};
+
+typedef Lanes<BURN_LANES> LaneReal;
+
+//number of cells one value of a scalar type stands for, for the flop counts
+template <typename T>
+struct LaneCount {static const int value = 1;};
+template <int W>
+struct LaneCount<Lanes<W> > {static const int value = W;};
+
+//elementwise arithmetic with another Lanes or a constant, and the math functions
+#define LANES_BINARY_OP(OP)                                                           \
+template <int W>                                                                      \
+inline Lanes<W> operator OP(const Lanes<W> &a, const Lanes<W> &b) {                   \
+  Lanes<W> c;                                                                         \
+  _Pragma("omp simd")                                                                 \
+  for (int l=0; l<W; ++l) c.v[l] = a.v[l] OP b.v[l];                                  \
+  return c;                                                                           \
+}                                                                                     \
+template <int W>                                                                      \
+inline Lanes<W> operator OP(const Lanes<W> &a, const Real b) {                        \
+  Lanes<W> c;                                                                         \
+  _Pragma("omp simd")                                                                 \
+  for (int l=0; l<W; ++l) c.v[l] = a.v[l] OP b;                                       \
+  return c;                                                                           \
+}                                                                                     \
+template <int W>                                                                      \
+inline Lanes<W> operator OP(const Real a, const Lanes<W> &b) {                        \
+  Lanes<W> c;                                                                         \
+  _Pragma("omp simd")                                                                 \
+  for (int l=0; l<W; ++l) c.v[l] = a OP b.v[l];                                       \
+  return c;                                                                           \
+}
+LANES_BINARY_OP(+)
+LANES_BINARY_OP(-)
+LANES_BINARY_OP(*)
+LANES_BINARY_OP(/)
+#undef LANES_BINARY_OP
+
+#define LANES_UNARY_FN(FN)                                                            \
+template <int W>                                                                      \
+inline Lanes<W> FN(const Lanes<W> &a) {                                               \
+  Lanes<W> c;                                                                         \
+  _Pragma("omp simd")                                                                 \
+  for (int l=0; l<W; ++l) c.v[l] = std::FN(a.v[l]);                                   \
+  return c;                                                                           \
+}
+LANES_UNARY_FN(exp)
+LANES_UNARY_FN(log)
+LANES_UNARY_FN(sqrt)
+#undef LANES_UNARY_FN
+
+template <int W>
+inline Lanes<W> operator-(const Lanes<W> &a) {
+  Lanes<W> c;
+#pragma omp simd
+  for (int l=0; l<W; ++l) c.v[l] = -a.v[l];
+  return c;
+}
+template <int W>
+inline Lanes<W> pow(const Lanes<W> &a, const Real p) {
+  Lanes<W> c;
+#pragma omp simd
+  for (int l=0; l<W; ++l) c.v[l] = std::pow(a.v[l], p);
+  return c;
+}
+template <int W>
+inline Lanes<W> fmax(const Real a, const Lanes<W> &b) {
+  Lanes<W> c;
+#pragma omp simd
+  for (int l=0; l<W; ++l) c.v[l] = (b.v[l] > a) ? b.v[l] : a;
+  return c;
+}
+template <int W>
+inline Lanes<W> fmin(const Real a, const Lanes<W> &b) {
+  Lanes<W> c;
+#pragma omp simd
+  for (int l=0; l<W; ++l) c.v[l] = (b.v[l] < a) ? b.v[l] : a;
+  return c;
+}
+
+#endif // CHEMISTRY_UTILS_SIMD_LANES_HPP_
@@ -0,0 +1,417 @@
+//======================================================================================
+// Athena++ astrophysical MHD code
+// Copyright (C) 2014 James M. Stone  <jmstone@princeton.edu>
+// See LICENSE file for full public license information.
+//======================================================================================
+//! \file tabulated_eos.cpp
+//  \brief implementation of the tabulated electron-ion-radiation EOS
+//======================================================================================
+
+// C++ headers
+#include <algorithm>  // std::min(), std::max()
+#include <cmath>      // std::exp(), std::log(), std::sqrt(), std::pow()
+#include <iostream>   // endl
+#include <limits>     // std::numeric_limits
+#include <sstream>    // stringstream
+#include <stdexcept>  // std::runtime_error()
+#include <string>     // string
+#include <vector>     // vector
+
+// Athena++ headers
+#include "../../athena.hpp"
+#include "../../parameter_input.hpp"
+#include "tabulated_eos.hpp"
+
+namespace {
+// physical constants, cgs
+const Real me = 9.1093837e-28;        // electron mass
+const Real cl = 2.99792458e10;        // speed of light
+const Real hp = 6.62607015e-27;       // Planck constant
+const Real kb = 1.380649e-16;         // Boltzmann constant
+const Real mu = 1.66053907e-24;       // atomic mass unit
+const Real arad = 7.5657e-15;         // radiation constant
+const Real ln10 = 2.302585092994046;
+// Newton iterations of the temperature inversion
+const int NEWTON_MAX = 50;
+// neutron mass and Boltzmann constant of the ideal gas of the networks
+const Real mn_ideal = 1.674920e-24;
+const Real kb_ideal = 1.380658e-16;
+
+// electron table of the networks, built by the first NetworkEOS that needs it
+TabulatedEOS network_table;
+
+// Simpson rule in t = sqrt(x) of the Fermi-Dirac integrands between x = a and x = b,
+// adding into I[0:3] the integrals of x^{1/2}, x^{3/2}, x^{5/2} times
+// sqrt(1 + beta x/2) f(x) and into dI[0:2] those of the first two times df/deta
+void FermiDiracSegment(const Real a, const Real b, const int n, const Real eta,
+                       const Real beta, Real I[3], Real dI[2]) {
+  const Real ta = std::sqrt(a), tb = std::sqrt(b);
+  const Real dt = (tb - ta)/n;
+  for (int m=0; m<=n; ++m) {
+    Real w = (m == 0 || m == n) ? 1.0 : ((m % 2) ? 4.0 : 2.0);
+    w *= dt/3.0;
+    const Real t = ta + m*dt;
+    const Real x = t*t;
+    //x^{1/2} dx = 2 t^2 dt, and so on
+    const Real g = 2.0*x*std::sqrt(1.0 + 0.5*beta*x);
+    const Real arg = x - eta;
+    Real f, df;
+    if (arg > 0.0) {
+      const Real ex = std::exp(-arg);
+      f = ex/(1.0 + ex);
+      df = f/(1.0 + ex);
+    } else {
+      const Real ex = std::exp(arg);
+      f = 1.0/(1.0 + ex);
+      df = f*ex/(1.0 + ex);
+    }
+    I[0] += w*g*f;
+    I[1] += w*g*x*f;
+    I[2] += w*g*x*x*f;
+    dI[0] += w*g*df;
+    dI[1] += w*g*x*df;
+  }
+}
+
+// cubic Hermite basis on [0,1] and its derivative
+void Hermite(const Real u, Real h[4], Real dh[4]) {
+  h[0] = (1.0 + 2.0*u)*(1.0 - u)*(1.0 - u);  // value at 0
+  h[1] = u*u*(3.0 - 2.0*u);                  // value at 1
+  h[2] = u*(1.0 - u)*(1.0 - u);              // slope at 0
+  h[3] = u*u*(u - 1.0);                      // slope at 1
+  dh[0] = 6.0*u*u - 6.0*u;
+  dh[1] = 6.0*u - 6.0*u*u;
+  dh[2] = 3.0*u*u - 4.0*u + 1.0;
+  dh[3] = 3.0*u*u - 2.0*u;
+}
+} // namespace
+
+TabulatedEOS::TabulatedEOS() : ye_(0.5), nrho_(0), ntemp_(0), lrho_min_(0.0),
+    ltemp_min_(0.0), dlrho_(1.0), dltemp_(1.0), temp_min_(0.0), temp_max_(0.0) {}
+
+//--------------------------------------------------------------------------------------
+//! \fn void TabulatedEOS::Build(ParameterInput *pin)
+//  \brief tabulate the electron energy and pressure
+
+void TabulatedEOS::Build(ParameterInput *pin) {
+  ye_ = pin->GetOrAddReal("chemistry", "eos_ye", 0.5);
+  const Real rho_min = pin->GetOrAddReal("chemistry", "eos_rho_min", 1.0e-2);
+  const Real rho_max = pin->GetOrAddReal("chemistry", "eos_rho_max", 1.0e11);
+  temp_min_ = pin->GetOrAddReal("chemistry", "eos_temp_min", 1.0e5);
+  temp_max_ = pin->GetOrAddReal("chemistry", "eos_temp_max", 3.0e10);
+  const int nrho_dec = pin->GetOrAddInteger("chemistry", "eos_rho_per_decade", 10);
+  const int ntemp_dec = pin->GetOrAddInteger("chemistry", "eos_temp_per_decade", 20);
+  if (rho_min <= 0.0 || rho_max <= rho_min || temp_min_ <= 0.0 || temp_max_ <= temp_min_
+      || nrho_dec < 1 || ntemp_dec < 1) {
+    std::stringstream msg;
+    msg << "### FATAL ERROR in TabulatedEOS::Build" << std::endl
+        << "invalid <chemistry> eos_* table range" << std::endl;
+    throw std::runtime_error(msg.str().c_str());
+  }
+  dlrho_ = 1.0/nrho_dec;
+  dltemp_ = 1.0/ntemp_dec;
+  lrho_min_ = std::log10(rho_min);
+  ltemp_min_ = std::log10(temp_min_);
+  nrho_ = static_cast<int>(std::ceil((std::log10(rho_max) - lrho_min_)/dlrho_)) + 1;
+  ntemp_ = static_cast<int>(std::ceil((std::log10(temp_max_) - ltemp_min_)/dltemp_)) + 1;
+  temp_max_ = std::pow(10.0, ltemp_min_ + (ntemp_ - 1)*dltemp_);
+
+  const int nnode = nrho_*ntemp_;
+  le_.resize(nnode);
+  lp_.resize(nnode);
+  const Real mc2 = me*cl*cl;
+  for (int i=0; i<nrho_; ++i) {
+    const Real rho = std::pow(10.0, lrho_min_ + i*dlrho_);
+    const Real ne_target = rho*ye_/mu;
+    //start from the degenerate or the non-degenerate limit at the lowest temperature,
+    //then warm-start from the previous temperature
+    Real eta;
+    {
+      const Real beta = kb*temp_min_/mc2;
+      const Real xf = hp/(me*cl)*std::pow(3.0*ne_target/(8.0*M_PI), 1.0/3.0);
+      const Real eta_deg = (std::sqrt(1.0 + xf*xf) - 1.0)/beta;
+      const Real lambda = hp/std::sqrt(2.0*M_PI*me*kb*temp_min_);
+      const Real eta_nd = std::log(0.5*ne_target*lambda*lambda*lambda);
+      eta = (eta_deg > 1.0) ? eta_deg : std::min(eta_nd, eta_deg);
+    }
+    for (int j=0; j<ntemp_; ++j) {
+      const Real temp = std::pow(10.0, ltemp_min_ + j*dltemp_);
+      const Real beta = kb*temp/mc2;
+      Real ne, dne, ee, pe;
+      //Newton iteration on log(ne) for the degeneracy parameter
+      int iter;
+      for (iter=0; iter<100; ++iter) {
+        ElectronGas(eta, beta, &ne, &dne, &ee, &pe);
+        Real g = std::log(ne/ne_target);
+        Real deta = -g*ne/dne;
+        deta = std::max(std::min(deta, std::max(10.0, 0.5*std::abs(eta))),
+                        -std::max(10.0, 0.5*std::abs(eta)));
+        eta += deta;
+        if (std::abs(g) < 1.0e-12 || std::abs(deta) < 1.0e-12*std::max(1.0, std::abs(eta)))
+          break;
+      }
+      if (iter == 100) {
+        std::stringstream msg;
+        msg << "### FATAL ERROR in TabulatedEOS::Build" << std::endl
+            << "no convergence for the degeneracy at rho = " << rho << ", T = "
+            << temp << std::endl;
+        throw std::runtime_error(msg.str().c_str());
+      }
+      ElectronGas(eta, beta, &ne, &dne, &ee, &pe);
+      le_[j*nrho_ + i] = std::log10(ee/rho);
+      lp_[j*nrho_ + i] = std::log10(pe);
+    }
+  }
+  Differentiate(le_, le_x_, le_y_, le_xy_);
+  Differentiate(lp_, lp_x_, lp_y_, lp_xy_);
+  return;
+}
+
+//--------------------------------------------------------------------------------------
+//! \fn void TabulatedEOS::ElectronGas(...)
+//  \brief number density, its derivative in eta, kinetic energy density and pressure
+//  of the electrons from the generalized Fermi-Dirac integrals
+
+void TabulatedEOS::ElectronGas(const Real eta, const Real beta, Real *ne,
+                               Real *dne_deta, Real *ee, Real *pe) const {
+  const Real mc = me*cl;
+  const Real kn = 8.0*M_PI*std::sqrt(2.0)*(mc/hp)*(mc/hp)*(mc/hp);
+  Real I[3] = {0.0, 0.0, 0.0};
+  Real dI[2] = {0.0, 0.0};
+  //the Fermi sea, where f = 1, and a window around the Fermi surface
+  const Real xs = std::max(0.0, eta - 40.0);
+  const Real xe = std::max(0.0, eta) + 60.0;
+  if (xs > 0.0) FermiDiracSegment(0.0, xs, 128, eta, beta, I, dI);
+  FermiDiracSegment(xs, xe, 512, eta, beta, I, dI);
+  const Real b32 = beta*std::sqrt(beta);
+  const Real b52 = beta*b32;
+  *ne = kn*b32*(I[0] + beta*I[1]);
+  *dne_deta = kn*b32*(dI[0] + beta*dI[1]);
+  *ee = kn*me*cl*cl*b52*(I[1] + beta*I[2]);
+  *pe = 2.0/3.0*kn*me*cl*cl*b52*(I[1] + 0.5*beta*I[2]);
+}
+
+//--------------------------------------------------------------------------------------
+//! \fn void TabulatedEOS::Differentiate(...)
+//  \brief node derivatives for the Hermite interpolation, by finite differences
+
+void TabulatedEOS::Differentiate(const std::vector<Real> &f, std::vector<Real> &fx,
+                                 std::vector<Real> &fy, std::vector<Real> &fxy) const {
+  fx.resize(f.size());
+  fy.resize(f.size());
+  fxy.resize(f.size());
+  for (int j=0; j<ntemp_; ++j) {
+    for (int i=0; i<nrho_; ++i) {
+      int il = std::max(i-1, 0), ir = std::min(i+1, nrho_-1);
+      fx[j*nrho_ + i] = (f[j*nrho_ + ir] - f[j*nrho_ + il])/((ir - il)*dlrho_);
+    }
+  }
+  for (int j=0; j<ntemp_; ++j) {
+    int jl = std::max(j-1, 0), jr = std::min(j+1, ntemp_-1);
+    for (int i=0; i<nrho_; ++i) {
+      fy[j*nrho_ + i] = (f[jr*nrho_ + i] - f[jl*nrho_ + i])/((jr - jl)*dltemp_);
+      fxy[j*nrho_ + i] = (fx[jr*nrho_ + i] - fx[jl*nrho_ + i])/((jr - jl)*dltemp_);
+    }
+  }
+}
+
+//--------------------------------------------------------------------------------------
+//! \fn void TabulatedEOS::Interpolate(...)
+//  \brief bicubic Hermite interpolation in (log10 rho, log10 T); rho and T are clamped
+//  to the table
+
+void TabulatedEOS::Interpolate(const std::vector<Real> &f, const std::vector<Real> &fx,
+                               const std::vector<Real> &fy, const std::vector<Real> &fxy,
+                               const Real rho, const Real temp, Real *val,
+                               Real *dval_dlt) const {
+  Real x = (std::log10(rho) - lrho_min_)/dlrho_;
+  Real y = (std::log10(temp) - ltemp_min_)/dltemp_;
+  bool clamped = false;
+  //written so that NaN arguments (a failed trial step of the burn) end up at the edge
+  //of the table instead of indexing out of it
+  x = (x > 0.0) ? std::min(x, static_cast<Real>(nrho_ - 1)) : 0.0;
+  if (!(y >= 0.0 && y <= ntemp_ - 1)) {
+    y = (y > 0.0) ? std::min(y, static_cast<Real>(ntemp_ - 1)) : 0.0;
+    clamped = true;
+  }
+  const int i = std::min(static_cast<int>(x), nrho_ - 2);
+  const int j = std::min(static_cast<int>(y), ntemp_ - 2);
+  Real hu[4], dhu[4], hv[4], dhv[4];
+  Hermite(x - i, hu, dhu);
+  Hermite(y - j, hv, dhv);
+  Real v = 0.0, dv = 0.0;
+  for (int b=0; b<2; ++b) {
+    for (int a=0; a<2; ++a) {
+      const int n = (j + b)*nrho_ + i + a;
+      const Real c0 = hu[a]*f[n] + dlrho_*hu[a+2]*fx[n];
+      const Real c1 = hu[a]*fy[n] + dlrho_*hu[a+2]*fxy[n];
+      v += hv[b]*c0 + dltemp_*hv[b+2]*c1;
+      dv += dhv[b]*c0 + dltemp_*dhv[b+2]*c1;
+    }
+  }
+  *val = v;
+  *dval_dlt = clamped ? 0.0 : dv/dltemp_;
+}
+
+//--------------------------------------------------------------------------------------
+//! \fn Real TabulatedEOS::InternalEnergy(const Real rho, const Real temp,
+//                                        const Real abar) const
+//  \brief specific internal energy, erg/g
+
+Real TabulatedEOS::InternalEnergy(const Real rho, const Real temp,
+                                  const Real abar) const {
+  Real le, dle;
+  Interpolate(le_, le_x_, le_y_, le_xy_, rho, temp, &le, &dle);
+  return std::pow(10.0, le) + 1.5*kb*temp/(abar*mu) + arad*SQR(SQR(temp))/rho;
+}
+
+//--------------------------------------------------------------------------------------
+//! \fn Real TabulatedEOS::Pressure(const Real rho, const Real temp,
+//                                  const Real abar) const
+//  \brief pressure, erg/cm3
+
+Real TabulatedEOS::Pressure(const Real rho, const Real temp, const Real abar) const {
+  Real lp, dlp;
+  Interpolate(lp_, lp_x_, lp_y_, lp_xy_, rho, temp, &lp, &dlp);
+  return std::pow(10.0, lp) + rho*kb*temp/(abar*mu) + arad*SQR(SQR(temp))/3.0;
+}
+
+//--------------------------------------------------------------------------------------
+//! \fn Real TabulatedEOS::SpecificHeat(const Real rho, const Real temp,
+//                                      const Real abar) const
+//  \brief de/dT at constant density, erg/g/K
+
+Real TabulatedEOS::SpecificHeat(const Real rho, const Real temp,
+                                const Real abar) const {
+  Real le, dle;
+  Interpolate(le_, le_x_, le_y_, le_xy_, rho, temp, &le, &dle);
+  //dle = d log10 e/d log10 T of the electrons
+  return (std::pow(10.0, le)*dle + 1.5*kb*temp/(abar*mu)
+          + 4.0*arad*SQR(SQR(temp))/rho)/temp;
+}
+
+//--------------------------------------------------------------------------------------
+//! \fn Real TabulatedEOS::Temperature(const Real rho, const Real eint,
+//                                     const Real abar, const Real tguess) const
+//  \brief invert e(rho, T) by Newton iteration in log T. The energy is monotonic in T;
+//  if eint is outside the range of the table the nearest table temperature is returned.
+//  NaN if the iteration has not converged after NEWTON_MAX steps.
+
+Real TabulatedEOS::Temperature(const Real rho, const Real eint, const Real abar,
+                               const Real tguess) const {
+  Real temp = tguess;
+  if (!(temp > 0.0)) {
+    //non-degenerate ions and electrons
+    temp = eint/(1.5*kb/mu*(1.0/abar + ye_));
+  }
+  temp = std::max(std::min(temp, temp_max_), temp_min_);
+  const Real ion = 1.5*kb/(abar*mu);
+  const Real rad = arad/rho;
+  for (int iter=0; iter<NEWTON_MAX; ++iter) {
+    Real le, dle;
+    Interpolate(le_, le_x_, le_y_, le_xy_, rho, temp, &le, &dle);
+    const Real eele = std::pow(10.0, le);
+    const Real eion = ion*temp;
+    const Real erad = rad*SQR(SQR(temp));
+    const Real res = eele + eion + erad - eint;
+    //d e/d ln T
+    const Real de = eele*dle + eion + 4.0*erad;
+    Real dlnt = -res/de;
+    dlnt = std::max(std::min(dlnt, static_cast<Real>(1.0)), static_cast<Real>(-1.0));
+    Real tnew = temp*std::exp(dlnt);
+    if (tnew <= temp_min_ || tnew >= temp_max_) {
+      tnew = std::max(std::min(tnew, temp_max_), temp_min_);
+      if (tnew == temp) return temp;
+    }
+    temp = tnew;
+    if (std::abs(dlnt) < 1.0e-10) return temp;
+  }
+  //not converged: no temperature rather than a wrong one
+  return std::numeric_limits<Real>::quiet_NaN();
+}
+
+//--------------------------------------------------------------------------------------
+//! \fn NetworkEOS::NetworkEOS()
+//  \brief ideal gas of gamma = 5/3 in cgs until Init
+
+NetworkEOS::NetworkEOS() : table_(false), gm1_(2.0/3.0), unit_E_(1.0),
+    abar_empty_(1.0) {}
+
+//--------------------------------------------------------------------------------------
+//! \fn void NetworkEOS::Init(ParameterInput *pin, const Real unit_E_in_cgs,
+//                            const Real abar_empty)
+//  \brief select the ideal gas or the table with <chemistry> eos
+
+void NetworkEOS::Init(ParameterInput *pin, const Real unit_E_in_cgs,
+                      const Real abar_empty) {
+  //the EOS of the hydro is not constructed yet, read gamma from the input
+  gm1_ = pin->GetOrAddReal("hydro", "gamma", 5.0/3.0) - 1.0;
+  unit_E_ = unit_E_in_cgs;
+  abar_empty_ = abar_empty;
+  std::string eos = pin->GetOrAddString("chemistry", "eos", "ideal");
+  if (eos == "table") {
+    table_ = true;
+  } else if (eos == "ideal") {
+    table_ = false;
+  } else {
+    std::stringstream msg;
+    msg << "### FATAL ERROR in NetworkEOS::Init" << std::endl
+        << "<chemistry> eos = " << eos << " unknown, use ideal or table" << std::endl;
+    throw std::runtime_error(msg.str().c_str());
+  }
+  if (table_ && !network_table.IsBuilt()) {
+    network_table.Build(pin);
+  }
+  return;
+}
+
+//--------------------------------------------------------------------------------------
+//! \fn Real NetworkEOS::MeanMassNumber(const Real y[NSCALARS]) const
+//  \brief 1/sum(y) of the positive abundances per nucleon
+
+Real NetworkEOS::MeanMassNumber(const Real y[NSCALARS]) const {
+  Real ysum = 0.0;
+  for (int k=0; k<NSCALARS; ++k) {
+    ysum += (y[k] > 0.0) ? y[k] : 0.0;
+  }
+  return (ysum > 0.0) ? 1.0/ysum : abar_empty_;
+}
+
+//--------------------------------------------------------------------------------------
+//! \fn Real NetworkEOS::Temperature(const Real rho, const Real ED,
+//                                   const Real y[NSCALARS], const Real tguess) const
+//  \brief temperature from the energy density
+
+Real NetworkEOS::Temperature(const Real rho, const Real ED, const Real y[NSCALARS],
+                             const Real tguess) const {
+  if (!table_) {
+    return ED*unit_E_*gm1_*mn_ideal/(rho*kb_ideal);
+  }
+  return network_table.Temperature(rho, ED*unit_E_/rho, MeanMassNumber(y), tguess);
+}
+
+//--------------------------------------------------------------------------------------
+//! \fn Real NetworkEOS::SpecificHeat(const Real rho, const Real temp,
+//                                    const Real y[NSCALARS]) const
+//  \brief de/dT at constant density, erg/g/K
+
+Real NetworkEOS::SpecificHeat(const Real rho, const Real temp,
+                              const Real y[NSCALARS]) const {
+  if (!table_) {
+    return kb_ideal/(gm1_*mn_ideal);
+  }
+  return network_table.SpecificHeat(rho, temp, MeanMassNumber(y));
+}
+
+//--------------------------------------------------------------------------------------
+//! \fn Real NetworkEOS::InternalEnergyDensity(const Real rho, const Real temp,
+//                                             const Real y[NSCALARS]) const
+//  \brief energy density in code units
+
+Real NetworkEOS::InternalEnergyDensity(const Real rho, const Real temp,
+                                       const Real y[NSCALARS]) const {
+  if (!table_) {
+    return rho*kb_ideal*temp/(gm1_*mn_ideal*unit_E_);
+  }
+  return rho*network_table.InternalEnergy(rho, temp, MeanMassNumber(y))/unit_E_;
+}
@@ -0,0 +1,107 @@
+#ifndef CHEMISTRY_UTILS_TABULATED_EOS_HPP_
+#define CHEMISTRY_UTILS_TABULATED_EOS_HPP_
+//======================================================================================
+// Athena++ astrophysical MHD code
+// Copyright (C) 2014 James M. Stone  <jmstone@princeton.edu>
+// See LICENSE file for full public license information.
+//======================================================================================
+//! \file tabulated_eos.hpp
+//  \brief electron-ion-radiation equation of state for the nuclear burn
+//
+//  The electrons are an ideal Fermi gas of arbitrary degeneracy and relativity (pairs
+//  are neglected). Their specific energy and pressure depend only on rho*ye and T, and
+//  are tabulated at startup on a grid uniform in (log10 rho, log10 T) by solving for
+//  the degeneracy parameter and integrating the Fermi-Dirac integrals. Lookups use
+//  bicubic Hermite interpolation of log10 e and log10 p. Ions (ideal gas of mean mass
+//  number abar) and radiation are added analytically, so the table is independent of
+//  the composition for a fixed ye. Outside the table rho and T are clamped to its
+//  edges for the electron part.
+//
+//  NetworkEOS is the EOS of the nuclear networks inside the burn, <chemistry> eos: the
+//  ideal gas of <hydro> gamma, or the table with the mean mass number of the
+//  abundances. Both alpha13 and nucnet delegate their Temperature, SpecificHeat and
+//  InternalEnergyDensity to it.
+//======================================================================================
+
+// C++ headers
+#include <vector>    // vector
+
+// Athena++ headers
+#include "../../athena.hpp"
+
+class ParameterInput;
+
+//! \class TabulatedEOS
+//  \brief tabulated electron EOS plus analytic ions and radiation, all in cgs
+class TabulatedEOS {
+ public:
+  TabulatedEOS();
+  //build the electron table from the <chemistry> eos_* parameters
+  void Build(ParameterInput *pin);
+  bool IsBuilt() const {return nrho_ > 0;}
+
+  //specific internal energy (erg/g) and pressure (erg/cm3)
+  Real InternalEnergy(const Real rho, const Real temp, const Real abar) const;
+  Real Pressure(const Real rho, const Real temp, const Real abar) const;
+  //specific heat at constant volume de/dT (erg/g/K)
+  Real SpecificHeat(const Real rho, const Real temp, const Real abar) const;
+  //temperature (K) with the specific internal energy eint (erg/g), by Newton
+  //iteration starting from tguess (no guess if tguess <= 0); NaN if it does not
+  //converge, which the coupled burn treats as a failed step
+  Real Temperature(const Real rho, const Real eint, const Real abar,
+                   const Real tguess) const;
+
+ private:
+  Real ye_;                       // electrons per nucleon
+  int nrho_, ntemp_;
+  Real lrho_min_, ltemp_min_;     // log10 of the first grid point
+  Real dlrho_, dltemp_;           // grid spacing in log10
+  Real temp_min_, temp_max_;
+  //log10 of electron energy and pressure, and their derivatives in log10 rho (x) and
+  //log10 T (y), stored as (ntemp, nrho)
+  std::vector<Real> le_, le_x_, le_y_, le_xy_;
+  std::vector<Real> lp_, lp_x_, lp_y_, lp_xy_;
+
+  //electron number density, kinetic energy density and pressure from the Fermi-Dirac
+  //integrals at degeneracy parameter eta and beta = kT/(me c^2)
+  void ElectronGas(const Real eta, const Real beta, Real *ne, Real *dne_deta,
+                   Real *ee, Real *pe) const;
+  //log10 e (or p) of the electrons and its derivative in log10 T
+  void Interpolate(const std::vector<Real> &f, const std::vector<Real> &fx,
+                   const std::vector<Real> &fy, const std::vector<Real> &fxy,
+                   const Real rho, const Real temp, Real *val, Real *dval_dlt) const;
+  void Differentiate(const std::vector<Real> &f, std::vector<Real> &fx,
+                     std::vector<Real> &fy, std::vector<Real> &fxy) const;
+};
+
+//! \class NetworkEOS
+//  \brief EOS of a nuclear network: densities in g/cm3, energy densities in code units
+//  of unit_E erg/cm3, y the NSCALARS abundances per nucleon
+class NetworkEOS {
+ public:
+  NetworkEOS();
+  //read <chemistry> eos and build the table, shared by every network, on first use.
+  //abar_empty is the mean mass number taken if every abundance is zero
+  void Init(ParameterInput *pin, const Real unit_E_in_cgs, const Real abar_empty);
+  bool IsTable() const {return table_;}
+
+  //temperature (K); with the table, tguess > 0 starts the inversion, and NaN if
+  //the inversion does not converge
+  Real Temperature(const Real rho, const Real ED, const Real y[NSCALARS],
+                   const Real tguess) const;
+  //specific heat de/dT (erg/g/K) at constant density
+  Real SpecificHeat(const Real rho, const Real temp, const Real y[NSCALARS]) const;
+  //energy density (code units), the inverse of Temperature()
+  Real InternalEnergyDensity(const Real rho, const Real temp,
+                             const Real y[NSCALARS]) const;
+
+ private:
+  bool table_;       // tabulated EOS, else the ideal gas
+  Real gm1_;         // adiabatic gamma - 1 of the ideal gas, <hydro> gamma
+  Real unit_E_;      // unit of energy density, erg/cm3
+  Real abar_empty_;  // mean mass number without abundances
+
+  Real MeanMassNumber(const Real y[NSCALARS]) const;
+};
+
+#endif // CHEMISTRY_UTILS_TABULATED_EOS_HPP_
@@ -0,0 +1,318 @@
+//======================================================================================
+// Athena++ astrophysical MHD code
+// Copyright (C) 2014 James M. Stone  <jmstone@princeton.edu>
+// See LICENSE file for full public license information.
+//======================================================================================
+//! \file tracer_burn.cpp
+//  \brief implementation of the network burns along tracer histories
+//======================================================================================
+
+// C headers
+#include <stdio.h>    // fopen(), fread(), fwrite()
+
+// C++ headers
+#include <algorithm>  // std::max(), std::min()
+#include <cmath>      // std::log(), std::exp(), std::ceil()
+#include <cstdint>    // std::int32_t, std::int64_t
+#include <cstring>    // std::memcmp()
+#include <limits>     // quiet_NaN()
+#include <sstream>    // stringstream
+#include <stdexcept>  // std::runtime_error()
+#include <vector>     // vector
+
+// Athena++ headers
+#include "../../athena.hpp"
+#include "../../parameter_input.hpp"
+#include "../../scalars/scalars.hpp"
+#include "burn_arena.hpp"
+#include "burn_integrator.hpp"
+#include "tracer_burn.hpp"
+
+#ifdef OPENMP_PARALLEL
+#include <omp.h>
+#endif
+
+namespace {
+const char HIST_MAGIC[8] = {'T', 'R', 'C', 'H', 'I', 'S', 'T', '1'};
+const char BURN_MAGIC[8] = {'T', 'R', 'C', 'B', 'U', 'R', 'N', '1'};
+
+//one history as it is read from and written to the files
+struct Record {
+  std::int64_t id;
+  std::int32_t npts;
+};
+
+bool ReadRecord(FILE *fp, const std::string &fname, Record *rec,
+                std::vector<Real> *y0, std::vector<Real> *t, std::vector<Real> *rho,
+                std::vector<Real> *temp);
+void ReadDoubles(FILE *fp, const std::string &fname, const int n,
+                 std::vector<Real> *v);
+void WriteDoubles(FILE *fp, const Real *v, const int n);
+} // namespace
+
+TracerBurn::TracerBurn(ParameterInput *pin) {
+  nsample_ = pin->GetOrAddInteger("tracer_burn", "nsample", 0);
+  dlog_max_ = pin->GetOrAddReal("tracer_burn", "dlog_max", 0.002);
+  nchunk_ = pin->GetOrAddInteger("tracer_burn", "nchunk", 4096);
+  nthreads_ = pin->GetOrAddInteger("tracer_burn", "nthreads",
+                                   pin->GetOrAddInteger("mesh", "num_threads", 1));
+  if (nsample_ < 0) nsample_ = 0;
+  if (nchunk_ < 1) nchunk_ = 1;
+  if (nthreads_ < 1) nthreads_ = 1;
+  if (!(dlog_max_ > 0.0)) {
+    std::stringstream msg;
+    msg << "### FATAL ERROR in TracerBurn constructor" << std::endl
+        << "<tracer_burn> dlog_max must be positive" << std::endl;
+    throw std::runtime_error(msg.str().c_str());
+  }
+  //the network and the solver of the simulation, without a MeshBlock
+  pnet_ = new ChemNetwork(nullptr, pin);
+  pburn_ = new BurnIntegrator(pnet_, nullptr, pin);
+  arenas_ = new BurnArena[nthreads_];
+  for (int t=0; t<nthreads_; ++t) arenas_[t].Reserve(pburn_->ArenaBytes());
+}
+
+TracerBurn::~TracerBurn() {
+  delete[] arenas_;
+  delete pburn_;
+  delete pnet_;
+}
+
+Real TracerBurn::SampleTime(const int s, const Real t0, const Real t1) const {
+  if (s >= nsample_ - 1) return t1;
+  return t0 + (t1 - t0)*s/(nsample_ - 1);
+}
+
+//--------------------------------------------------------------------------------------
+//! \fn int TracerBurn::BurnHistory(const int npts, const Real *t, const Real *rho,
+//                                  const Real *temp, Real y[NSCALARS], Real *ysample,
+//                                  BurnArena *arena)
+//  \brief burn along one history, cut at its points and at the sample times
+
+int TracerBurn::BurnHistory(const int npts, const Real *t, const Real *rho,
+                            const Real *temp, Real y[NSCALARS], Real *ysample,
+                            BurnArena *arena) {
+  const int nbuf = (ysample != nullptr) ? nsample_ : 0;
+  for (int s=0; s<nbuf*NSCALARS; ++s) {
+    ysample[s] = std::numeric_limits<Real>::quiet_NaN();
+  }
+  if (npts < 1) return -1;
+  for (int n=0; n<npts; ++n) {
+    if (!(rho[n] > 0.0) || !(temp[n] > 0.0) || (n > 0 && !(t[n] >= t[n-1]))) return -1;
+  }
+  Real yb[BurnIntegrator::NBURN];
+  for (int m=0; m<NSCALARS; ++m) yb[m] = y[m];
+  yb[NSCALARS] = 1.0;
+  const Real t0 = t[0], t1 = t[npts-1];
+  Real h = 0.0;
+  bool stiff = false;
+  int nstep = 0;
+  int s = 0;
+  while (s < nbuf && SampleTime(s, t0, t1) <= t0) {
+    for (int m=0; m<NSCALARS; ++m) ysample[s*NSCALARS + m] = yb[m];
+    s++;
+  }
+  for (int n=0; n<npts-1; ++n) {
+    if (!(t[n+1] > t[n])) continue;
+    const Real lr0 = std::log(rho[n]), dlr = std::log(rho[n+1]) - lr0;
+    const Real lt0 = std::log(temp[n]), dlt = std::log(temp[n+1]) - lt0;
+    const Real dtn_inv = 1.0/(t[n+1] - t[n]);
+    Real ta = t[n];
+    while (ta < t[n+1]) {
+      //up to the next point or sample, in steps of at most dlog_max in ln rho, ln T
+      Real tb = t[n+1];
+      if (s < nbuf) tb = std::min(tb, SampleTime(s, t0, t1));
+      const Real fa = (ta - t[n])*dtn_inv, fb = (tb - t[n])*dtn_inv;
+      const Real dlog = std::max(std::abs(dlr), std::abs(dlt))*(fb - fa);
+      const int nsub = std::max(1, static_cast<int>(std::ceil(dlog/dlog_max_)));
+      const Real dt = (tb - ta)/nsub;
+      for (int k=0; k<nsub; ++k) {
+        const Real fm = fa + (k + 0.5)*(fb - fa)/nsub;
+        const Real rho_m = std::exp(lr0 + fm*dlr);
+        Real temp_m = std::exp(lt0 + fm*dlt);
+        Real y0[BurnIntegrator::NBURN];
+        for (int m=0; m<BurnIntegrator::NBURN; ++m) y0[m] = yb[m];
+        int ns = pburn_->IntegrateCell(rho_m, 0.0, dt, yb, &h, &temp_m, &stiff,
+                                       arena);
+        if (ns < 0) {
+          std::stringstream where;
+          where << "tracer history at t = " << ta + k*dt;
+          ns = pburn_->RecoverCell(where.str(), rho_m, 0.0, dt, y0, yb, &h, &temp_m,
+                                   &stiff, arena);
+        }
+        if (ns < 0) {
+          for (int m=0; m<NSCALARS; ++m) y[m] = yb[m];
+          return -1;
+        }
+        nstep += ns;
+      }
+      ta = tb;
+      while (s < nbuf && SampleTime(s, t0, t1) <= ta) {
+        for (int m=0; m<NSCALARS; ++m) ysample[s*NSCALARS + m] = yb[m];
+        s++;
+      }
+    }
+  }
+  for (int m=0; m<NSCALARS; ++m) y[m] = yb[m];
+  for (; s<nbuf; ++s) {
+    for (int m=0; m<NSCALARS; ++m) ysample[s*NSCALARS + m] = yb[m];
+  }
+  return nstep;
+}
+
+//--------------------------------------------------------------------------------------
+//! \fn int TracerBurn::BurnHistories(const int nhist, const long *offset,
+//                                    const Real *t, const Real *rho, const Real *temp,
+//                                    Real *y, Real *ysample, int *status)
+//  \brief independent histories, dealt to the threads one by one since their costs
+//  differ by orders of magnitude
+
+int TracerBurn::BurnHistories(const int nhist, const long *offset, const Real *t,
+                              const Real *rho, const Real *temp, Real *y,
+                              Real *ysample, int *status) {
+  int nfail = 0;
+#pragma omp parallel for num_threads(nthreads_) schedule(dynamic, 1) reduction(+:nfail)
+  for (int h=0; h<nhist; ++h) {
+    int tid = 0;
+#ifdef OPENMP_PARALLEL
+    tid = omp_get_thread_num();
+#endif
+    const long p = offset[h];
+    const int npts = static_cast<int>(offset[h+1] - p);
+    Real *ys = (ysample != nullptr) ? &ysample[static_cast<long>(h)*nsample_*NSCALARS]
+                                    : nullptr;
+    status[h] = BurnHistory(npts, &t[p], &rho[p], &temp[p], &y[h*NSCALARS], ys,
+                            &arenas_[tid]);
+    if (status[h] < 0) nfail++;
+  }
+  return nfail;
+}
+
+//--------------------------------------------------------------------------------------
+//! \fn long TracerBurn::BurnFile(const std::string fin, const std::string fout,
+//                                long *nfail)
+//  \brief read nchunk histories, burn them over the threads, write them, and so on
+
+long TracerBurn::BurnFile(const std::string fin, const std::string fout, long *nfail) {
+  FILE *fp_in = fopen(fin.c_str(), "rb");
+  if (fp_in == nullptr) {
+    std::stringstream msg;
+    msg << "### FATAL ERROR in TracerBurn::BurnFile" << std::endl
+        << "Unable to open tracer histories " << fin << std::endl;
+    throw std::runtime_error(msg.str().c_str());
+  }
+  char magic[8];
+  std::int32_t nspec = 0;
+  if (fread(magic, 1, 8, fp_in) != 8 || std::memcmp(magic, HIST_MAGIC, 8) != 0
+      || fread(&nspec, sizeof(nspec), 1, fp_in) != 1 || nspec != NSCALARS) {
+    fclose(fp_in);
+    std::stringstream msg;
+    msg << "### FATAL ERROR in TracerBurn::BurnFile" << std::endl
+        << fin << " is not a file of tracer histories of " << NSCALARS << " species"
+        << std::endl;
+    throw std::runtime_error(msg.str().c_str());
+  }
+  FILE *fp_out = fopen(fout.c_str(), "wb");
+  if (fp_out == nullptr) {
+    fclose(fp_in);
+    std::stringstream msg;
+    msg << "### FATAL ERROR in TracerBurn::BurnFile" << std::endl
+        << "Unable to open output file " << fout << std::endl;
+    throw std::runtime_error(msg.str().c_str());
+  }
+  std::int32_t nsample = nsample_;
+  fwrite(BURN_MAGIC, 1, 8, fp_out);
+  fwrite(&nspec, sizeof(nspec), 1, fp_out);
+  fwrite(&nsample, sizeof(nsample), 1, fp_out);
+
+  std::vector<Record> rec;
+  std::vector<long> offset;
+  std::vector<Real> t, rho, temp, y, ysample, tsample(nsample_);
+  std::vector<int> status;
+  long ntotal = 0;
+  *nfail = 0;
+  bool more = true;
+  while (more) {
+    //read the next chunk
+    rec.clear();
+    offset.assign(1, 0);
+    t.clear();
+    rho.clear();
+    temp.clear();
+    y.clear();
+    Record r;
+    while (static_cast<int>(rec.size()) < nchunk_
+           && (more = ReadRecord(fp_in, fin, &r, &y, &t, &rho, &temp))) {
+      rec.push_back(r);
+      offset.push_back(static_cast<long>(t.size()));
+    }
+    const int nhist = static_cast<int>(rec.size());
+    if (nhist == 0) break;
+    ysample.assign(static_cast<std::size_t>(nhist)*nsample_*NSCALARS, 0.0);
+    status.assign(nhist, 0);
+    *nfail += BurnHistories(nhist, offset.data(), t.data(), rho.data(), temp.data(),
+                            y.data(), ysample.data(), status.data());
+    //write it in the order of the input
+    for (int h=0; h<nhist; ++h) {
+      std::int32_t st = status[h];
+      fwrite(&rec[h].id, sizeof(rec[h].id), 1, fp_out);
+      fwrite(&st, sizeof(st), 1, fp_out);
+      const Real ta = t[offset[h]], tb = t[offset[h+1] - 1];
+      for (int s=0; s<nsample_; ++s) tsample[s] = SampleTime(s, ta, tb);
+      WriteDoubles(fp_out, tsample.data(), nsample_);
+      WriteDoubles(fp_out, &y[h*NSCALARS], NSCALARS);
+      WriteDoubles(fp_out, &ysample[static_cast<long>(h)*nsample_*NSCALARS],
+                   nsample_*NSCALARS);
+    }
+    ntotal += nhist;
+  }
+  fclose(fp_in);
+  if (fclose(fp_out) != 0) {
+    std::stringstream msg;
+    msg << "### FATAL ERROR in TracerBurn::BurnFile" << std::endl
+        << "Error writing " << fout << std::endl;
+    throw std::runtime_error(msg.str().c_str());
+  }
+  return ntotal;
+}
+
+namespace {
+//! \fn bool ReadRecord(FILE *fp, const std::string &fname, Record *rec, ...)
+//  \brief append the next history of fp to y0, t, rho and temp; false at the end of
+//  the file
+bool ReadRecord(FILE *fp, const std::string &fname, Record *rec,
+                std::vector<Real> *y0, std::vector<Real> *t, std::vector<Real> *rho,
+                std::vector<Real> *temp) {
+  if (fread(&rec->id, sizeof(rec->id), 1, fp) != 1) return false;
+  if (fread(&rec->npts, sizeof(rec->npts), 1, fp) != 1 || rec->npts < 1) {
+    std::stringstream msg;
+    msg << "### FATAL ERROR in TracerBurn::BurnFile" << std::endl
+        << "Bad record of tracer " << rec->id << " in " << fname << std::endl;
+    throw std::runtime_error(msg.str().c_str());
+  }
+  ReadDoubles(fp, fname, NSCALARS, y0);
+  ReadDoubles(fp, fname, rec->npts, t);
+  ReadDoubles(fp, fname, rec->npts, rho);
+  ReadDoubles(fp, fname, rec->npts, temp);
+  return true;
+}
+
+void ReadDoubles(FILE *fp, const std::string &fname, const int n,
+                 std::vector<Real> *v) {
+  std::vector<double> buf(n);
+  if (fread(buf.data(), sizeof(double), n, fp) != static_cast<std::size_t>(n)) {
+    std::stringstream msg;
+    msg << "### FATAL ERROR in TracerBurn::BurnFile" << std::endl
+        << "Unexpected end of " << fname << std::endl;
+    throw std::runtime_error(msg.str().c_str());
+  }
+  v->insert(v->end(), buf.begin(), buf.end());
+  return;
+}
+
+void WriteDoubles(FILE *fp, const Real *v, const int n) {
+  std::vector<double> buf(v, v + n);
+  fwrite(buf.data(), sizeof(double), n, fp);
+  return;
+}
+} // namespace
@@ -0,0 +1,90 @@
+#ifndef CHEMISTRY_UTILS_TRACER_BURN_HPP_
+#define CHEMISTRY_UTILS_TRACER_BURN_HPP_
+//======================================================================================
+// Athena++ astrophysical MHD code
+// Copyright (C) 2014 James M. Stone  <jmstone@princeton.edu>
+// See LICENSE file for full public license information.
+//======================================================================================
+//! \file tracer_burn.hpp
+//  \brief nucleosynthesis post-processing: the network burned along given (t, rho, T)
+//  histories of tracers, outside the mesh
+//
+//  A history is a list of points (t, rho, T) in s, g/cm3 and K. Between two points
+//  ln rho and ln T are linear in t. The abundances are integrated with the solver of
+//  the coupled burn (BurnIntegrator::IntegrateCell) at the prescribed temperature, in
+//  steps over which ln rho and ln T change by at most <tracer_burn> dlog_max, with
+//  density and temperature held at their values in the middle of the step. Near
+//  equilibrium (silicon burning, NSE) the composition follows the frozen temperature
+//  within a step, so the error is first order in dlog_max, about 0.3 dlog_max in the
+//  mass fractions of hot histories. Besides the final abundances a history returns
+//  nsample samples evenly spaced in time over its span, the first at its start and
+//  the last at its end.
+//
+//  Histories are independent and are spread over <tracer_burn> nthreads threads. The
+//  network, its tables and the solver settings (<chemistry> burn_reltol, ...) are the
+//  ones of the simulation. BurnFile() streams histories from a binary file to another,
+//  nchunk at a time, so that memory does not grow with the number of tracers. All
+//  values are native-endian; every record of the input is
+//
+//    int64 id, int32 npts, float64 y0[NSCALARS], t[npts], rho[npts], T[npts]
+//
+//  after the header "TRCHIST1" and int32 NSCALARS. The output has the header
+//  "TRCBURN1", int32 NSCALARS, int32 nsample and for each input record
+//
+//    int64 id, int32 status (solver steps, -1 on failure), float64 tsample[nsample],
+//    y[NSCALARS], ysample[nsample][NSCALARS]
+//
+//  with the abundances (mole fractions) at the end, or where the burn failed, and NaN
+//  for the samples after a failure.
+//======================================================================================
+
+// C++ headers
+#include <string>  // string
+
+// Athena++ headers
+#include "../../athena.hpp"
+
+class BurnArena;
+class BurnIntegrator;
+class ChemNetwork;
+class ParameterInput;
+
+//! \class TracerBurn
+//  \brief burns of tracer histories, configured by <tracer_burn>
+class TracerBurn {
+ public:
+  explicit TracerBurn(ParameterInput *pin);
+  ~TracerBurn();
+
+  //burn one history of npts points from the abundances y at t[0]; y returns the
+  //abundances at t[npts-1], and ysample[s*NSCALARS + n] (if not nullptr) those at the
+  //sample times. Returns the number of solver steps, or -1 on failure. The solver
+  //scratch comes from arena, or with nullptr from the integrator's own (one thread).
+  int BurnHistory(const int npts, const Real *t, const Real *rho, const Real *temp,
+                  Real y[NSCALARS], Real *ysample, BurnArena *arena=nullptr);
+  //burn nhist histories over the threads. History h has the points offset[h] to
+  //offset[h+1]-1 of t, rho and temp, starts from y[h*NSCALARS], and has its samples
+  //at ysample[h*nsample*NSCALARS] and its return value in status[h]. Returns the
+  //number of failed histories.
+  int BurnHistories(const int nhist, const long *offset, const Real *t, const Real *rho,
+                    const Real *temp, Real *y, Real *ysample, int *status);
+  //burn every history of the file fin and write the results to fout; returns the
+  //number of histories, and the failed ones in nfail
+  long BurnFile(const std::string fin, const std::string fout, long *nfail);
+
+  //samples per history, <tracer_burn> nsample
+  int NSample() const {return nsample_;}
+  //time of sample s of a history from t0 to t1
+  Real SampleTime(const int s, const Real t0, const Real t1) const;
+
+ private:
+  ChemNetwork *pnet_;
+  BurnIntegrator *pburn_;
+  int nsample_;    // abundance samples per history
+  Real dlog_max_;  // largest change of ln rho or ln T over one burn step
+  int nchunk_;     // histories per chunk of BurnFile
+  int nthreads_;
+  BurnArena *arenas_;  // solver scratch, one per thread
+};
+
+#endif // CHEMISTRY_UTILS_TRACER_BURN_HPP_
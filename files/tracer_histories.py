@@ -0,0 +1,107 @@
+"""
+Read tracer particle records, write tracer histories for, and read the results of,
+TracerBurn (tracer_burn.hpp).
+
+read_tracers() reads the files written by TracerParticles (tracer_particles.hpp) and
+histories() turns them into the input of write_histories(), which writes the (t, rho,
+T) histories and initial abundances of a set of tracers to the binary input of
+TracerBurn::BurnFile(); read_burn() reads its output.
+"""
+
+# Python modules
+import numpy as np
+
+PART_MAGIC = b'TRCPART1'
+HIST_MAGIC = b'TRCHIST1'
+BURN_MAGIC = b'TRCBURN1'
+
+
+def read_tracers(filenames):
+    """Read the records of TracerParticles from the per-rank files filenames.
+
+    Returns a dict of arrays sorted by tracer id, then time: 'id', 't', 'rho', 'T' and
+    'Edot' of shape (nrecord,), 'x' (nrecord, 3) and, if recorded, 'y' (nrecord,
+    nspecies) the mole fractions; and 'dvol', the volume per tracer at seeding. Of
+    records with the same id and time, as after a restart from an earlier dump, one is
+    kept.
+    """
+    if isinstance(filenames, str):
+        filenames = [filenames]
+    parts = []
+    dvol = None
+    for filename in filenames:
+        with open(filename, 'rb') as f:
+            data = f.read()
+        if data[:8] != PART_MAGIC:
+            raise IOError(filename + ' is not a TracerParticles file')
+        nspecies, nabund = np.frombuffer(data, dtype=np.int32, count=2, offset=8)
+        dvol = np.frombuffer(data, dtype=np.float64, count=1, offset=16)[0]
+        fields = [('id', '=i8'), ('t', '=f8'), ('x', '=f8', (3,)), ('rho', '=f8'),
+                  ('T', '=f8'), ('Edot', '=f8')]
+        if nabund > 0:
+            fields.append(('y', '=f8', (nabund,)))
+        parts.append(np.frombuffer(data, dtype=np.dtype(fields), offset=24))
+    rec = np.concatenate(parts)
+    rec = rec[np.lexsort((rec['t'], rec['id']))]
+    keep = np.ones(rec.size, dtype=bool)
+    keep[1:] = (rec['id'][1:] != rec['id'][:-1]) | (rec['t'][1:] != rec['t'][:-1])
+    rec = rec[keep]
+    out = {name: rec[name] for name in rec.dtype.names}
+    out['dvol'] = dvol
+    return out
+
+
+def histories(tracers, y0=None):
+    """Split the records of read_tracers() into the histories of write_histories().
+
+    The initial mole fractions are those of the first record of each tracer if the
+    abundances were recorded, else y0.
+    """
+    ids, first = np.unique(tracers['id'], return_index=True)
+    last = np.append(first[1:], tracers['id'].size)
+    for tid, i0, i1 in zip(ids, first, last):
+        y = tracers['y'][i0] if 'y' in tracers else y0
+        yield (tid, y, tracers['t'][i0:i1], tracers['rho'][i0:i1], tracers['T'][i0:i1])
+
+
+def write_histories(filename, histories, nspecies=13):
+    """Write tracer histories.
+
+    histories is an iterable of (id, y0, t, rho, T): an integer id, the initial mole
+    fractions y0 (nspecies values) and the history, three arrays of equal length in
+    s, g/cm^3 and K with t non-decreasing.
+    """
+    with open(filename, 'wb') as f:
+        f.write(HIST_MAGIC)
+        f.write(np.int32(nspecies).tobytes())
+        for tid, y0, t, rho, temp in histories:
+            t = np.asarray(t, dtype=np.float64)
+            rho = np.asarray(rho, dtype=np.float64)
+            temp = np.asarray(temp, dtype=np.float64)
+            y0 = np.asarray(y0, dtype=np.float64)
+            if y0.shape != (nspecies,) or not t.shape == rho.shape == temp.shape:
+                raise ValueError('bad history of tracer {0}'.format(tid))
+            f.write(np.int64(tid).tobytes())
+            f.write(np.int32(t.size).tobytes())
+            for a in (y0, t, rho, temp):
+                f.write(a.tobytes())
+
+
+def read_burn(filename):
+    """Read the output of TracerBurn::BurnFile().
+
+    Returns a dict with 'id' and 'status' (solver steps, -1 where the burn failed) of
+    shape (ntracer,), 'y' (ntracer, nspecies) the final mole fractions, and 'tsample'
+    (ntracer, nsample) and 'ysample' (ntracer, nsample, nspecies) the samples.
+    """
+    with open(filename, 'rb') as f:
+        data = f.read()
+    if data[:8] != BURN_MAGIC:
+        raise IOError(filename + ' is not a TracerBurn output file')
+    nspecies, nsample = np.frombuffer(data, dtype=np.int32, count=2, offset=8)
+    rec = np.dtype([('id', '=i8'), ('status', '=i4'),
+                    ('tsample', '=f8', (nsample,)), ('y', '=f8', (nspecies,)),
+                    ('ysample', '=f8', (nsample, nspecies))])
+    out = np.frombuffer(data, dtype=rec, offset=16)
+    return {'id': out['id'], 'status': out['status'], 'tsample': out['tsample'],
+            'y': out['y'], 'ysample': out['ysample']}
@@ -0,0 +1,846 @@
+//======================================================================================
+// Athena++ astrophysical MHD code
+// Copyright (C) 2014 James M. Stone  <jmstone@princeton.edu>
+// See LICENSE file for full public license information.
+//======================================================================================
+//! \file tracer_particles.cpp
+//  \brief Lagrangian tracer particles recording burn histories, see
+//  tracer_particles.hpp for the method and the file format
+//======================================================================================
+
+// C headers
+#include <stdint.h>   // int64_t
+#include <stdio.h>    // fopen(), fwrite()
+#include <string.h>   // memcpy()
+
+// C++ headers
+#include <algorithm>  // std::min(), std::max()
+#include <cmath>      // std::floor(), std::ceil()
+#include <iomanip>    // setw, setfill
+#include <iostream>   // cout, endl
+#include <sstream>    // stringstream
+#include <stdexcept>  // std::runtime_error()
+#include <string>     // string
+#include <vector>     // vector
+
+// Athena++ headers
+#include "../athena.hpp"
+#include "../athena_arrays.hpp"
+#include "../coordinates/coordinates.hpp"
+#include "../eos/eos.hpp"
+#include "../globals.hpp"
+#include "../hydro/hydro.hpp"
+#include "../mesh/mesh.hpp"
+#include "../parameter_input.hpp"
+#include "../scalars/scalars.hpp"
+#include "burn_trigger.hpp"
+#include "tracer_particles.hpp"
+
+#ifdef MPI_PARALLEL
+#include <mpi.h>
+#endif
+
+#ifdef INCLUDE_CHEMISTRY
+
+namespace {
+// what happens to a tracer crossing a mesh face
+enum {BC_PERIODIC, BC_REFLECT, BC_OPEN};
+bool Inside(const Real *bb, const Real x[3], const bool active[3]);
+void Bracket(const AthenaArray<Real> &xv, int il, int iu, const Real x, int *i,
+             Real *f);
+int Cell(const AthenaArray<Real> &xf, int il, int iu, const Real x);
+} // namespace
+
+//--------------------------------------------------------------------------------------
+// TracerParticles constructor
+
+TracerParticles::TracerParticles(Mesh *pm, ParameterInput *pin) :
+    pin_(pin), initialized_(false), ptrigger_(nullptr), fp_(nullptr), head_(0),
+    tail_(0), flush_(false), stop_(false) {
+  if (std::string(COORDINATE_SYSTEM) != "cartesian") {
+    std::stringstream msg;
+    msg << "### FATAL ERROR in TracerParticles constructor" << std::endl
+        << "<tracer_particles> supports cartesian coordinates only" << std::endl;
+    throw std::runtime_error(msg.str().c_str());
+  }
+  basename_ = pin->GetString("job", "problem_id");
+  dt = pin->GetOrAddReal("tracer_particles", "dt", 0.0);
+  next_time = pin->GetOrAddReal("tracer_particles", "next_time", pm->time);
+  nlat_[0] = pin->GetInteger("tracer_particles", "nx1");
+  nlat_[1] = pin->GetOrAddInteger("tracer_particles", "nx2", 1);
+  nlat_[2] = pin->GetOrAddInteger("tracer_particles", "nx3", 1);
+  box_[0] = pin->GetOrAddReal("tracer_particles", "x1min", pm->mesh_size.x1min);
+  box_[1] = pin->GetOrAddReal("tracer_particles", "x2min", pm->mesh_size.x2min);
+  box_[2] = pin->GetOrAddReal("tracer_particles", "x3min", pm->mesh_size.x3min);
+  box_[3] = pin->GetOrAddReal("tracer_particles", "x1max", pm->mesh_size.x1max);
+  box_[4] = pin->GetOrAddReal("tracer_particles", "x2max", pm->mesh_size.x2max);
+  box_[5] = pin->GetOrAddReal("tracer_particles", "x3max", pm->mesh_size.x3max);
+  abund_ = pin->GetOrAddBoolean("tracer_particles", "abundances", false);
+  async_ = pin->GetOrAddBoolean("tracer_particles", "async", false);
+  const Real buffer_mb = pin->GetOrAddReal("tracer_particles", "buffer_mb", 32.0);
+  const Real batch_mb = pin->GetOrAddReal("tracer_particles", "batch_mb", 8.0);
+  std::string trigger = pin->GetOrAddString("tracer_particles", "trigger", "time");
+  if (trigger == "burn") {
+    ptrigger_ = new BurnTrigger(pin, "tracer_particles");
+  } else if (trigger != "time") {
+    std::stringstream msg;
+    msg << "### FATAL ERROR in TracerParticles constructor" << std::endl
+        << "<tracer_particles> trigger = " << trigger << " is not time or burn"
+        << std::endl;
+    throw std::runtime_error(msg.str().c_str());
+  }
+
+  mesh_[0] = pm->mesh_size.x1min;
+  mesh_[1] = pm->mesh_size.x2min;
+  mesh_[2] = pm->mesh_size.x3min;
+  mesh_[3] = pm->mesh_size.x1max;
+  mesh_[4] = pm->mesh_size.x2max;
+  mesh_[5] = pm->mesh_size.x3max;
+  const char *bc_names[6] = {"ix1_bc", "ox1_bc", "ix2_bc", "ox2_bc", "ix3_bc", "ox3_bc"};
+  for (int n=0; n<6; ++n) {
+    std::string bc = pin->GetOrAddString("mesh", bc_names[n], "outflow");
+    bc_[n] = (bc == "periodic") ? BC_PERIODIC : (bc == "reflecting") ? BC_REFLECT
+             : BC_OPEN;
+  }
+  active_[0] = (pm->mesh_size.nx1 > 1);
+  active_[1] = (pm->mesh_size.nx2 > 1);
+  active_[2] = (pm->mesh_size.nx3 > 1);
+  //one lattice point along directions without cells
+  for (int d=0; d<3; ++d) {
+    if (!active_[d]) nlat_[d] = 1;
+  }
+  for (int n=0; n<4; ++n) layout_[n] = -1;
+
+  rec_size_ = sizeof(int64_t) + (7 + (abund_ ? NSCALARS : 0))*sizeof(double);
+  ring_nrec_ = std::max(static_cast<std::size_t>(buffer_mb*1048576.0/rec_size_),
+                        static_cast<std::size_t>(1));
+  batch_nrec_ = std::max(static_cast<std::size_t>(batch_mb*1048576.0/rec_size_),
+                         static_cast<std::size_t>(1));
+  batch_nrec_ = std::min(batch_nrec_, ring_nrec_);
+  ring_.resize(ring_nrec_*rec_size_);
+
+  //a restart, from a dump with tracers seeded, appends to the files of the run
+  std::stringstream fname;
+  fname << basename_ << ".tracers.r" << std::setw(5) << std::setfill('0')
+        << Globals::my_rank << ".bin";
+  const bool restart = pin->DoesParameterExist("tracer_particles", "nseed");
+  nseed_ = restart ? pin->GetInteger("tracer_particles", "nseed") : 0;
+  fp_ = fopen(fname.str().c_str(), restart ? "ab" : "wb");
+  if (fp_ == nullptr) {
+    std::stringstream msg;
+    msg << "### FATAL ERROR in TracerParticles constructor" << std::endl
+        << "Unable to open " << fname.str() << std::endl;
+    throw std::runtime_error(msg.str().c_str());
+  }
+  fseek(fp_, 0, SEEK_END);
+  if (ftell(fp_) == 0) {
+    int32_t nscalars = NSCALARS, nabund = abund_ ? NSCALARS : 0;
+    double dvol = 1.0;
+    for (int d=0; d<3; ++d) {
+      if (active_[d]) dvol *= (box_[d+3] - box_[d])/nlat_[d];
+    }
+    fwrite("TRCPART1", 1, 8, fp_);
+    fwrite(&nscalars, sizeof(int32_t), 1, fp_);
+    fwrite(&nabund, sizeof(int32_t), 1, fp_);
+    fwrite(&dvol, sizeof(double), 1, fp_);
+  }
+  if (async_) {
+    io_thread_ = std::thread(&TracerParticles::IOThreadLoop, this);
+  }
+}
+
+// destructor: write everything still buffered, then stop the I/O thread
+
+TracerParticles::~TracerParticles() {
+  if (async_) {
+    {
+      std::lock_guard<std::mutex> lock(mtx_);
+      stop_ = true;
+    }
+    cv_.notify_all();
+    io_thread_.join();
+  } else if (io_error_.empty()) {
+    try {
+      Drain();
+    } catch (std::exception &ex) {
+      std::cout << "### WARNING in TracerParticles destructor" << std::endl
+                << ex.what() << std::endl;
+    }
+  }
+  if (fp_ != nullptr) fclose(fp_);
+  delete ptrigger_;
+}
+
+//--------------------------------------------------------------------------------------
+//! \fn void TracerParticles::Update(Mesh *pm)
+//  \brief advance the tracers from pm->time to pm->time + pm->dt and record them
+
+void TracerParticles::Update(Mesh *pm) {
+  //tracers whose MeshBlock has moved to another rank go there first
+  if (UpdateLayout(pm)) Migrate(pm);
+  Real h = pm->dt;
+  if (!initialized_) {
+    initialized_ = true;
+    //a restart reads the tracers back from the state of its dump
+    if (nseed_ == 0 || !ReadState(pm)) {
+      //Mesh::UserWorkInLoop() is first called after a step; seeding from the state at
+      //its end only delays the tracers by one step
+      Seed(pm);
+      h = 0.0;
+    }
+  }
+
+  if (h > 0.0) {
+    for (std::size_t n=0; n<part_.size(); ++n) {
+      TracerParticle &p = part_[n];
+      MeshBlock *pmb = pm->my_blocks(p.lb);
+      //predictor with the old velocity, corrector with the mean of the old one and the
+      //one at the predicted position; the ghost zones of the old MeshBlock cover the
+      //predicted position since a step moves the gas by less than a cell
+      Real xp[3], vp[3];
+      for (int d=0; d<3; ++d) xp[d] = p.x[d] + h*p.v[d];
+      Velocity(pmb, xp, vp);
+      for (int d=0; d<3; ++d) p.x[d] += 0.5*h*(p.v[d] + vp[d]);
+      if (!ApplyBoundaries(p.x)) {
+        p.lb = -2;  // left the mesh
+        continue;
+      }
+      p.lb = LocalBlock(pm, p.x, p.lb);
+      if (p.lb >= 0) Velocity(pm->my_blocks(p.lb), p.x, p.v);
+    }
+  }
+  Migrate(pm);
+
+  const Real time = pm->time + pm->dt;
+  if (time >= next_time || (ptrigger_ != nullptr && ptrigger_->Due(pm, time))) {
+    Record(pm, time);
+    if (ptrigger_ != nullptr) {
+      //the longest interval counts from the last record, whatever made it
+      ptrigger_->Mark(pm, time);
+      next_time = time + dt;
+    } else {
+      next_time += dt;
+      //keep next_time ahead of the current time if dt is smaller than the time step
+      if (dt > 0.0 && next_time <= time) {
+        next_time += dt*std::floor((time - next_time)/dt + 1.0);
+      } else if (dt <= 0.0) {
+        next_time = time;
+      }
+    }
+    //stored in the input so that restarts continue the sequence
+    pin_->SetReal("tracer_particles", "next_time", next_time);
+  }
+
+  //a restart dump written at the end of this step gets the tracers as they are now
+  const int nrst = RestartNumber(pm, time, pm->ncycle + 1, false);
+  if (nrst >= 0) WriteState(pm, time, nrst);
+  return;
+}
+
+//--------------------------------------------------------------------------------------
+//! \fn void TracerParticles::Finalize(Mesh *pm)
+//  \brief write every buffered record, then the state file of the final restart dump
+
+void TracerParticles::Finalize(Mesh *pm) {
+  if (async_) {
+    std::unique_lock<std::mutex> lock(mtx_);
+    flush_ = true;
+    cv_.notify_all();
+    cv_.wait(lock, [this] {return head_ == tail_ || !io_error_.empty();});
+    if (!io_error_.empty()) throw std::runtime_error(io_error_.c_str());
+  } else {
+    Drain();
+  }
+  fflush(fp_);
+  const int nrst = RestartNumber(pm, pm->time, pm->ncycle, true);
+  if (nrst >= 0) WriteState(pm, pm->time, nrst);
+
+  long count[2] = {nlocal(), static_cast<long>(head_)};
+#ifdef MPI_PARALLEL
+  MPI_Allreduce(MPI_IN_PLACE, count, 2, MPI_LONG, MPI_SUM, MPI_COMM_WORLD);
+#endif
+  if (Globals::my_rank == 0) {
+    std::cout << "tracer particles: " << count[0] << " in the mesh, " << count[1]
+              << " records written" << std::endl;
+  }
+  return;
+}
+
+//--------------------------------------------------------------------------------------
+//! \fn void TracerParticles::Seed(Mesh *pm)
+//  \brief place the tracers of the lattice points inside the local MeshBlocks
+
+void TracerParticles::Seed(Mesh *pm) {
+  const int64_t id0 = nseed_*(nlat_[0]*static_cast<int64_t>(nlat_[1])*nlat_[2]);
+  Real dx[3];
+  for (int d=0; d<3; ++d) dx[d] = (box_[d+3] - box_[d])/nlat_[d];
+  for (int b=0; b<pm->nblocal; ++b) {
+    MeshBlock *pmb = pm->my_blocks(b);
+    const RegionSize &bs = pmb->block_size;
+    const Real bb[6] = {bs.x1min, bs.x2min, bs.x3min, bs.x1max, bs.x2max, bs.x3max};
+    //range of lattice indices that can fall in the block, checked one by one below
+    int il[3], iu[3];
+    for (int d=0; d<3; ++d) {
+      il[d] = std::max(static_cast<int>(std::floor((bb[d] - box_[d])/dx[d])), 0);
+      iu[d] = std::min(static_cast<int>(std::ceil((bb[d+3] - box_[d])/dx[d])),
+                       nlat_[d] - 1);
+      if (!active_[d]) il[d] = iu[d] = 0;
+    }
+    for (int k=il[2]; k<=iu[2]; ++k) {
+      for (int j=il[1]; j<=iu[1]; ++j) {
+        for (int i=il[0]; i<=iu[0]; ++i) {
+          TracerParticle p;
+          p.id = id0 + i + nlat_[0]*(j + static_cast<int64_t>(nlat_[1])*k);
+          p.x[0] = box_[0] + (i + 0.5)*dx[0];
+          p.x[1] = box_[1] + (j + 0.5)*dx[1];
+          p.x[2] = box_[2] + (k + 0.5)*dx[2];
+          if (!Inside(bb, p.x, active_)) continue;
+          p.lb = b;
+          Velocity(pmb, p.x, p.v);
+          part_.push_back(p);
+        }
+      }
+    }
+  }
+  //stored in the input so that a restart knows the tracers have been seeded
+  nseed_++;
+  pin_->SetInteger("tracer_particles", "nseed", nseed_);
+  return;
+}
+
+//--------------------------------------------------------------------------------------
+//! \fn void TracerParticles::WriteState(Mesh *pm, const Real time,
+//                                        const int file_number)
+//  \brief gather the tracers on rank 0 and write them, at time, to the state file of
+//  restart dump file_number
+
+void TracerParticles::WriteState(Mesh *pm, const Real time, const int file_number) {
+  const int nbytes = static_cast<int>(part_.size()*sizeof(TracerParticle));
+  std::vector<TracerParticle> all;
+#ifdef MPI_PARALLEL
+  std::vector<int> counts(Globals::nranks), displs(Globals::nranks, 0);
+  MPI_Gather(&nbytes, 1, MPI_INT, &counts[0], 1, MPI_INT, 0, MPI_COMM_WORLD);
+  if (Globals::my_rank == 0) {
+    for (int r=1; r<Globals::nranks; ++r) displs[r] = displs[r-1] + counts[r-1];
+    all.resize((displs.back() + counts.back())/sizeof(TracerParticle));
+  }
+  MPI_Gatherv(part_.data(), nbytes, MPI_BYTE, all.data(), &counts[0], &displs[0],
+              MPI_BYTE, 0, MPI_COMM_WORLD);
+#else
+  all = part_;
+#endif
+  std::stringstream fname;
+  fname << basename_ << ".tracers." << std::setw(5) << std::setfill('0')
+        << file_number << ".state";
+  //read back by a restart from the dump, which stores the input after this
+  pin_->SetString("tracer_particles", "state_file", fname.str());
+  if (Globals::my_rank != 0) return;
+
+  FILE *fp = fopen(fname.str().c_str(), "wb");
+  if (fp == nullptr) {
+    std::stringstream msg;
+    msg << "### FATAL ERROR in TracerParticles::WriteState" << std::endl
+        << "Unable to create " << fname.str() << std::endl;
+    throw std::runtime_error(msg.str().c_str());
+  }
+  double dtime = time;
+  int64_t npart = all.size();
+  fwrite("TRCSTAT1", 1, 8, fp);
+  fwrite(&dtime, sizeof(double), 1, fp);
+  fwrite(&npart, sizeof(int64_t), 1, fp);
+  for (const TracerParticle &p : all) {
+    double xv[6] = {p.x[0], p.x[1], p.x[2], p.v[0], p.v[1], p.v[2]};
+    fwrite(&p.id, sizeof(int64_t), 1, fp);
+    fwrite(xv, sizeof(double), 6, fp);
+  }
+  fclose(fp);
+  return;
+}
+
+//--------------------------------------------------------------------------------------
+//! \fn bool TracerParticles::ReadState(Mesh *pm)
+//  \brief keep the tracers of the state file of the restart dump that are inside the
+//  local MeshBlocks. Returns false, with a warning and no tracers, if there is no state
+//  at the time of the dump, as after a dump the tracers did not know of.
+
+bool TracerParticles::ReadState(Mesh *pm) {
+  std::string fname;
+  if (pin_->DoesParameterExist("tracer_particles", "state_file")) {
+    fname = pin_->GetString("tracer_particles", "state_file");
+  }
+  FILE *fp = fname.empty() ? nullptr : fopen(fname.c_str(), "rb");
+  char magic[8];
+  double time = 0.0;
+  int64_t npart = 0;
+  bool ok = (fp != nullptr && fread(magic, 1, 8, fp) == 8
+             && std::string(magic, 8) == "TRCSTAT1"
+             && fread(&time, sizeof(double), 1, fp) == 1
+             && fread(&npart, sizeof(int64_t), 1, fp) == 1
+             && std::abs(time - pm->time) <= 1.0e-10*std::abs(time));
+  for (int64_t n=0; ok && n<npart; ++n) {
+    TracerParticle p;
+    double xv[6];
+    ok = (fread(&p.id, sizeof(int64_t), 1, fp) == 1
+          && fread(xv, sizeof(double), 6, fp) == 6);
+    if (!ok) break;
+    for (int d=0; d<3; ++d) {
+      p.x[d] = xv[d];
+      p.v[d] = xv[d+3];
+    }
+    p.lb = LocalBlock(pm, p.x, -1);
+    if (p.lb >= 0) part_.push_back(p);
+  }
+  if (fp != nullptr) fclose(fp);
+  if (!ok) {
+    part_.clear();
+    if (Globals::my_rank == 0) {
+      std::cout << "### WARNING in TracerParticles::ReadState" << std::endl
+                << "No tracers at t = " << pm->time << " in '" << fname
+                << "'; the tracers are seeded again, with new ids" << std::endl;
+    }
+  }
+  return ok;
+}
+
+//--------------------------------------------------------------------------------------
+//! \fn int TracerParticles::RestartNumber(Mesh *pm, const Real time, const int ncycle,
+//                                          const bool final)
+//  \brief number of the restart dump that Outputs::MakeOutputs writes at the end of the
+//  step to time and cycle ncycle (with final, at the end of the run), -1 if none. A
+//  dump is due by dt, by dcycle or at tlim; its <outputN> block holds the number it is
+//  written with until then.
+
+int TracerParticles::RestartNumber(Mesh *pm, const Real time, const int ncycle,
+                                   const bool final) {
+  for (InputBlock *pib = pin_->pfirst_block; pib != nullptr; pib = pib->pnext) {
+    const std::string &block = pib->block_name;
+    if (block.compare(0, 6, "output") != 0
+        || pin_->GetOrAddString(block, "file_type", "") != "rst") continue;
+    bool due = final || time >= pm->tlim;
+    if (pin_->GetOrAddReal(block, "dt", -1.0) > 0.0) {
+      due = due || time >= pin_->GetOrAddReal(block, "next_time", pm->time);
+    }
+    if (pin_->DoesParameterExist(block, "dcycle")) {
+      const int dcycle = pin_->GetInteger(block, "dcycle");
+      due = due || (dcycle > 0 && ncycle % dcycle == 0);
+    }
+    if (due) return pin_->GetOrAddInteger(block, "file_number", 0);
+  }
+  return -1;
+}
+
+//--------------------------------------------------------------------------------------
+//! \fn bool TracerParticles::UpdateLayout(Mesh *pm)
+//  \brief gather the extents and ranks of all MeshBlocks if the layout has changed
+//  (first call, refinement or load balancing); returns whether it has
+
+bool TracerParticles::UpdateLayout(Mesh *pm) {
+  int key[4] = {pm->nbtotal, pm->nblocal, -1, -1};
+  if (pm->nblocal > 0) {
+    key[2] = pm->my_blocks(0)->gid;
+    key[3] = pm->my_blocks(pm->nblocal-1)->gid;
+  }
+  int changed = 0;
+  for (int n=0; n<4; ++n) {
+    if (key[n] != layout_[n]) changed = 1;
+    layout_[n] = key[n];
+  }
+#ifdef MPI_PARALLEL
+  MPI_Allreduce(MPI_IN_PLACE, &changed, 1, MPI_INT, MPI_MAX, MPI_COMM_WORLD);
+#endif
+  if (!changed) return false;
+
+  //gid and extents of every local block
+  std::vector<Real> mine(7*pm->nblocal);
+  for (int b=0; b<pm->nblocal; ++b) {
+    MeshBlock *pmb = pm->my_blocks(b);
+    const RegionSize &bs = pmb->block_size;
+    Real *pv = &mine[7*b];
+    pv[0] = pmb->gid;
+    pv[1] = bs.x1min;
+    pv[2] = bs.x2min;
+    pv[3] = bs.x3min;
+    pv[4] = bs.x1max;
+    pv[5] = bs.x2max;
+    pv[6] = bs.x3max;
+  }
+  std::vector<Real> all;
+  std::vector<int> counts(Globals::nranks, 7*pm->nblocal);
+  std::vector<int> displs(Globals::nranks, 0);
+#ifdef MPI_PARALLEL
+  int mycount = 7*pm->nblocal;
+  MPI_Allgather(&mycount, 1, MPI_INT, &counts[0], 1, MPI_INT, MPI_COMM_WORLD);
+  for (int r=1; r<Globals::nranks; ++r) displs[r] = displs[r-1] + counts[r-1];
+  all.resize(displs.back() + counts.back());
+  MPI_Allgatherv(mine.data(), mycount, MPI_ATHENA_REAL, all.data(), &counts[0],
+                 &displs[0], MPI_ATHENA_REAL, MPI_COMM_WORLD);
+#else
+  all = mine;
+#endif
+  bbox_.assign(6*pm->nbtotal, 0.0);
+  brank_.assign(pm->nbtotal, -1);
+  for (int r=0; r<Globals::nranks; ++r) {
+    for (int m=displs[r]; m<displs[r]+counts[r]; m+=7) {
+      int gid = static_cast<int>(all[m]);
+      for (int n=0; n<6; ++n) bbox_[6*gid+n] = all[m+1+n];
+      brank_[gid] = r;
+    }
+  }
+  //local block indices may have changed
+  for (std::size_t n=0; n<part_.size(); ++n) {
+    part_[n].lb = LocalBlock(pm, part_[n].x, -1);
+  }
+  return true;
+}
+
+//--------------------------------------------------------------------------------------
+//! \fn int TracerParticles::LocalBlock(Mesh *pm, const Real x[3], int hint) const
+//  \brief index in my_blocks of the MeshBlock holding x, starting with hint, or -1
+
+int TracerParticles::LocalBlock(Mesh *pm, const Real x[3], int hint) const {
+  for (int m=-1; m<pm->nblocal; ++m) {
+    int b = (m < 0) ? hint : m;
+    if (b < 0 || (m >= 0 && b == hint)) continue;
+    const RegionSize &bs = pm->my_blocks(b)->block_size;
+    const Real bb[6] = {bs.x1min, bs.x2min, bs.x3min, bs.x1max, bs.x2max, bs.x3max};
+    if (Inside(bb, x, active_)) return b;
+  }
+  return -1;
+}
+
+//--------------------------------------------------------------------------------------
+//! \fn int TracerParticles::OwnerRank(const Real x[3]) const
+//  \brief rank of the MeshBlock holding x, or -1 if none does
+
+int TracerParticles::OwnerRank(const Real x[3]) const {
+  for (std::size_t b=0; b<brank_.size(); ++b) {
+    if (Inside(&bbox_[6*b], x, active_)) return brank_[b];
+  }
+  return -1;
+}
+
+//--------------------------------------------------------------------------------------
+//! \fn bool TracerParticles::ApplyBoundaries(Real x[3]) const
+//  \brief map x back into the mesh across periodic and reflecting faces; false if the
+//  tracer has left the mesh
+
+bool TracerParticles::ApplyBoundaries(Real x[3]) const {
+  for (int d=0; d<3; ++d) {
+    if (!active_[d]) continue;
+    const Real xmin = mesh_[d], xmax = mesh_[d+3];
+    if (x[d] < xmin) {
+      if (bc_[2*d] == BC_PERIODIC) {
+        x[d] += xmax - xmin;
+      } else if (bc_[2*d] == BC_REFLECT) {
+        x[d] = 2.0*xmin - x[d];
+      } else {
+        return false;
+      }
+    } else if (x[d] >= xmax) {
+      if (bc_[2*d+1] == BC_PERIODIC) {
+        x[d] -= xmax - xmin;
+      } else if (bc_[2*d+1] == BC_REFLECT) {
+        x[d] = 2.0*xmax - x[d];
+      } else {
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+//--------------------------------------------------------------------------------------
+//! \fn void TracerParticles::Velocity(MeshBlock *pmb, const Real x[3], Real v[3]) const
+//  \brief gas velocity at x, trilinear between the cell centers of pmb and its ghost
+//  zones; zero along directions without cells
+
+void TracerParticles::Velocity(MeshBlock *pmb, const Real x[3], Real v[3]) const {
+  int i = pmb->is, j = pmb->js, k = pmb->ks;
+  Real f[3] = {0.0, 0.0, 0.0};
+  Coordinates *pco = pmb->pcoord;
+  if (active_[0]) Bracket(pco->x1v, pmb->is-1, pmb->ie+1, x[0], &i, &f[0]);
+  if (active_[1]) Bracket(pco->x2v, pmb->js-1, pmb->je+1, x[1], &j, &f[1]);
+  if (active_[2]) Bracket(pco->x3v, pmb->ks-1, pmb->ke+1, x[2], &k, &f[2]);
+  const int ni = active_[0] ? 2 : 1, nj = active_[1] ? 2 : 1, nk = active_[2] ? 2 : 1;
+  const AthenaArray<Real> &w = pmb->phydro->w;
+  for (int d=0; d<3; ++d) {
+    v[d] = 0.0;
+    if (!active_[d]) continue;
+    for (int dk=0; dk<nk; ++dk) {
+      for (int dj=0; dj<nj; ++dj) {
+        for (int di=0; di<ni; ++di) {
+          Real wgt = (dk ? f[2] : 1.0 - f[2])*(dj ? f[1] : 1.0 - f[1])
+                     *(di ? f[0] : 1.0 - f[0]);
+          v[d] += wgt*w(IVX+d, k+dk, j+dj, i+di);
+        }
+      }
+    }
+  }
+  return;
+}
+
+//--------------------------------------------------------------------------------------
+//! \fn void TracerParticles::Migrate(Mesh *pm)
+//  \brief send the tracers no longer in a local MeshBlock to the rank that holds them,
+//  and drop the ones that have left the mesh
+
+void TracerParticles::Migrate(Mesh *pm) {
+  std::vector<TracerParticle> stay, leave;
+  std::vector<int> dest;
+  for (const TracerParticle &p : part_) {
+    if (p.lb >= 0) {
+      stay.push_back(p);
+    } else if (p.lb == -1) {
+      int r = OwnerRank(p.x);
+      if (r >= 0 && r != Globals::my_rank) {
+        leave.push_back(p);
+        dest.push_back(r);
+      }
+    }
+  }
+#ifdef MPI_PARALLEL
+  const int nranks = Globals::nranks;
+  std::vector<int> scount(nranks, 0), rcount(nranks), sdispl(nranks, 0),
+      rdispl(nranks, 0);
+  for (std::size_t n=0; n<leave.size(); ++n) scount[dest[n]] += sizeof(TracerParticle);
+  for (int r=1; r<nranks; ++r) sdispl[r] = sdispl[r-1] + scount[r-1];
+  std::vector<TracerParticle> sendbuf(leave.size());
+  std::vector<int> pos(sdispl);
+  for (std::size_t n=0; n<leave.size(); ++n) {
+    sendbuf[pos[dest[n]]/sizeof(TracerParticle)] = leave[n];
+    pos[dest[n]] += sizeof(TracerParticle);
+  }
+  MPI_Alltoall(&scount[0], 1, MPI_INT, &rcount[0], 1, MPI_INT, MPI_COMM_WORLD);
+  for (int r=1; r<nranks; ++r) rdispl[r] = rdispl[r-1] + rcount[r-1];
+  std::vector<TracerParticle> recvbuf((rdispl.back() + rcount.back())
+                                      /sizeof(TracerParticle));
+  MPI_Alltoallv(sendbuf.data(), &scount[0], &sdispl[0], MPI_BYTE, recvbuf.data(),
+                &rcount[0], &rdispl[0], MPI_BYTE, MPI_COMM_WORLD);
+  for (TracerParticle &p : recvbuf) {
+    p.lb = LocalBlock(pm, p.x, -1);
+    if (p.lb < 0) continue;
+    Velocity(pm->my_blocks(p.lb), p.x, p.v);
+    stay.push_back(p);
+  }
+#endif
+  part_.swap(stay);
+  return;
+}
+
+//--------------------------------------------------------------------------------------
+//! \fn void TracerParticles::Record(Mesh *pm, const Real time)
+//  \brief append one record per tracer, sampled from the cell it sits in
+
+void TracerParticles::Record(Mesh *pm, const Real time) {
+  const int nabund = abund_ ? NSCALARS : 0;
+  stage_.resize(part_.size()*rec_size_);
+  for (std::size_t n=0; n<part_.size(); ++n) {
+    const TracerParticle &p = part_[n];
+    MeshBlock *pmb = pm->my_blocks(p.lb);
+    Coordinates *pco = pmb->pcoord;
+    int i = active_[0] ? Cell(pco->x1f, pmb->is, pmb->ie, p.x[0]) : pmb->is;
+    int j = active_[1] ? Cell(pco->x2f, pmb->js, pmb->je, p.x[1]) : pmb->js;
+    int k = active_[2] ? Cell(pco->x3f, pmb->ks, pmb->ke, p.x[2]) : pmb->ks;
+    ChemNetwork &chemnet = pmb->pscalars->chemnet;
+    const Real gm1 = pmb->peos->GetGamma() - 1.0;
+    const Real rho = pmb->phydro->w(IDN, k, j, i);
+    //internal energy density, as passed to the network
+    Real ED;
+    if (NON_BAROTROPIC_EOS) {
+      ED = pmb->phydro->w(IPR, k, j, i)/gm1;
+    } else {
+      ED = rho*SQR(pmb->peos->GetIsoSoundSpeed())/gm1;
+    }
+    Real y[NSCALARS];
+    for (int ispec=0; ispec < NSCALARS; ++ispec) {
+      y[ispec] = pmb->pscalars->s(ispec, k, j, i)/rho;
+    }
+    //the network and the record take the density in g/cm3
+    const Real rho_cgs = chemnet.CellDensity(k, j, i);
+    Real temp = chemnet.Temperature(rho_cgs, ED, y);
+    double rec[7 + NSCALARS] = {time, p.x[0], p.x[1], p.x[2], rho_cgs, temp,
+                                chemnet.EnergyGenerationRate(rho_cgs, temp, y)};
+    for (int ispec=0; ispec < nabund; ++ispec) rec[7+ispec] = y[ispec];
+    char *pr = &stage_[n*rec_size_];
+    memcpy(pr, &p.id, sizeof(int64_t));
+    memcpy(pr + sizeof(int64_t), rec, (7 + nabund)*sizeof(double));
+  }
+  Push(stage_.data(), part_.size());
+  return;
+}
+
+//--------------------------------------------------------------------------------------
+//! \fn void TracerParticles::Push(const char *data, std::size_t nrec)
+//  \brief copy nrec records into the ring, waiting for room (async) or writing the
+//  ring out (sync) when it is full
+
+void TracerParticles::Push(const char *data, std::size_t nrec) {
+  std::size_t done = 0;
+  while (done < nrec) {
+    uint64_t tail;
+    if (async_) {
+      std::unique_lock<std::mutex> lock(mtx_);
+      //back-pressure: wait for the I/O thread to free a slot
+      cv_.wait(lock, [this] {return head_ - tail_ < ring_nrec_ || !io_error_.empty();});
+      if (!io_error_.empty()) throw std::runtime_error(io_error_.c_str());
+      tail = tail_;
+    } else {
+      if (head_ - tail_ == ring_nrec_) Drain();
+      tail = tail_;
+    }
+    //the I/O thread only reads [tail, head), so the free slots can be filled unlocked
+    std::size_t pos = head_ % ring_nrec_;
+    std::size_t n = std::min(ring_nrec_ - static_cast<std::size_t>(head_ - tail),
+                             nrec - done);
+    n = std::min(n, ring_nrec_ - pos);
+    memcpy(&ring_[pos*rec_size_], data + done*rec_size_, n*rec_size_);
+    done += n;
+    if (async_) {
+      bool full_batch;
+      {
+        std::lock_guard<std::mutex> lock(mtx_);
+        head_ += n;
+        full_batch = (head_ - tail_ >= batch_nrec_);
+      }
+      if (full_batch) cv_.notify_all();
+    } else {
+      head_ += n;
+      if (head_ - tail_ >= batch_nrec_) Drain();
+    }
+  }
+  return;
+}
+
+//--------------------------------------------------------------------------------------
+//! \fn void TracerParticles::Drain()
+//  \brief write every record of the ring, on the main thread (sync mode)
+
+void TracerParticles::Drain() {
+  while (tail_ < head_) {
+    std::size_t pos = tail_ % ring_nrec_;
+    std::size_t n = std::min(static_cast<std::size_t>(head_ - tail_), ring_nrec_ - pos);
+    WriteRing(pos, n);
+    tail_ += n;
+  }
+  return;
+}
+
+//--------------------------------------------------------------------------------------
+//! \fn void TracerParticles::WriteRing(std::size_t pos, std::size_t n)
+//  \brief write the n records of the ring starting at slot pos
+
+void TracerParticles::WriteRing(std::size_t pos, std::size_t n) {
+  if (fwrite(&ring_[pos*rec_size_], rec_size_, n, fp_) != n) {
+    std::stringstream msg;
+    msg << "### FATAL ERROR in TracerParticles::WriteRing" << std::endl
+        << "Unable to write " << n << " tracer records of " << basename_ << std::endl;
+    throw std::runtime_error(msg.str().c_str());
+  }
+  return;
+}
+
+//--------------------------------------------------------------------------------------
+//! \fn void TracerParticles::IOThreadLoop()
+//  \brief body of the I/O thread: write full batches, or everything on a flush, until
+//  stopped
+
+void TracerParticles::IOThreadLoop() {
+  while (true) {
+    std::size_t pos, n;
+    {
+      std::unique_lock<std::mutex> lock(mtx_);
+      cv_.wait(lock, [this] {
+        return head_ - tail_ >= batch_nrec_ || ((flush_ || stop_) && head_ > tail_)
+               || (stop_ && head_ == tail_);
+      });
+      if (head_ == tail_) return;  // stop_ set and nothing left to write
+      pos = tail_ % ring_nrec_;
+      n = std::min(static_cast<std::size_t>(head_ - tail_), ring_nrec_ - pos);
+    }
+    std::string err;
+    if (io_error_.empty()) {
+      try {
+        WriteRing(pos, n);
+      } catch (std::exception &ex) {
+        err = ex.what();
+      }
+    }
+    {
+      std::lock_guard<std::mutex> lock(mtx_);
+      tail_ += n;
+      if (tail_ == head_) flush_ = false;
+      if (!err.empty() && io_error_.empty()) io_error_ = err;
+    }
+    cv_.notify_all();
+  }
+}
+
+namespace {
+//! \fn bool Inside(const Real *bb, const Real x[3], const bool active[3])
+//  \brief whether x is in the box bb = (x1min, x2min, x3min, x1max, x2max, x3max),
+//  lower faces included, along the active directions
+bool Inside(const Real *bb, const Real x[3], const bool active[3]) {
+  for (int d=0; d<3; ++d) {
+    if (active[d] && (x[d] < bb[d] || x[d] >= bb[d+3])) return false;
+  }
+  return true;
+}
+
+//! \fn void Bracket(const AthenaArray<Real> &xv, int il, int iu, const Real x, ...)
+//  \brief i in [il, iu-1] with xv(i) <= x < xv(i+1) and the fraction f of the way
+//  from xv(i) to xv(i+1), both clamped to the range
+void Bracket(const AthenaArray<Real> &xv, int il, int iu, const Real x, int *i,
+             Real *f) {
+  int lo = il, hi = iu;
+  while (hi - lo > 1) {
+    int mid = (lo + hi)/2;
+    if (x < xv(mid)) {
+      hi = mid;
+    } else {
+      lo = mid;
+    }
+  }
+  *i = lo;
+  *f = std::min(std::max((x - xv(lo))/(xv(lo+1) - xv(lo)), 0.0), 1.0);
+}
+
+//! \fn int Cell(const AthenaArray<Real> &xf, int il, int iu, const Real x)
+//  \brief the cell of il..iu, with faces xf, that holds x
+int Cell(const AthenaArray<Real> &xf, int il, int iu, const Real x) {
+  int i;
+  Real f;
+  Bracket(xf, il, iu+1, x, &i, &f);
+  return i;
+}
+} // namespace
+
+#else // no chemistry
+
+TracerParticles::TracerParticles(Mesh *pm, ParameterInput *pin) {
+  std::stringstream msg;
+  msg << "### FATAL ERROR in TracerParticles constructor" << std::endl
+      << "<tracer_particles> requires a chemistry network" << std::endl;
+  throw std::runtime_error(msg.str().c_str());
+}
+
+TracerParticles::~TracerParticles() {}
+void TracerParticles::Update(Mesh *pm) {}
+void TracerParticles::Finalize(Mesh *pm) {}
+void TracerParticles::Seed(Mesh *pm) {}
+bool TracerParticles::ReadState(Mesh *pm) {return false;}
+void TracerParticles::WriteState(Mesh *pm, const Real time, const int file_number) {}
+int TracerParticles::RestartNumber(Mesh *pm, const Real time, const int ncycle,
+                                   const bool final) {return -1;}
+bool TracerParticles::UpdateLayout(Mesh *pm) {return false;}
+int TracerParticles::LocalBlock(Mesh *pm, const Real x[3], int hint) const {return -1;}
+int TracerParticles::OwnerRank(const Real x[3]) const {return -1;}
+bool TracerParticles::ApplyBoundaries(Real x[3]) const {return false;}
+void TracerParticles::Velocity(MeshBlock *pmb, const Real x[3], Real v[3]) const {}
+void TracerParticles::Migrate(Mesh *pm) {}
+void TracerParticles::Record(Mesh *pm, const Real time) {}
+void TracerParticles::Push(const char *data, std::size_t nrec) {}
+void TracerParticles::Drain() {}
+void TracerParticles::WriteRing(std::size_t pos, std::size_t n) {}
+void TracerParticles::IOThreadLoop() {}
+
+#endif // INCLUDE_CHEMISTRY
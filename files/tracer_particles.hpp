@@ -0,0 +1,150 @@
+#ifndef OUTPUTS_TRACER_PARTICLES_HPP_
+#define OUTPUTS_TRACER_PARTICLES_HPP_
+//======================================================================================
+// Athena++ astrophysical MHD code
+// Copyright (C) 2014 James M. Stone  <jmstone@princeton.edu>
+// See LICENSE file for full public license information.
+//======================================================================================
+//! \file tracer_particles.hpp
+//  \brief Lagrangian tracer particles that record the thermodynamic history of the gas
+//  they move with, for nucleosynthesis post-processing
+//
+//  Tracers are seeded at the centers of a uniform lattice of nx1*nx2*nx3 points over
+//  the box x1min..x3max (default the whole mesh); the id of a tracer is its lattice
+//  index, so it does not depend on the domain decomposition. Every cycle each tracer is
+//  moved with the gas velocity, interpolated trilinearly from the cell centers, using
+//  Heun's method: the velocity at its old position from the previous cycle and the one
+//  at the predicted position after the step. A tracer that leaves its rank is sent to
+//  the rank of its new MeshBlock. Tracers wrap around periodic boundaries, are mirrored
+//  at reflecting ones and are dropped at all others.
+//
+//  Every dt (0 for every cycle) each tracer records t, its position and rho, T and the
+//  nuclear energy generation rate Edot of the cell it sits in, and with abundances =
+//  true the NSCALARS mole fractions of that cell. Records go to an in-memory ring
+//  buffer of buffer_mb on each rank and are appended to the rank's file
+//    <problem_id>.tracers.r<rank>.bin
+//  in batches of batch_mb. All values are native-endian: the file has the header
+//  "TRCPART1", int32 NSCALARS, int32 nabund (0 or NSCALARS) and float64 dvol, the
+//  volume of one lattice cell in code units, then records of
+//
+//    int64 id, float64 t, x1, x2, x3, rho [g/cm3], T [K], Edot [erg/g/s], y[nabund]
+//
+//  t and x are in code units. rho is the density the network burns with,
+//  ChemNetwork::CellDensity: the code density with the hydro floor times <chemistry>
+//  unit_density. The mass of a tracer in code units is dvol times its first rho over
+//  unit_density.
+//  in no particular order; tracer_histories.read_tracers() sorts them into histories.
+//  With async = true a background I/O thread on each rank does the writes, as for
+//  <abundance_output>; when the ring is full the next record waits for it to drain.
+//  With trigger = burn records are also made when the burn has changed by a set amount
+//  since the last ones, and dt is the longest interval (see burn_trigger.hpp).
+//
+//  Only cartesian coordinates are supported. With every restart dump (<outputN>
+//  file_type = rst, by dt or dcycle, and the final one) the tracers are stored in the
+//  state file <problem_id>.tracers.<nnnnn>.state, nnnnn the number of the dump, which a
+//  restart from that dump reads back. A restart that finds no state at its time seeds
+//  the tracers again, with a warning; their ids are then offset by nx1*nx2*nx3 times
+//  the number of earlier seedings, so that the new histories do not continue the old.
+//  After a restart from an earlier dump the files also hold the records the first run
+//  made after it; tracer_histories.read_tracers() keeps one record per id and time.
+//======================================================================================
+
+// C headers
+#include <stdint.h>  // int64_t
+#include <stdio.h>   // FILE
+
+// C++ headers
+#include <condition_variable>  // condition_variable
+#include <mutex>     // mutex
+#include <string>    // string
+#include <thread>    // thread
+#include <vector>    // vector
+
+// Athena++ headers
+#include "../athena.hpp"
+
+class BurnTrigger;
+class Mesh;
+class MeshBlock;
+class ParameterInput;
+
+//! \struct TracerParticle
+//  \brief position and last velocity of one tracer, sent as bytes between ranks
+struct TracerParticle {
+  int64_t id;
+  Real x[3];
+  Real v[3];   // velocity at x, from the end of the previous cycle
+  int lb;      // local MeshBlock holding x, -1 if not known
+};
+
+//! \class TracerParticles
+//  \brief tracer particles and their history writer, configured by <tracer_particles>
+class TracerParticles {
+ public:
+  TracerParticles(Mesh *pm, ParameterInput *pin);
+  ~TracerParticles();
+
+  //move the tracers over the step of pm->dt just taken from pm->time, record them if
+  //the output time has been reached, and store them if a restart dump follows the
+  //step; call from Mesh::UserWorkInLoop()
+  void Update(Mesh *pm);
+  //write every buffered record and the state of the final restart dump; call from
+  //Mesh::UserWorkAfterLoop()
+  void Finalize(Mesh *pm);
+
+  Real next_time;     // time of the next record
+  Real dt;            // time between records
+  long nlocal() const {return static_cast<long>(part_.size());}
+
+ private:
+  ParameterInput *pin_;
+  std::string basename_;
+  std::vector<TracerParticle> part_;
+  bool initialized_;  // seeded or read back from the state file
+  int nlat_[3];       // seeding lattice
+  int nseed_;         // seedings before this one, which offset the ids
+  Real box_[6];       // x1min, x2min, x3min, x1max, x2max, x3max of the lattice
+  Real mesh_[6];      // the same for the mesh
+  bool abund_;        // also record the mole fractions
+  int bc_[6];         // what happens to tracers at each mesh face
+  BurnTrigger *ptrigger_;  // with trigger = burn, nullptr otherwise
+  bool active_[3];    // whether tracers move along each direction
+
+  //MeshBlocks of all ranks, rebuilt when the block layout changes
+  std::vector<Real> bbox_;    // (nbtotal, 6) extents
+  std::vector<int> brank_;    // rank of each
+  int layout_[4];             // nbtotal, nblocal, first and last local gid
+
+  //ring buffer of records, drained to fp_
+  FILE *fp_;
+  int rec_size_;              // bytes per record
+  std::vector<char> ring_;
+  std::size_t ring_nrec_;     // capacity, in records
+  std::size_t batch_nrec_;    // records written at a time
+  uint64_t head_, tail_;      // records appended and written since the start
+  bool async_;
+  std::thread io_thread_;
+  std::mutex mtx_;
+  std::condition_variable cv_;
+  bool flush_, stop_;
+  std::string io_error_;      // error raised on the I/O thread, rethrown on the main
+  std::vector<char> stage_;   // records of one pass, before they enter the ring
+
+  void Seed(Mesh *pm);
+  bool ReadState(Mesh *pm);
+  void WriteState(Mesh *pm, const Real time, const int file_number);
+  int RestartNumber(Mesh *pm, const Real time, const int ncycle, const bool final);
+  bool UpdateLayout(Mesh *pm);
+  int LocalBlock(Mesh *pm, const Real x[3], int hint) const;
+  int OwnerRank(const Real x[3]) const;
+  bool ApplyBoundaries(Real x[3]) const;
+  void Velocity(MeshBlock *pmb, const Real x[3], Real v[3]) const;
+  void Migrate(Mesh *pm);
+  void Record(Mesh *pm, const Real time);
+  void Push(const char *data, std::size_t nrec);
+  void Drain();
+  void WriteRing(std::size_t pos, std::size_t n);
+  void IOThreadLoop();
+};
+
+#endif // OUTPUTS_TRACER_PARTICLES_HPP_
@@ -0,0 +1,93 @@
+//======================================================================================
+// Athena++ astrophysical MHD code
+// Copyright (C) 2014 James M. Stone  <jmstone@princeton.edu>
+//
+// This program is free software: you can redistribute and/or modify it under the terms
+// of the GNU General Public License (GPL) as published by the Free Software Foundation,
+// either version 3 of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+// PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+//
+// You should have received a copy of GNU GPL in the file LICENSE included in the code
+// distribution.  If not see <http://www.gnu.org/licenses/>.
+//======================================================================================
+//! \file tracer_postprocess.cpp
+//  \brief nucleosynthesis post-processing of tracer histories
+//
+//  Burns the (t, rho, T) histories of <tracer_burn> input_file with the network and
+//  solver of the simulation, and writes the final and sampled abundances to
+//  <tracer_burn> output_file (see tracer_burn.hpp for both formats, and
+//  vis/python/tracer_histories.py to write and read them). The mesh is a placeholder:
+//  the burns run at the end of the run on rank 0, over <tracer_burn> nthreads
+//  threads, so use one rank and nlim = 0.
+//======================================================================================
+
+// C++ headers
+#include <chrono>     // steady_clock
+#include <iostream>   // endl
+#include <string>     // c_str()
+
+// Athena++ headers
+#include "../athena.hpp"
+#include "../athena_arrays.hpp"
+#include "../chemistry/utils/tracer_burn.hpp"
+#include "../coordinates/coordinates.hpp"
+#include "../eos/eos.hpp"
+#include "../globals.hpp"
+#include "../hydro/hydro.hpp"
+#include "../mesh/mesh.hpp"
+#include "../parameter_input.hpp"
+#include "../scalars/scalars.hpp"
+
+#ifndef INCLUDE_CHEMISTRY
+#error "tracer_postprocess.cpp requires a chemistry network, configure with --chemistry"
+#endif
+
+//======================================================================================
+//! \fn void MeshBlock::ProblemGenerator(ParameterInput *pin)
+//  \brief uniform gas at rest; the mesh is not evolved
+//======================================================================================
+
+void MeshBlock::ProblemGenerator(ParameterInput *pin) {
+  for (int k=ks; k<=ke; ++k) {
+    for (int j=js; j<=je; ++j) {
+      for (int i=is; i<=ie; ++i) {
+        phydro->u(IDN, k, j, i) = 1.0;
+        phydro->u(IM1, k, j, i) = 0.0;
+        phydro->u(IM2, k, j, i) = 0.0;
+        phydro->u(IM3, k, j, i) = 0.0;
+        phydro->u(IEN, k, j, i) = 1.0;
+        for (int ispec=0; ispec < NSCALARS; ++ispec) {
+          pscalars->s(ispec, k, j, i) = 1.0/NSCALARS;
+        }
+      }
+    }
+  }
+  return;
+}
+
+//======================================================================================
+//! \fn void Mesh::UserWorkAfterLoop(ParameterInput *pin)
+//  \brief burn the tracer histories
+//======================================================================================
+
+void Mesh::UserWorkAfterLoop(ParameterInput *pin) {
+  if (Globals::my_rank != 0) return;
+  std::string fin = pin->GetString("tracer_burn", "input_file");
+  std::string fout = pin->GetOrAddString("tracer_burn", "output_file",
+      pin->GetString("job", "problem_id") + ".trc");
+
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  TracerBurn burn(pin);
+  long nfail = 0;
+  long nhist = burn.BurnFile(fin, fout, &nfail);
+  const Real wall_time = std::chrono::duration<Real>(
+      std::chrono::steady_clock::now() - start).count();
+
+  std::cout << "tracer burn: " << nhist << " histories of " << fin << " burned to "
+            << fout << ", " << nfail << " failed, wall time " << wall_time << " s"
+            << std::endl;
+  return;
+}